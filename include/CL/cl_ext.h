@@ -155,6 +155,57 @@ typedef CL_API_ENTRY cl_int (CL_API_CALL *clIcdGetPlatformIDsKHR_fn)(
 **************************/
 #define CL_CONTEXT_OFFLINE_DEVICES_AMD              0x403F
 
+/***************************
+* cl_wfv_kernel_exec_info *
+***************************/
+#define cl_wfv_kernel_exec_info 1
+
+typedef cl_uint cl_kernel_exec_info_wfv;
+
+/* cl_kernel_exec_info_wfv */
+#define CL_KERNEL_EXEC_GROUP_ORDER_WFV              0x4100
+#define CL_KERNEL_EXEC_AFFINITY_WFV                 0x4101
+#define CL_KERNEL_EXEC_SPECIALIZED_ARGS_WFV         0x4102  /* cl_uint[]: indices of private arguments to specialize on */
+#define CL_KERNEL_EXEC_SPECIALIZE_LOCAL_SIZE_WFV    0x4103  /* cl_bool: specialize on the local sizes */
+
+/* values for CL_KERNEL_EXEC_GROUP_ORDER_WFV (cl_uint) */
+#define CL_GROUP_ORDER_AUTO_WFV                     0x0
+#define CL_GROUP_ORDER_ROW_MAJOR_WFV                0x1
+#define CL_GROUP_ORDER_MORTON_WFV                   0x2
+#define CL_GROUP_ORDER_HILBERT_WFV                  0x3
+
+/* cl_mem_flags - placement of buffers allocated by the implementation
+ * (high bits, the low 32 bits are taken by Khronos and other vendors) */
+#define CL_MEM_NUMA_INTERLEAVE_WFV                  (((cl_mem_flags)1) << 48)   /* interleave pages across all NUMA nodes */
+#define CL_MEM_HUGE_PAGES_WFV                       (((cl_mem_flags)1) << 49)   /* back buffer with transparent huge pages */
+
+PACKETIZED_OPENCL_DLLEXPORT extern CL_API_ENTRY cl_int CL_API_CALL
+clSetKernelExecInfoWFV(cl_kernel               /* kernel */,
+                       cl_kernel_exec_info_wfv /* param_name */,
+                       size_t                  /* param_value_size */,
+                       const void *            /* param_value */);
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clSetKernelExecInfoWFV_fn)(
+        cl_kernel               /* kernel */,
+        cl_kernel_exec_info_wfv /* param_name */,
+        size_t                  /* param_value_size */,
+        const void *            /* param_value */);
+
+/*************************************
+* cl_wfv_kernel_vectorization_info *
+*************************************/
+#define cl_wfv_kernel_vectorization_info 1
+
+/* cl_kernel_info - outcome of the vectorization of a kernel */
+#define CL_KERNEL_VECTORIZED_WFV                    0x4110  /* cl_bool */
+#define CL_KERNEL_SIMD_DIMENSION_WFV                0x4111  /* cl_int: -1 if not vectorized */
+#define CL_KERNEL_NUM_UNIFORM_VALUES_WFV            0x4112  /* cl_uint */
+#define CL_KERNEL_NUM_VARYING_VALUES_WFV            0x4113  /* cl_uint */
+#define CL_KERNEL_NUM_GATHERS_WFV                   0x4114  /* cl_uint: loads from non-consecutive addresses */
+#define CL_KERNEL_NUM_SCATTERS_WFV                  0x4115  /* cl_uint: stores to non-consecutive addresses */
+#define CL_KERNEL_VECTORIZATION_LOG_WFV             0x4116  /* char[]: summary, reason if not vectorized */
+
+
 
     #ifdef CL_VERSION_1_1
        /***********************************
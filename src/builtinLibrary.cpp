@@ -0,0 +1,349 @@
+/**
+ * @file   builtinLibrary.cpp
+ * @date   18.10.2026
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See the COPYING file in the root directory for details.
+ *
+ * Copyright (C) 2010, 2011 Saarland University
+ *
+ */
+#include "builtinLibrary.hpp"
+#include "llvmTools.hpp"
+
+#include <sstream>
+
+// Implementations of common, geometric, integer and relational builtins.
+// clc only declares them, the packetizer would have to split each call into
+// one scalar call per lane (if the call could be resolved at all).
+//
+// Each builtin is generated from the same code for scalars and for packets,
+// the packetizer maps calls of the scalar version to the packet version
+// (see addNativeFunctions()). The names follow the scheme of the other
+// builtins of clc (see fixFunctionNames()): __<builtin>_<type>.
+
+namespace WFVOpenCL {
+
+enum BuiltinKind {
+    BUILTIN_CLAMP,      // clamp(x, lo, hi)
+    BUILTIN_MIX,        // mix(x, y, a)
+    BUILTIN_SELECT,     // select(a, b, c)
+    BUILTIN_DOT,        // dot(a, b)
+    BUILTIN_LENGTH,     // length(x)
+    BUILTIN_NORMALIZE,  // normalize(x)
+    BUILTIN_MAD24,      // mad24(a, b, c)
+    BUILTIN_MUL24,      // mul24(a, b)
+    BUILTIN_CONVERT_SAT,// convert_<type>_sat(x)
+    BUILTIN_ANY,        // any(x)
+    BUILTIN_ALL         // all(x)
+};
+
+enum BuiltinType {
+    BUILTIN_FLOAT,
+    BUILTIN_INT,
+    BUILTIN_UINT,
+    BUILTIN_SHORT,
+    BUILTIN_USHORT,
+    BUILTIN_CHAR,
+    BUILTIN_UCHAR
+};
+
+struct Builtin {
+    const char* name;
+    BuiltinKind kind;
+    BuiltinType argType;
+    BuiltinType resultType;
+};
+
+static const Builtin builtins[] = {
+    { "__clamp_f32",            BUILTIN_CLAMP,       BUILTIN_FLOAT, BUILTIN_FLOAT },
+    { "__clamp_i32",            BUILTIN_CLAMP,       BUILTIN_INT,   BUILTIN_INT },
+    { "__clamp_u32",            BUILTIN_CLAMP,       BUILTIN_UINT,  BUILTIN_UINT },
+    { "__mix_f32",              BUILTIN_MIX,         BUILTIN_FLOAT, BUILTIN_FLOAT },
+    { "__select_f32",           BUILTIN_SELECT,      BUILTIN_FLOAT, BUILTIN_FLOAT },
+    { "__select_i32",           BUILTIN_SELECT,      BUILTIN_INT,   BUILTIN_INT },
+    { "__select_u32",           BUILTIN_SELECT,      BUILTIN_UINT,  BUILTIN_UINT },
+    { "__dot_f32",              BUILTIN_DOT,         BUILTIN_FLOAT, BUILTIN_FLOAT },
+    { "__length_f32",           BUILTIN_LENGTH,      BUILTIN_FLOAT, BUILTIN_FLOAT },
+    { "__normalize_f32",        BUILTIN_NORMALIZE,   BUILTIN_FLOAT, BUILTIN_FLOAT },
+    { "__mad24_i32",            BUILTIN_MAD24,       BUILTIN_INT,   BUILTIN_INT },
+    { "__mad24_u32",            BUILTIN_MAD24,       BUILTIN_UINT,  BUILTIN_UINT },
+    { "__mul24_i32",            BUILTIN_MUL24,       BUILTIN_INT,   BUILTIN_INT },
+    { "__mul24_u32",            BUILTIN_MUL24,       BUILTIN_UINT,  BUILTIN_UINT },
+    { "__convert_char_sat_f32", BUILTIN_CONVERT_SAT, BUILTIN_FLOAT, BUILTIN_CHAR },
+    { "__convert_uchar_sat_f32",BUILTIN_CONVERT_SAT, BUILTIN_FLOAT, BUILTIN_UCHAR },
+    { "__convert_short_sat_f32",BUILTIN_CONVERT_SAT, BUILTIN_FLOAT, BUILTIN_SHORT },
+    { "__convert_ushort_sat_f32",BUILTIN_CONVERT_SAT,BUILTIN_FLOAT, BUILTIN_USHORT },
+    { "__convert_int_sat_f32",  BUILTIN_CONVERT_SAT, BUILTIN_FLOAT, BUILTIN_INT },
+    { "__convert_uint_sat_f32", BUILTIN_CONVERT_SAT, BUILTIN_FLOAT, BUILTIN_UINT },
+    { "__convert_char_sat_i32", BUILTIN_CONVERT_SAT, BUILTIN_INT,   BUILTIN_CHAR },
+    { "__convert_uchar_sat_i32",BUILTIN_CONVERT_SAT, BUILTIN_INT,   BUILTIN_UCHAR },
+    { "__convert_short_sat_i32",BUILTIN_CONVERT_SAT, BUILTIN_INT,   BUILTIN_SHORT },
+    { "__convert_ushort_sat_i32",BUILTIN_CONVERT_SAT,BUILTIN_INT,   BUILTIN_USHORT },
+    { "__convert_uint_sat_i32", BUILTIN_CONVERT_SAT, BUILTIN_INT,   BUILTIN_UINT },
+    { "__convert_char_sat_u32", BUILTIN_CONVERT_SAT, BUILTIN_UINT,  BUILTIN_CHAR },
+    { "__convert_uchar_sat_u32",BUILTIN_CONVERT_SAT, BUILTIN_UINT,  BUILTIN_UCHAR },
+    { "__convert_short_sat_u32",BUILTIN_CONVERT_SAT, BUILTIN_UINT,  BUILTIN_SHORT },
+    { "__convert_ushort_sat_u32",BUILTIN_CONVERT_SAT,BUILTIN_UINT,  BUILTIN_USHORT },
+    { "__convert_int_sat_u32",  BUILTIN_CONVERT_SAT, BUILTIN_UINT,  BUILTIN_INT },
+    { "__any_i32",              BUILTIN_ANY,         BUILTIN_INT,   BUILTIN_INT },
+    { "__all_i32",              BUILTIN_ALL,         BUILTIN_INT,   BUILTIN_INT },
+    { NULL, BUILTIN_CLAMP, BUILTIN_FLOAT, BUILTIN_FLOAT }
+};
+
+static const Builtin* findBuiltin(const std::string& name) {
+    for (const Builtin* builtin=builtins; builtin->name; ++builtin) {
+        if (name == builtin->name) return builtin;
+    }
+    return NULL;
+}
+
+static std::string getPacketName(const std::string& name, const unsigned simdWidth) {
+    std::stringstream strs;
+    strs << name << "_v" << simdWidth;
+    return strs.str();
+}
+
+static unsigned getNumBuiltinArgs(const BuiltinKind kind) {
+    switch (kind) {
+        case BUILTIN_CLAMP:
+        case BUILTIN_MIX:
+        case BUILTIN_SELECT:
+        case BUILTIN_MAD24:
+            return 3;
+        case BUILTIN_DOT:
+        case BUILTIN_MUL24:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+static bool isSigned(const BuiltinType type) {
+    return type == BUILTIN_INT || type == BUILTIN_SHORT || type == BUILTIN_CHAR;
+}
+
+// Returns the scalar type if 'width' is 1, a vector type otherwise.
+static const Type* getType(LLVMContext& context, const BuiltinType type, const unsigned width) {
+    const Type* elementType = NULL;
+    switch (type) {
+        case BUILTIN_FLOAT: elementType = Type::getFloatTy(context); break;
+        case BUILTIN_INT:
+        case BUILTIN_UINT: elementType = Type::getInt32Ty(context); break;
+        case BUILTIN_SHORT:
+        case BUILTIN_USHORT: elementType = Type::getInt16Ty(context); break;
+        case BUILTIN_CHAR:
+        case BUILTIN_UCHAR: elementType = Type::getInt8Ty(context); break;
+    }
+    return width == 1 ? elementType : VectorType::get(elementType, width);
+}
+
+// range of an integer type (as double, which holds all of them exactly)
+static void getLimits(const BuiltinType type, double& lo, double& hi) {
+    switch (type) {
+        case BUILTIN_CHAR: lo = -128.0; hi = 127.0; return;
+        case BUILTIN_UCHAR: lo = 0.0; hi = 255.0; return;
+        case BUILTIN_SHORT: lo = -32768.0; hi = 32767.0; return;
+        case BUILTIN_USHORT: lo = 0.0; hi = 65535.0; return;
+        case BUILTIN_INT: lo = -2147483648.0; hi = 2147483647.0; return;
+        case BUILTIN_UINT: lo = 0.0; hi = 4294967295.0; return;
+        default: assert (false && "no integer type!"); return;
+    }
+}
+
+//----------------------------------------------------------------------------//
+// code generation (for scalars and packets alike)
+//----------------------------------------------------------------------------//
+
+static Constant* getIntConstant(const Type* type, const double value) {
+    return ConstantInt::get(type, (uint64_t)(int64_t)value, true);
+}
+
+// integer type of the same size as 'type' (i32 or <W x i32> for floats)
+static const Type* getIntegerType(const Type* type) {
+    if (const VectorType* vectorType = dyn_cast<VectorType>(type)) return VectorType::getInteger(vectorType);
+    return IntegerType::get(type->getContext(), type->getPrimitiveSizeInBits());
+}
+
+// Returns 'a' where 'cond' is true, 'b' otherwise. The code generator
+// scalarizes selects of vectors, for packets the condition is used as a mask.
+static Value* createSelect(IRBuilder<>& builder, Value* cond, Value* a, Value* b) {
+    if (!isa<VectorType>(a->getType())) return builder.CreateSelect(cond, a, b);
+    const Type* intType = getIntegerType(a->getType());
+    Value* mask = builder.CreateSExt(cond, intType);
+    Value* ai = builder.CreateAnd(mask, builder.CreateBitCast(a, intType));
+    Value* bi = builder.CreateAnd(builder.CreateNot(mask), builder.CreateBitCast(b, intType));
+    return builder.CreateBitCast(builder.CreateOr(ai, bi), a->getType());
+}
+
+static Value* createMin(IRBuilder<>& builder, Value* x, Value* limit, const BuiltinType type) {
+    Value* cond = type == BUILTIN_FLOAT ? builder.CreateFCmpOGT(x, limit) :
+        isSigned(type) ? builder.CreateICmpSGT(x, limit) : builder.CreateICmpUGT(x, limit);
+    return createSelect(builder, cond, limit, x);
+}
+
+static Value* createMax(IRBuilder<>& builder, Value* x, Value* limit, const BuiltinType type) {
+    Value* cond = type == BUILTIN_FLOAT ? builder.CreateFCmpOLT(x, limit) :
+        isSigned(type) ? builder.CreateICmpSLT(x, limit) : builder.CreateICmpULT(x, limit);
+    return createSelect(builder, cond, limit, x);
+}
+
+// Conversion with saturation and rounding towards zero (default rounding
+// mode of integer conversions), NaN is converted to 0.
+static Value* createConvertSat(IRBuilder<>& builder, Value* x, const BuiltinType sourceType, const BuiltinType resultType, const Type* type) {
+    double lo, hi;
+    getLimits(resultType, lo, hi);
+    const Type* i32Type = getIntegerType(x->getType());
+
+    Value* result = NULL;
+    if (sourceType == BUILTIN_FLOAT) {
+        // the largest floats below 2^31 and 2^32 are the upper limits of the
+        // conversion, larger values saturate
+        double floatHi = hi;
+        if (resultType == BUILTIN_INT) floatHi = 2147483520.0;
+        else if (resultType == BUILTIN_UINT) floatHi = 4294967040.0;
+        const Type* floatType = x->getType();
+        Value* clamped = createMax(builder, x, ConstantFP::get(floatType, lo), BUILTIN_FLOAT);
+        clamped = createMin(builder, clamped, ConstantFP::get(floatType, floatHi), BUILTIN_FLOAT);
+        clamped = createSelect(builder, builder.CreateFCmpUNO(x, x), ConstantFP::get(floatType, 0.0), clamped);
+        result = resultType == BUILTIN_UINT ?
+            builder.CreateFPToUI(clamped, i32Type) :
+            builder.CreateFPToSI(clamped, i32Type);
+        if (floatHi != hi) {
+            Value* overflow = builder.CreateFCmpOGE(x, ConstantFP::get(floatType, hi + 1.0));
+            result = createSelect(builder, overflow, getIntConstant(i32Type, hi), result);
+        }
+    } else {
+        // only the limits that are inside the range of the source type
+        result = x;
+        if (isSigned(sourceType)) {
+            if (hi > 2147483647.0) hi = 2147483647.0;
+            result = createMax(builder, result, getIntConstant(i32Type, lo), sourceType);
+        }
+        if (isSigned(sourceType) || hi < 4294967295.0) {
+            result = createMin(builder, result, getIntConstant(i32Type, hi), sourceType);
+        }
+    }
+    return type == i32Type ? result : builder.CreateTrunc(result, type);
+}
+
+static Value* createBuiltin(IRBuilder<>& builder, const Builtin& builtin, const std::vector<Value*>& args, const Type* resultType) {
+    const BuiltinType type = builtin.argType;
+    switch (builtin.kind) {
+        case BUILTIN_CLAMP:
+            return createMin(builder, createMax(builder, args[0], args[1], type), args[2], type);
+        case BUILTIN_MIX:
+            // x + (y - x) * a
+            return builder.CreateFAdd(args[0], builder.CreateFMul(builder.CreateFSub(args[1], args[0]), args[2]));
+        case BUILTIN_SELECT: {
+            // c ? b : a (scalar semantics: c != 0)
+            Value* cond = builder.CreateICmpNE(args[2], Constant::getNullValue(args[2]->getType()));
+            return createSelect(builder, cond, args[1], args[0]);
+        }
+        case BUILTIN_DOT:
+            return builder.CreateFMul(args[0], args[1]);
+        case BUILTIN_LENGTH: {
+            // |x| (clear sign bit)
+            const Type* intType = getIntegerType(args[0]->getType());
+            Value* bits = builder.CreateAnd(builder.CreateBitCast(args[0], intType), getIntConstant(intType, 2147483647.0));
+            return builder.CreateBitCast(bits, args[0]->getType());
+        }
+        case BUILTIN_NORMALIZE: {
+            // 1 with the sign of x, 0 and NaN are returned unchanged
+            const Type* intType = getIntegerType(args[0]->getType());
+            Value* sign = builder.CreateAnd(builder.CreateBitCast(args[0], intType), getIntConstant(intType, -2147483648.0));
+            Value* one = builder.CreateBitCast(ConstantFP::get(args[0]->getType(), 1.0), intType);
+            Value* result = builder.CreateBitCast(builder.CreateOr(one, sign), args[0]->getType());
+            Value* unchanged = builder.CreateFCmpUEQ(args[0], ConstantFP::get(args[0]->getType(), 0.0));
+            return createSelect(builder, unchanged, args[0], result);
+        }
+        case BUILTIN_MAD24:
+            // operands with more than 24 bits are undefined, the full
+            // multiplication is valid for them as well
+            return builder.CreateAdd(builder.CreateMul(args[0], args[1]), args[2]);
+        case BUILTIN_MUL24:
+            return builder.CreateMul(args[0], args[1]);
+        case BUILTIN_CONVERT_SAT:
+            return createConvertSat(builder, args[0], type, builtin.resultType, resultType);
+        case BUILTIN_ANY:
+        case BUILTIN_ALL: {
+            // scalar semantics: 1 if the most significant bit is set
+            Value* msb = builder.CreateICmpSLT(args[0], Constant::getNullValue(args[0]->getType()));
+            return builder.CreateZExt(msb, resultType);
+        }
+        default:
+            assert (false && "unknown builtin!");
+            return NULL;
+    }
+}
+
+// Generates the builtin for packets of 'width' elements (scalar if 1)
+// into 'library'.
+static Function* generateBuiltin(const Builtin& builtin, const std::string& name, Module* library, const unsigned width) {
+    LLVMContext& context = library->getContext();
+    const Type* argType = getType(context, builtin.argType, width);
+    const Type* resultType = getType(context, builtin.resultType, width);
+
+    std::vector<const Type*> params(getNumBuiltinArgs(builtin.kind), argType);
+    if (builtin.kind == BUILTIN_SELECT) params[2] = getType(context, BUILTIN_INT, width);
+
+    Function* fn = createExternalFunction(name, resultType, params, library);
+    fn->setDoesNotThrow();
+    fn->setDoesNotAccessMemory();
+
+    std::vector<Value*> args;
+    for (Function::arg_iterator A=fn->arg_begin(), AE=fn->arg_end(); A!=AE; ++A) {
+        args.push_back(A);
+    }
+
+    IRBuilder<> builder(BasicBlock::Create(context, "entry", fn));
+    builder.CreateRet(createBuiltin(builder, builtin, args, resultType));
+    return fn;
+}
+
+void linkBuiltinLibrary(Module* mod, const unsigned simdWidth) {
+    assert (mod);
+    Module* library = new Module("wfvocl_builtins", mod->getContext());
+    library->setDataLayout(mod->getDataLayout());
+    library->setTargetTriple(mod->getTargetTriple());
+
+    for (const Builtin* builtin=builtins; builtin->name; ++builtin) {
+        const Function* decl = mod->getFunction(builtin->name);
+        if (!decl || !decl->isDeclaration()) continue;
+
+        Function* scalarFn = generateBuiltin(*builtin, builtin->name, library, 1);
+        if (scalarFn->getFunctionType() != decl->getFunctionType()) {
+            errs() << "WARNING: builtin '" << builtin->name << "' has unexpected type, not replaced!\n";
+            scalarFn->eraseFromParent();
+            continue;
+        }
+#ifndef WFVOPENCL_NO_WFV
+        // keep the calls for the packetizer (see allowInliningOfBuiltins())
+        scalarFn->addFnAttr(Attribute::NoInline);
+        generateBuiltin(*builtin, getPacketName(builtin->name, simdWidth), library, simdWidth);
+#endif
+    }
+
+    if (!library->empty()) {
+        WFVOPENCL_DEBUG( verifyModule(*library); );
+        if (!linkInModule(mod, library)) {
+            errs() << "ERROR: could not link builtin library!\n";
+        }
+    }
+    delete library;
+}
+
+Function* getBuiltinPacketFunction(const Function* scalarFn, const unsigned simdWidth) {
+    assert (scalarFn);
+    if (scalarFn->isDeclaration() || !findBuiltin(scalarFn->getNameStr())) return NULL;
+    return scalarFn->getParent()->getFunction(getPacketName(scalarFn->getNameStr(), simdWidth));
+}
+
+void allowInliningOfBuiltins(Module* mod) {
+    assert (mod);
+    for (const Builtin* builtin=builtins; builtin->name; ++builtin) {
+        if (Function* fn = mod->getFunction(builtin->name)) fn->removeFnAttr(Attribute::NoInline);
+    }
+}
+
+}
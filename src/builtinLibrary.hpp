@@ -0,0 +1,35 @@
+/**
+ * @file   builtinLibrary.hpp
+ * @date   18.10.2026
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See the COPYING file in the root directory for details.
+ *
+ * Copyright (C) 2010, 2011 Saarland University
+ *
+ */
+#ifndef _BUILTINLIBRARY_H
+#define _BUILTINLIBRARY_H
+
+#include "llvm/Module.h"
+
+using namespace llvm;
+
+namespace WFVOpenCL {
+    // Generates the library of builtins (clamp, mix, select, dot, length,
+    // normalize, mad24, mul24, convert_*_sat, any, all) that 'mod' calls
+    // and links it into 'mod': a scalar implementation that replaces the
+    // declaration generated by clc and a version that operates on packets of
+    // 'simdWidth' elements.
+    void linkBuiltinLibrary(Module* mod, const unsigned simdWidth);
+
+    // Returns the packet version of the builtin 'scalarFn' if it was linked
+    // in by linkBuiltinLibrary(), NULL otherwise.
+    Function* getBuiltinPacketFunction(const Function* scalarFn, const unsigned simdWidth);
+
+    // The scalar builtins must not be inlined before the packetizer replaced
+    // their calls by calls to the packet versions. Afterwards, they are.
+    void allowInliningOfBuiltins(Module* mod);
+}
+
+#endif /* _BUILTINLIBRARY_H */
@@ -1,4 +1,6 @@
 #include "llvmTools.hpp"
+#include "simdMath.hpp"
+#include "builtinLibrary.hpp"
 
 // small helper function
 inline bool constantEqualsInt(const Constant* c, const uint64_t intValue) {
@@ -13,13 +15,24 @@ inline bool constantIsDividableBySIMDWidth(const Constant* c) {
     assert (isa<ConstantInt>(c));
     const ConstantInt* constIntOp = cast<ConstantInt>(c);
     const uint64_t constVal = *(constIntOp->getValue().getRawData());
-    return (constVal % WFVOPENCL_SIMD_WIDTH == 0);
+    return (constVal % WFVOpenCL::getSimdWidth() == 0);
 }
 
 namespace WFVOpenCL {
 
 #ifndef WFVOPENCL_NO_WFV
-void addNativeFunctions(Function* kernel, const cl_uint simdDim, Packetizer::Packetizer& packetizer) {
+void addNativeFunctions(Function* kernel, const cl_uint simdDim, Packetizer::Packetizer& packetizer, const bool relaxedMath, const bool alignedPointers) {
+    std::set<std::string> mathFunctions;
+    std::set<Function*> builtinFunctions;
+
+    // Kernel arguments are the same for all work items:
+    // UNIFORM / INDEX_SAME / ALIGN_FALSE
+    // Buffers (__global) are ALIGN_TRUE if the runtime guarantees their
+    // alignment to the SIMD width.
+    for (Function::arg_iterator A=kernel->arg_begin(), AE=kernel->arg_end(); A!=AE; ++A) {
+        const bool isBuffer = isPointerType(A->getType()) && getAddressSpace(A->getType()) == 1; // __global
+        packetizer.addValueInfo(A, true, false, isBuffer && alignedPointers);
+    }
 
     for (Function::iterator BB=kernel->begin(), BBE=kernel->end();
             BB!=BBE; ++BB)
@@ -31,6 +44,15 @@ void addNativeFunctions(Function* kernel, const cl_uint simdDim, Packetizer::Pac
             CallInst* call = cast<CallInst>(I);
             Function* callee = call->getCalledFunction();
 
+            if (hasSimdMathFunction(callee->getNameStr())) {
+                mathFunctions.insert(callee->getNameStr());
+                continue;
+            }
+            if (getBuiltinPacketFunction(callee, getSimdWidth())) {
+                builtinFunctions.insert(callee);
+                continue;
+            }
+
             if (std::strstr(callee->getNameStr().c_str(), "get_global_id") ||
                     std::strstr(callee->getNameStr().c_str(), "get_local_id"))
             {
@@ -66,6 +88,23 @@ void addNativeFunctions(Function* kernel, const cl_uint simdDim, Packetizer::Pac
         packetizer.addVaryingFunctionMapping("barrier", -1, barrierFn);
     }
 
+    // Map math functions to their SIMD versions (see simdMath.cpp) instead
+    // of splitting each call into one scalar call per lane.
+    for (std::set<std::string>::const_iterator it=mathFunctions.begin(),
+            E=mathFunctions.end(); it!=E; ++it)
+    {
+        Function* simdFn = getSimdMathFunction(*it, kernel->getParent(), getSimdWidth(), relaxedMath);
+        packetizer.addVaryingFunctionMapping(*it, -1, simdFn);
+    }
+
+    // Same for the builtins of the builtin library (see builtinLibrary.cpp).
+    for (std::set<Function*>::const_iterator it=builtinFunctions.begin(),
+            E=builtinFunctions.end(); it!=E; ++it)
+    {
+        Function* packetFn = getBuiltinPacketFunction(*it, getSimdWidth());
+        packetizer.addVaryingFunctionMapping((*it)->getNameStr(), -1, packetFn);
+    }
+
 }
 #endif
 
@@ -310,7 +349,7 @@ void generateOpenCLFunctions(Module* mod) {
     Function::Create(fTypeG1, Function::ExternalLinkage, "get_global_id_split", mod);
     // generate '__m128i get_global_id_split_SIMD(unsigned)'
     // returns a vector to force splitting during packetization
-    const FunctionType* fTypeG2 = FunctionType::get(VectorType::get(Type::getInt32Ty(context), WFVOPENCL_SIMD_WIDTH), params, false);
+    const FunctionType* fTypeG2 = FunctionType::get(VectorType::get(Type::getInt32Ty(context), WFVOpenCL::getSimdWidth()), params, false);
     Function::Create(fTypeG2, Function::ExternalLinkage, "get_global_id_split_SIMD", mod);
     // generate 'unsigned get_global_id_SIMD(unsigned)'
     // does not return a vector because the simd value is loaded from the
@@ -324,7 +363,7 @@ void generateOpenCLFunctions(Module* mod) {
     Function::Create(fTypeL1, Function::ExternalLinkage, "get_local_id_split", mod);
     // generate '__m128i get_local_id_split_SIMD(unsigned)'
     // returns a vector to force splitting during packetization
-    const FunctionType* fTypeL2 = FunctionType::get(VectorType::get(Type::getInt32Ty(context), WFVOPENCL_SIMD_WIDTH), params, false);
+    const FunctionType* fTypeL2 = FunctionType::get(VectorType::get(Type::getInt32Ty(context), WFVOpenCL::getSimdWidth()), params, false);
     Function::Create(fTypeL2, Function::ExternalLinkage, "get_local_id_split_SIMD", mod);
     // generate 'unsigned get_local_id_SIMD(unsigned)'
     // does not return a vector because the simd value is loaded from the
@@ -466,6 +505,23 @@ void writeModuleToFile(const Module * M, const std::string & fileName) {
         errs() << "ERROR: printing module to file failed: " << errorMessage << "\n";
     }
 }
+bool writeModuleBitcodeToFile(const Module * M, const std::string & fileName) {
+    assert (M);
+    std::string errorMessage = "";
+    raw_fd_ostream file(fileName.c_str(), errorMessage, raw_fd_ostream::F_Binary);
+    if (errorMessage != "") {
+        errs() << "ERROR: writing bitcode to file failed: " << errorMessage << "\n";
+        return false;
+    }
+    WriteBitcodeToFile(M, file);
+    file.close();
+    if (file.has_error()) {
+        file.clear_error(); // otherwise, the destructor aborts
+        errs() << "ERROR: writing bitcode to file '" << fileName << "' failed!\n";
+        return false;
+    }
+    return true;
+}
 void writeFunctionToFile(const Function * F, const std::string & fileName) {
     assert (F);
     std::string errorMessage = "";
@@ -478,81 +534,53 @@ void writeFunctionToFile(const Function * F, const std::string & fileName) {
 }
 
 
-//declare as static to prevent creation of several JITs
-static ExecutionEngine *globalExecEngine = 0;
-
+// Creates a JIT that owns 'mod' (it is deleted together with the engine).
+// Every kernel is compiled by an engine of its own (see KernelModule). If
+// no engine could be created, the caller still owns 'mod'.
 ExecutionEngine* createExecutionEngine(Module* mod) {
+    assert (mod);
 
-    if (globalExecEngine == 0)
-    {
-        //we first have to initialize the native target for code generation
-        const bool initFailed = InitializeNativeTarget();
-
-        if (initFailed) {
-            errs() << "ERROR: could not initialize native target (required for "
-                << "LLVM execution engine)\n";
-            return NULL;
-        }
-
-        std::string errorMessage = "";
-
-        EngineBuilder eb = EngineBuilder(mod);
-        eb.setEngineKind(EngineKind::JIT);
-        eb.setErrorStr(&errorMessage);
-        eb.setJITMemoryManager(JITMemoryManager::CreateDefaultMemManager());
-        eb.setOptLevel(CodeGenOpt::Aggressive);
-        eb.setAllocateGVsWithCode(false);
-        eb.setCodeModel(CodeModel::Default);
-        //eb.setMArch("x86-64");
-        //eb.setMCPU("corei7");
-        //std::vector<std::string> attrs;
-        //attrs.push_back("+sse41");
-        //eb.setMAttrs(attrs);
-
-
-        globalExecEngine = eb.create();
-
-        if (errorMessage != "") {
-            errs() << "ERROR: could not create execution engine for module "
-                << mod->getModuleIdentifier() << ": " << errorMessage << "\n";
-            return NULL;
-        }
+    //we first have to initialize the native target for code generation
+    static const bool initFailed = InitializeNativeTarget();
 
-        if (!globalExecEngine) {
-            errs() << "ERROR: could not create execution engine for module "
-                << mod->getModuleIdentifier() << "!\n";
-            return NULL;
-        }
+    if (initFailed) {
+        errs() << "ERROR: could not initialize native target (required for "
+            << "LLVM execution engine)\n";
+        return NULL;
     }
 
-    return globalExecEngine;
-}
-
-ExecutionEngine * getExecutionEngine(Module* mod) {
-    return createExecutionEngine(mod);
-}
-
-void* getPointerToFunction(Module * mod, Function * func)
-{
-    ExecutionEngine * execEngine = createExecutionEngine(mod);
-    if (!execEngine) exit(-1);
-
-    return execEngine->getPointerToFunction(func);
-}
-
-void* getPointerToFunction(Module* mod, std::string functionName) {
-
-    ExecutionEngine *execEngine = createExecutionEngine(mod);
-    if (!execEngine) exit(-1);
+    std::string errorMessage = "";
 
-    Function* f = mod->getFunction(functionName);
-    if (!f) {
-        errs() << "Error: Function '" << functionName << "' not found in module "
-            << mod->getModuleIdentifier() << "!\n";
-        exit(-1);
+    EngineBuilder eb = EngineBuilder(mod);
+    eb.setEngineKind(EngineKind::JIT);
+    eb.setErrorStr(&errorMessage);
+    eb.setJITMemoryManager(JITMemoryManager::CreateDefaultMemManager());
+    eb.setOptLevel(CodeGenOpt::Aggressive);
+    eb.setAllocateGVsWithCode(false);
+    eb.setCodeModel(CodeModel::Default);
+    //eb.setMArch("x86-64");
+    //eb.setMCPU("corei7");
+    // generate code for the instruction set the kernels were packetized for
+    std::vector<std::string> attrs;
+    // (AVX is disabled explicitly, the host CPU may support it although the
+    // driver does not use it)
+    if (hostSupportsAVX()) attrs.push_back("+avx");
+    else {
+        if (hostSupportsSSE41()) attrs.push_back("+sse41");
+        attrs.push_back("-avx");
+    }
+    eb.setMAttrs(attrs);
+
+
+    ExecutionEngine* engine = eb.create();
+
+    if (!engine) {
+        errs() << "ERROR: could not create execution engine for module "
+            << mod->getModuleIdentifier() << ": " << errorMessage << "\n";
+        return NULL;
     }
 
-    return execEngine->getPointerToFunction(f);
+    return engine;
 }
 
 void* getPointerToFunction(ExecutionEngine * engine, Function * func) {
@@ -560,6 +588,48 @@ void* getPointerToFunction(ExecutionEngine * engine, Function * func) {
     return engine->getPointerToFunction(func);
 }
 
+// sums up the size of all functions that the JIT emits while it is registered
+class CodeSizeListener : public JITEventListener {
+public:
+    CodeSizeListener() : size(0) {}
+    virtual void NotifyFunctionEmitted(const Function& F, void* Code, size_t Size, const EmittedFunctionDetails& Details) {
+        size += Size;
+    }
+    size_t size;
+};
+
+// Same as above, also returns the size of the machine code that had to be
+// generated for 'func' (including functions it calls, 0 if 'func' was
+// compiled before).
+void* getPointerToFunction(ExecutionEngine* engine, Function* func, size_t* code_size) {
+    assert (engine && func && code_size);
+    CodeSizeListener listener;
+    engine->RegisterJITEventListener(&listener);
+    void* ptr = engine->getPointerToFunction(func);
+    engine->UnregisterJITEventListener(&listener);
+    *code_size = listener.size;
+    return ptr;
+}
+
+// Releases the native code of 'func' (if it was compiled by 'engine') and
+// removes the function from its module.
+void freeFunction(ExecutionEngine* engine, Function* func) {
+    assert (func && func->use_empty());
+    if (engine) engine->freeMachineCodeForFunction(func);
+    func->eraseFromParent();
+}
+
+// LLVM 2.9 has no floating point flags on instructions, the code generator
+// reads these global options instead. They only affect functions that are
+// compiled while they are set, callers hold DRIVER_LOCK_CODE_GENERATION
+// from setting the options until they are reset.
+void setFloatingPointOptions(const bool unsafeMath, const bool finiteMath, const bool lessPreciseMAD) {
+    UnsafeFPMath = unsafeMath;
+    NoInfsFPMath = finiteMath;
+    NoNaNsFPMath = finiteMath;
+    LessPreciseFPMADOption = lessPreciseMAD;
+}
+
 unsigned getPrimitiveSizeInBits(const Type* type) {
     assert (type);
     return type->getPrimitiveSizeInBits();
@@ -658,16 +728,18 @@ void inlineFunctionCalls(Function* f, TargetData* targetData) {
 }
 
 /// adopted from: llvm-2.9/include/llvm/Support/StandardPasses.h
-void optimizeFunction(Function* f, const bool disableLICM, const bool disableLoopRotate) {
+/// optimizationLevel 0 only removes allocas (required by later stages),
+/// 1 skips loop unrolling and GVN, 2 and 3 run the full pipeline.
+void optimizeFunction(Function* f, const bool disableLICM, const bool disableLoopRotate, const unsigned optimizationLevel) {
     assert (f);
     assert (f->getParent());
     Module* mod = f->getParent();
     TargetData* targetData = new TargetData(mod);
 
-    const unsigned OptimizationLevel = 3;
+    const unsigned OptimizationLevel = optimizationLevel;
     const bool OptimizeSize = false;
     const bool UnitAtATime = true;
-    const bool UnrollLoops = true;
+    const bool UnrollLoops = OptimizationLevel > 1;
     const bool SimplifyLibCalls = true;
     const bool HaveExceptions = false;
     Pass* InliningPass = createFunctionInliningPass(275);
@@ -688,6 +760,15 @@ void optimizeFunction(Function* f, const bool disableLICM, const bool disableLoo
     Passes.add(createPromoteMemoryToRegisterPass());
     Passes.add(createInstructionCombiningPass());
 
+    if (OptimizationLevel == 0) {
+        WFVOPENCL_DEBUG( Passes.add(createVerifierPass()); );
+
+        Passes.doInitialization();
+        Passes.run(*f);
+        Passes.doFinalization();
+        return;
+    }
+
     // Add TypeBasedAliasAnalysis before BasicAliasAnalysis so that
     // BasicAliasAnalysis wins if they disagree. This is intended to help
     // support "obvious" type-punning idioms.
@@ -740,6 +821,31 @@ void optimizeFunction(Function* f, const bool disableLICM, const bool disableLoo
 }
 
 
+// Relaxed floating point semantics (-cl-unsafe-math-optimizations): replaces
+// divisions by constants with multiplications by their reciprocal, before
+// vectorization so that the vector code benefits as well.
+void relaxFloatingPointMath(Function* f) {
+    assert (f);
+    for (Function::iterator BB=f->begin(), BBE=f->end(); BB!=BBE; ++BB) {
+        for (BasicBlock::iterator I=BB->begin(), IE=BB->end(); I!=IE; ) {
+            Instruction* inst = I++;
+            if (inst->getOpcode() != Instruction::FDiv) continue;
+
+            Constant* divisor = dyn_cast<Constant>(inst->getOperand(1));
+            if (!divisor || divisor->isNullValue()) continue;
+            if (!isa<ConstantFP>(divisor) && !isa<ConstantVector>(divisor)) continue;
+
+            Constant* one = ConstantFP::get(divisor->getType(), 1.0);
+            Constant* reciprocal = ConstantExpr::getFDiv(one, divisor);
+            BinaryOperator* mul = BinaryOperator::Create(Instruction::FMul, inst->getOperand(0), reciprocal, "", inst);
+            mul->takeName(inst);
+            inst->replaceAllUsesWith(mul);
+            inst->eraseFromParent();
+        }
+    }
+}
+
+
 Constant * createPointerConstant(void * thePointer, const Type * pointerType) {
     //use target data for pointer, this might not work on 64 bit!
     //TargetData td(mod);
@@ -885,9 +991,9 @@ void replaceAllUsesWith(Value* oldVal, Value* newVal) {
 // FIXME: this function is required to resolve Linker usage in packetizer...
 Module* linkInModule(Module* target, Module* source) {
     assert (source && target);
-    outs() << "linking src module '" << source->getModuleIdentifier()
+    WFVOPENCL_DEBUG( outs() << "linking src module '" << source->getModuleIdentifier()
             << "' into dest module '" << target->getModuleIdentifier()
-            << "'... ";
+            << "'...\n"; );
     std::auto_ptr<llvm::Linker> linker(new llvm::Linker("jitRT Linker", target));
     assert (linker.get() != 0);
     std::string errorMessage;
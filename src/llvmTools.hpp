@@ -31,6 +31,7 @@
 
 #include "llvm/Module.h"
 #include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetOptions.h" // UnsafeFPMath
 
 #include "llvm/Bitcode/ReaderWriter.h" // createModuleFromFile
 #include "llvm/Support/MemoryBuffer.h" // createModuleFromFile
@@ -38,6 +39,7 @@
 #include "llvm/ExecutionEngine/JITMemoryManager.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JIT.h" //required to prevent "JIT has not been linked in" errors
+#include "llvm/ExecutionEngine/JITEventListener.h" // machine code size
 
 #include "llvm/Target/TargetSelect.h" // InitializeNativeTarget (getExecutionEngine)
 
@@ -50,6 +52,7 @@
 #include "llvm/Transforms/Utils/Cloning.h" //InlineFunction
 
 #include "llvm/Support/Timer.h"
+#include "llvm/Support/Threading.h" // llvm_start_multithreaded
 
 #include "llvm/Linker.h"
 
@@ -65,13 +68,24 @@
 
 #include "debug.h"
 
-#define WFVOPENCL_SIMD_WIDTH 4
-
 using namespace llvm;
 
+// SIMD capabilities of the host (implemented in wfvOpenCL.cpp)
+#ifdef __cplusplus
+extern "C" {
+#endif
+namespace WFVOpenCL {
+    bool hostSupportsSSE41();
+    bool hostSupportsAVX(); // false if AVX is disabled (WFVOPENCL_NO_AVX)
+    unsigned getSimdWidth();
+}
+#ifdef __cplusplus
+}
+#endif
+
 namespace WFVOpenCL {
 #ifndef WFVOPENCL_NO_WFV
-    void addNativeFunctions(Function* kernel, const cl_uint simdDim, Packetizer::Packetizer& packetizer);
+    void addNativeFunctions(Function* kernel, const cl_uint simdDim, Packetizer::Packetizer& packetizer, const bool relaxedMath, const bool alignedPointers);
 #endif
     Function* generateFunctionWrapperWithParams(const std::string& wrapper_name, Function* f, Module* mod, std::vector<const Type*>& additionalParams, const bool inlineCall);
     void generateOpenCLFunctions(Module* mod);
@@ -88,12 +102,13 @@ namespace WFVOpenCL {
     Function* getFunction(const std::string& name, Module* module);
     Module* createModuleFromFile(const std::string & fileName);
     void writeModuleToFile(const Module * M, const std::string & fileName);
+    bool writeModuleBitcodeToFile(const Module * M, const std::string & fileName);
     void writeFunctionToFile(const Function * F, const std::string & fileName);
     ExecutionEngine* createExecutionEngine(Module* mod);
-    ExecutionEngine * getExecutionEngine(Module* mod);
-    void* getPointerToFunction(Module * mod, Function * func);
-    void* getPointerToFunction(Module* mod, std::string functionName);
     void* getPointerToFunction(ExecutionEngine * engine, Function * func);
+    void* getPointerToFunction(ExecutionEngine* engine, Function* func, size_t* code_size);
+    void freeFunction(ExecutionEngine* engine, Function* func);
+    void setFloatingPointOptions(const bool unsafeMath, const bool finiteMath, const bool lessPreciseMAD);
     unsigned getPrimitiveSizeInBits(const Type* type);
     bool isPointerType(const Type* type);
     const Type* getContainedType(const Type* type, const unsigned index);
@@ -107,7 +122,8 @@ namespace WFVOpenCL {
     const Type* getArgumentType(const Function* f, const unsigned arg_index);
     unsigned getAddressSpace(const Type* type);
     void inlineFunctionCalls(Function* f, TargetData* targetData=NULL);
-    void optimizeFunction(Function* f, const bool disableLICM=false, const bool disableLoopRotate=false);
+    void optimizeFunction(Function* f, const bool disableLICM=false, const bool disableLoopRotate=false, const unsigned optimizationLevel=3);
+    void relaxFloatingPointMath(Function* f);
     Constant * createPointerConstant(void * thePointer, const Type * pointerType);
     const char * readConstant(Constant *& target,const Type * type, const char * position);
     Constant * createConstant(const Type * type, const char * value);
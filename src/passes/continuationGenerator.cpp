@@ -138,6 +138,16 @@ void ContinuationGenerator::getContinuations(ContinuationVecType& continuations)
     }
 }
 
+void ContinuationGenerator::getLiveValueStructTypes(SmallVector<const StructType*, 4>& types) const {
+    assert (types.empty());
+    types.resize(continuationMap.size());
+    for (DenseMap<unsigned, BarrierInfo*>::const_iterator it=continuationMap.begin(), E=continuationMap.end(); it!=E; ++it) {
+        BarrierInfo* binfo = it->second;
+        assert (binfo->id < types.size());
+        types[binfo->id] = binfo->liveValueStructType;
+    }
+}
+
 ContinuationGenerator::ContinuationMapType* ContinuationGenerator::getContinuationMap() { return &continuationMap; }
 
 inline const Type* ContinuationGenerator::getReturnType(LLVMContext& context) {
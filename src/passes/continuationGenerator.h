@@ -123,6 +123,8 @@ public:
     Function* getBarrierFreeFunction() const;
     typedef SmallVector<Function*, 4> ContinuationVecType;
     void getContinuations(ContinuationVecType& continuations) const;
+    // live value struct of each continuation (unpadded, same order as above)
+    void getLiveValueStructTypes(SmallVector<const StructType*, 4>& types) const;
 
     typedef DenseMap<unsigned, BarrierInfo*> ContinuationMapType;
     ContinuationMapType* getContinuationMap();
@@ -0,0 +1,410 @@
+/**
+ * @file   simdMath.cpp
+ * @date   18.10.2026
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See the COPYING file in the root directory for details.
+ *
+ * Copyright (C) 2010, 2011 Saarland University
+ *
+ */
+#include "simdMath.hpp"
+#include "llvmTools.hpp"
+
+#include <cmath>    // HUGE_VAL
+#include <limits>   // quiet_NaN
+#include <sstream>
+
+// SIMD versions of the float math builtins. Without them, the packetizer
+// splits every call to a math function into one scalar call per lane.
+//
+// The functions are generated as LLVM IR for vectors of arbitrary width, so
+// the same code is used for SSE (4 lanes) and AVX (8 lanes). The algorithms
+// are the ones of the Cephes library (single precision versions) with range
+// reduction and polynomial approximation.
+
+namespace WFVOpenCL {
+
+// The math functions of which SIMD versions exist. The scalar names are the
+// ones that fixFunctionNames() maps the builtins of clc to.
+enum SimdMathKind {
+    SIMD_MATH_SQRT,
+    SIMD_MATH_EXP,
+    SIMD_MATH_LOG,
+    SIMD_MATH_SIN,
+    SIMD_MATH_COS,
+    SIMD_MATH_POW,
+    SIMD_MATH_NONE
+};
+
+struct SimdMathFunction {
+    const char* scalarName;
+    const char* name;
+    SimdMathKind kind;
+};
+
+static const SimdMathFunction simdMathFunctions[] = {
+    { "llvm.sqrt.f32", "sqrt", SIMD_MATH_SQRT },
+    { "llvm.exp.f32",  "exp",  SIMD_MATH_EXP },
+    { "llvm.log.f32",  "log",  SIMD_MATH_LOG },
+    { "llvm.sin.f32",  "sin",  SIMD_MATH_SIN },
+    { "llvm.cos.f32",  "cos",  SIMD_MATH_COS },
+    { "powf",          "pow",  SIMD_MATH_POW },
+    { NULL, NULL, SIMD_MATH_NONE }
+};
+
+static const SimdMathFunction* findSimdMathFunction(const std::string& scalarName) {
+    for (const SimdMathFunction* fn=simdMathFunctions; fn->scalarName; ++fn) {
+        if (scalarName == fn->scalarName) return fn;
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------------//
+// helpers (all constants are splatted to the vector type of the operation)
+//----------------------------------------------------------------------------//
+
+static Constant* splat(const Type* type, const double value) {
+    return ConstantFP::get(type, value);
+}
+static Constant* splatInt(const Type* type, const int value) {
+    return ConstantInt::get(type, (uint64_t)(int64_t)value, true);
+}
+
+// Converts a vector of i1 (result of a comparison) to a mask with all bits
+// set in the lanes where the comparison is true.
+static Value* createMask(IRBuilder<>& builder, Value* cmp, const Type* intType) {
+    return builder.CreateSExt(cmp, intType);
+}
+
+// Returns 'a' in the lanes where 'mask' is set, 'b' otherwise.
+static Value* createSelect(IRBuilder<>& builder, Value* mask, Value* a, Value* b) {
+    const Type* type = a->getType();
+    const Type* intType = mask->getType();
+    Value* ai = builder.CreateAnd(mask, builder.CreateBitCast(a, intType));
+    Value* bi = builder.CreateAnd(builder.CreateNot(mask), builder.CreateBitCast(b, intType));
+    return builder.CreateBitCast(builder.CreateOr(ai, bi), type);
+}
+
+static Value* createAbs(IRBuilder<>& builder, Value* x, const Type* intType) {
+    Value* bits = builder.CreateBitCast(x, intType);
+    return builder.CreateBitCast(builder.CreateAnd(bits, splatInt(intType, 0x7fffffff)), x->getType());
+}
+
+static Value* createMin(IRBuilder<>& builder, Value* x, Value* limit, const Type* intType) {
+    return createSelect(builder, createMask(builder, builder.CreateFCmpOLT(x, limit), intType), x, limit);
+}
+static Value* createMax(IRBuilder<>& builder, Value* x, Value* limit, const Type* intType) {
+    return createSelect(builder, createMask(builder, builder.CreateFCmpOGT(x, limit), intType), x, limit);
+}
+
+// Horner scheme, the coefficients start with the one of the highest degree.
+static Value* createPolynomial(IRBuilder<>& builder, Value* x, const double* coefficients, const unsigned numCoefficients) {
+    assert (numCoefficients > 0);
+    const Type* type = x->getType();
+    Value* y = splat(type, coefficients[0]);
+    for (unsigned i=1; i<numCoefficients; ++i) {
+        y = builder.CreateFAdd(builder.CreateFMul(y, x), splat(type, coefficients[i]));
+    }
+    return y;
+}
+
+// Returns true if the mask is set in any of the lanes.
+static Value* createAnyLane(IRBuilder<>& builder, Value* mask, const unsigned simdWidth) {
+    const Type* i32Type = Type::getInt32Ty(mask->getContext());
+    Value* any = builder.CreateExtractElement(mask, ConstantInt::get(i32Type, 0));
+    for (unsigned i=1; i<simdWidth; ++i) {
+        any = builder.CreateOr(any, builder.CreateExtractElement(mask, ConstantInt::get(i32Type, i)));
+    }
+    return builder.CreateICmpNE(any, ConstantInt::get(i32Type, 0));
+}
+
+//----------------------------------------------------------------------------//
+// vector code
+//----------------------------------------------------------------------------//
+
+// exp(x) = 2^n * exp(r) with n = round(x/ln(2)), |r| <= ln(2)/2
+static Value* createExp(IRBuilder<>& builder, Value* x, const Type* intType) {
+    const Type* type = x->getType();
+    x = createMin(builder, x, splat(type, 88.3762626647949), intType);
+    x = createMax(builder, x, splat(type, -88.3762626647949), intType);
+
+    // n = floor(x/ln(2) + 0.5) (conversion truncates towards zero)
+    Value* fx = builder.CreateFAdd(builder.CreateFMul(x, splat(type, 1.44269504088896341)), splat(type, 0.5));
+    Value* t = builder.CreateSIToFP(builder.CreateFPToSI(fx, intType), type);
+    Value* adjust = createSelect(builder, createMask(builder, builder.CreateFCmpOGT(t, fx), intType), splat(type, 1.0), splat(type, 0.0));
+    fx = builder.CreateFSub(t, adjust);
+
+    // r = x - n*ln(2) (ln(2) in two parts for higher precision)
+    x = builder.CreateFSub(x, builder.CreateFMul(fx, splat(type, 0.693359375)));
+    x = builder.CreateFSub(x, builder.CreateFMul(fx, splat(type, -2.12194440e-4)));
+
+    static const double coefficients[] = {
+        1.9875691500E-4, 1.3981999507E-3, 8.3334519073E-3,
+        4.1665795894E-2, 1.6666665459E-1, 5.0000001201E-1
+    };
+    Value* z = builder.CreateFMul(x, x);
+    Value* y = createPolynomial(builder, x, coefficients, 6);
+    y = builder.CreateFAdd(builder.CreateFMul(y, z), x);
+    y = builder.CreateFAdd(y, splat(type, 1.0));
+
+    // 2^n is built directly from the exponent bits
+    Value* n = builder.CreateFPToSI(fx, intType);
+    n = builder.CreateShl(builder.CreateAdd(n, splatInt(intType, 127)), splatInt(intType, 23));
+    return builder.CreateFMul(y, builder.CreateBitCast(n, type));
+}
+
+// log(x) = e*ln(2) + log(m) with x = m*2^e, sqrt(0.5) <= m < sqrt(2)
+// (x has to be positive and normalized)
+static Value* createLog(IRBuilder<>& builder, Value* x, const Type* intType) {
+    const Type* type = x->getType();
+    Value* bits = builder.CreateBitCast(x, intType);
+
+    // split into mantissa in [0.5, 1) and exponent
+    Value* e = builder.CreateSub(builder.CreateLShr(bits, splatInt(intType, 23)), splatInt(intType, 126));
+    Value* fe = builder.CreateSIToFP(e, type);
+    Value* m = builder.CreateAnd(bits, splatInt(intType, ~0x7f800000));
+    m = builder.CreateBitCast(builder.CreateOr(m, builder.CreateBitCast(splat(type, 0.5), intType)), type);
+
+    // if m < sqrt(0.5): e = e-1, m = 2m-1, else m = m-1
+    Value* small = createMask(builder, builder.CreateFCmpOLT(m, splat(type, 0.707106781186547524)), intType);
+    fe = builder.CreateFSub(fe, createSelect(builder, small, splat(type, 1.0), splat(type, 0.0)));
+    Value* tmp = createSelect(builder, small, m, splat(type, 0.0));
+    m = builder.CreateFAdd(builder.CreateFSub(m, splat(type, 1.0)), tmp);
+
+    static const double coefficients[] = {
+        7.0376836292E-2, -1.1514610310E-1, 1.1676998740E-1,
+        -1.2420140846E-1, 1.4249322787E-1, -1.6668057665E-1,
+        2.0000714765E-1, -2.4999993993E-1, 3.3333331174E-1
+    };
+    Value* z = builder.CreateFMul(m, m);
+    Value* y = createPolynomial(builder, m, coefficients, 9);
+    y = builder.CreateFMul(builder.CreateFMul(y, m), z);
+
+    // add e*ln(2) (in two parts for higher precision)
+    y = builder.CreateFAdd(y, builder.CreateFMul(fe, splat(type, -2.12194440e-4)));
+    y = builder.CreateFSub(y, builder.CreateFMul(z, splat(type, 0.5)));
+    Value* r = builder.CreateFAdd(m, y);
+    return builder.CreateFAdd(r, builder.CreateFMul(fe, splat(type, 0.693359375)));
+}
+
+// pow(x, y) = exp(y*log(|x|)), negated for a negative x and an odd integer
+// y, NaN for a negative x and a y that is no integer. A zero x yields 0,
+// 1 or infinity (signed like x for an odd y) depending on the sign of y.
+static Value* createPow(IRBuilder<>& builder, Value* x, Value* y, const Type* intType) {
+    const Type* type = x->getType();
+    Value* ax = createAbs(builder, x, intType);
+    Value* r = createExp(builder, builder.CreateFMul(y, createLog(builder, ax, intType)), intType);
+
+    Value* zeroResult = createSelect(builder, createMask(builder, builder.CreateFCmpOGT(y, splat(type, 0.0)), intType),
+                                     splat(type, 0.0),
+                                     createSelect(builder, createMask(builder, builder.CreateFCmpOEQ(y, splat(type, 0.0)), intType),
+                                                  splat(type, 1.0), splat(type, HUGE_VAL)));
+    r = createSelect(builder, createMask(builder, builder.CreateFCmpOEQ(ax, splat(type, 0.0)), intType), zeroResult, r);
+
+    // floats of at least 2^24 are even integers (and may not fit into an int)
+    Value* ay = createAbs(builder, y, intType);
+    Value* large = createMask(builder, builder.CreateFCmpOGE(ay, splat(type, 16777216.0)), intType);
+    Value* yi = builder.CreateFPToSI(createMin(builder, ay, splat(type, 16777216.0), intType), intType);
+    Value* integer = builder.CreateOr(large, createMask(builder, builder.CreateFCmpOEQ(builder.CreateSIToFP(yi, type), ay), intType));
+    Value* odd = builder.CreateAnd(builder.CreateNot(large),
+                                   builder.CreateSub(splatInt(intType, 0), builder.CreateAnd(yi, splatInt(intType, 1))));
+
+    // the sign of x is kept for odd exponents (also for -0)
+    Value* signBit = builder.CreateAnd(builder.CreateAnd(builder.CreateBitCast(x, intType), splatInt(intType, (int)0x80000000)), odd);
+    r = builder.CreateBitCast(builder.CreateXor(builder.CreateBitCast(r, intType), signBit), type);
+
+    Value* negative = createMask(builder, builder.CreateFCmpOLT(x, splat(type, 0.0)), intType);
+    Value* nan = splat(type, std::numeric_limits<double>::quiet_NaN());
+    return createSelect(builder, builder.CreateAnd(negative, builder.CreateNot(integer)), nan, r);
+}
+
+// Reduces x to the octant [-pi/4, pi/4] and evaluates the sine or cosine
+// polynomial depending on the octant (precise for |x| <= 8192).
+static Value* createSinCos(IRBuilder<>& builder, Value* x, const Type* intType, const bool cosine) {
+    const Type* type = x->getType();
+    Value* signBit = cosine ?
+        static_cast<Value*>(splatInt(intType, 0)) :
+        builder.CreateAnd(builder.CreateBitCast(x, intType), splatInt(intType, (int)0x80000000));
+    x = createAbs(builder, x, intType);
+
+    // j = octant of x, rounded up to an even number
+    Value* j = builder.CreateFPToSI(builder.CreateFMul(x, splat(type, 1.27323954473516)), intType);
+    j = builder.CreateAnd(builder.CreateAdd(j, splatInt(intType, 1)), splatInt(intType, ~1));
+    Value* y = builder.CreateSIToFP(j, type);
+    if (cosine) j = builder.CreateSub(j, splatInt(intType, 2));
+
+    Value* swapSign = cosine ?
+        builder.CreateAnd(builder.CreateNot(j), splatInt(intType, 4)) :
+        builder.CreateAnd(j, splatInt(intType, 4));
+    signBit = builder.CreateXor(signBit, builder.CreateShl(swapSign, splatInt(intType, 29)));
+    Value* sinPolynomial = createMask(builder, builder.CreateICmpEQ(builder.CreateAnd(j, splatInt(intType, 2)), splatInt(intType, 0)), intType);
+
+    // x = x - j*pi/4 (pi/4 in three parts for higher precision)
+    x = builder.CreateFSub(x, builder.CreateFMul(y, splat(type, 0.78515625)));
+    x = builder.CreateFSub(x, builder.CreateFMul(y, splat(type, 2.4187564849853515625e-4)));
+    x = builder.CreateFSub(x, builder.CreateFMul(y, splat(type, 3.77489497744594108e-8)));
+    Value* z = builder.CreateFMul(x, x);
+
+    static const double cosCoefficients[] = {
+        2.443315711809948E-5, -1.388731625493765E-3, 4.166664568298827E-2
+    };
+    Value* yc = createPolynomial(builder, z, cosCoefficients, 3);
+    yc = builder.CreateFMul(builder.CreateFMul(yc, z), z);
+    yc = builder.CreateFSub(yc, builder.CreateFMul(z, splat(type, 0.5)));
+    yc = builder.CreateFAdd(yc, splat(type, 1.0));
+
+    static const double sinCoefficients[] = {
+        -1.9515295891E-4, 8.3321608736E-3, -1.6666654611E-1
+    };
+    Value* ys = createPolynomial(builder, z, sinCoefficients, 3);
+    ys = builder.CreateFAdd(builder.CreateFMul(builder.CreateFMul(ys, z), x), x);
+
+    Value* r = createSelect(builder, sinPolynomial, ys, yc);
+    return builder.CreateBitCast(builder.CreateXor(builder.CreateBitCast(r, intType), signBit), type);
+}
+
+// Returns the mask of lanes for which the result of the vector code is not
+// precise enough (the full precision versions call the scalar function for
+// them).
+static Value* createSlowLanesMask(IRBuilder<>& builder, const SimdMathKind kind, Value* x, Value* y, const Type* intType) {
+    const Type* type = x->getType();
+    switch (kind) {
+        case SIMD_MATH_EXP:
+            // overflow, denormal results, NaN
+            return createMask(builder, builder.CreateFCmpUGT(createAbs(builder, x, intType), splat(type, 87.0)), intType);
+        case SIMD_MATH_SIN:
+        case SIMD_MATH_COS:
+            // range reduction loses precision, infinity, NaN
+            return createMask(builder, builder.CreateFCmpUGT(createAbs(builder, x, intType), splat(type, 8192.0)), intType);
+        case SIMD_MATH_LOG:
+        case SIMD_MATH_POW: {
+            // x not positive, denormal, infinity, NaN
+            Value* fast = builder.CreateAnd(
+                createMask(builder, builder.CreateFCmpOGE(x, splat(type, 1.17549435e-38)), intType),
+                createMask(builder, builder.CreateFCmpOLT(x, splat(type, HUGE_VAL)), intType));
+            if (kind == SIMD_MATH_POW) {
+                // The error of y*log(x) grows with its magnitude, exp()
+                // amplifies it.
+                Value* t = builder.CreateFMul(y, createLog(builder, x, intType));
+                fast = builder.CreateAnd(fast, createMask(builder, builder.CreateFCmpOLE(createAbs(builder, t, intType), splat(type, 8.0)), intType));
+            }
+            return builder.CreateNot(fast);
+        }
+        default:
+            assert (false && "math function has no slow path!");
+            return NULL;
+    }
+}
+
+static Value* createVectorCode(IRBuilder<>& builder, const SimdMathKind kind, Value* x, Value* y, const Type* intType, Module* mod) {
+    switch (kind) {
+        case SIMD_MATH_SQRT: {
+            // llvm.sqrt is overloaded for vectors and precise (sqrtps)
+            std::stringstream strs;
+            strs << "llvm.sqrt.v" << cast<VectorType>(x->getType())->getNumElements() << "f32";
+            Function* sqrtFn = mod->getFunction(strs.str());
+            if (!sqrtFn) {
+                std::vector<const Type*> params(1, x->getType());
+                sqrtFn = createExternalFunction(strs.str(), x->getType(), params, mod);
+            }
+            return builder.CreateCall(sqrtFn, x);
+        }
+        case SIMD_MATH_EXP: return createExp(builder, x, intType);
+        case SIMD_MATH_LOG: return createLog(builder, x, intType);
+        case SIMD_MATH_SIN: return createSinCos(builder, x, intType, false);
+        case SIMD_MATH_COS: return createSinCos(builder, x, intType, true);
+        case SIMD_MATH_POW: return createPow(builder, x, y, intType);
+        default:
+            assert (false && "unknown math function!");
+            return NULL;
+    }
+}
+
+bool hasSimdMathFunction(const std::string& scalarName) {
+    return findSimdMathFunction(scalarName) != NULL;
+}
+
+// generates e.g.
+// define internal <4 x float> @wfvocl_sin_v4f32(<4 x float> %x) {
+// entry:   fast = <vector code>, br <any lane out of range>, slow, exit
+// slow:    call the scalar function for every lane
+// exit:    phi [fast, entry], [slow, slow]
+// }
+Function* getSimdMathFunction(const std::string& scalarName, Module* mod, const unsigned simdWidth, const bool relaxed) {
+    assert (mod);
+    assert (simdWidth > 1);
+    const SimdMathFunction* info = findSimdMathFunction(scalarName);
+    if (!info) return NULL;
+
+    std::stringstream strs;
+    strs << "wfvocl_" << info->name << "_v" << simdWidth << "f32";
+    if (relaxed) strs << "_relaxed";
+    const std::string name = strs.str();
+    if (Function* fn = mod->getFunction(name)) return fn;
+
+    LLVMContext& context = mod->getContext();
+    const Type* floatType = Type::getFloatTy(context);
+    const Type* vectorType = VectorType::get(floatType, simdWidth);
+    const Type* intType = VectorType::get(Type::getInt32Ty(context), simdWidth);
+    const bool binary = info->kind == SIMD_MATH_POW;
+
+    std::vector<const Type*> params(binary ? 2 : 1, vectorType);
+    Function* fn = Function::Create(FunctionType::get(vectorType, params, false), Function::InternalLinkage, name, mod);
+    fn->setDoesNotThrow();
+    fn->setDoesNotAccessMemory();
+    Function::arg_iterator A = fn->arg_begin();
+    Value* x = A++;
+    x->setName("x");
+    Value* y = NULL;
+    if (binary) {
+        y = A++;
+        y->setName("y");
+    }
+
+    BasicBlock* entryBB = BasicBlock::Create(context, "entry", fn);
+    IRBuilder<> builder(entryBB);
+    Value* fast = createVectorCode(builder, info->kind, x, y, intType, mod);
+
+    // sqrt is always precise
+    if (relaxed || info->kind == SIMD_MATH_SQRT) {
+        builder.CreateRet(fast);
+        return fn;
+    }
+
+    // The scalar function is called for all lanes if any of them needs it,
+    // this is rare for the inputs that occur in practice.
+    Function* scalarFn = mod->getFunction(scalarName);
+    if (!scalarFn) {
+        std::vector<const Type*> scalarParams(binary ? 2 : 1, floatType);
+        scalarFn = createExternalFunction(scalarName, floatType, scalarParams, mod);
+    }
+
+    BasicBlock* slowBB = BasicBlock::Create(context, "slow", fn);
+    BasicBlock* exitBB = BasicBlock::Create(context, "exit", fn);
+    Value* slowLanes = createSlowLanesMask(builder, info->kind, x, y, intType);
+    builder.CreateCondBr(createAnyLane(builder, slowLanes, simdWidth), slowBB, exitBB);
+
+    builder.SetInsertPoint(slowBB);
+    const Type* i32Type = Type::getInt32Ty(context);
+    Value* slow = UndefValue::get(vectorType);
+    for (unsigned i=0; i<simdWidth; ++i) {
+        Constant* index = ConstantInt::get(i32Type, i);
+        Value* xi = builder.CreateExtractElement(x, index);
+        Value* ri = binary ?
+            builder.CreateCall2(scalarFn, xi, builder.CreateExtractElement(y, index)) :
+            builder.CreateCall(scalarFn, xi);
+        slow = builder.CreateInsertElement(slow, ri, index);
+    }
+    builder.CreateBr(exitBB);
+
+    builder.SetInsertPoint(exitBB);
+    PHINode* result = builder.CreatePHI(vectorType, "result");
+    result->addIncoming(fast, entryBB);
+    result->addIncoming(slow, slowBB);
+    builder.CreateRet(result);
+
+    return fn;
+}
+
+}
@@ -0,0 +1,33 @@
+/**
+ * @file   simdMath.hpp
+ * @date   18.10.2026
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See the COPYING file in the root directory for details.
+ *
+ * Copyright (C) 2010, 2011 Saarland University
+ *
+ */
+#ifndef _SIMDMATH_H
+#define _SIMDMATH_H
+
+#include <string>
+
+#include "llvm/Module.h"
+
+using namespace llvm;
+
+namespace WFVOpenCL {
+    // Returns true if a SIMD version of the scalar math function 'scalarName'
+    // (e.g. "llvm.sin.f32" or "powf", see fixFunctionNames()) is available.
+    bool hasSimdMathFunction(const std::string& scalarName);
+
+    // Returns the SIMD version of the scalar math function 'scalarName' that
+    // operates on vectors of 'simdWidth' floats. It is generated into 'mod'
+    // on first request. The full precision versions fall back to the scalar
+    // function if any of the lanes is out of the range of the vector code,
+    // the relaxed versions (-cl-fast-relaxed-math) do not.
+    Function* getSimdMathFunction(const std::string& scalarName, Module* mod, const unsigned simdWidth, const bool relaxed);
+}
+
+#endif /* _SIMDMATH_H */
@@ -12,20 +12,68 @@
 
 #include <cstddef>
 
+#include <algorithm> // std::min
+#include <cstdlib> // getenv
+#include <cstring> // strcmp
+#include <deque>
+#include <iomanip> // std::setw
+#include <map>
+#include <set>
 #include <sstream>
+#include <vector>
 
 #include <xmmintrin.h>
 
+#include <fstream> // /sys/devices/system/node
+
+#ifdef _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX // windows.h must not define min/max macros
+#   endif
+#include <windows.h> // SetThreadAffinityMask, GetNumaProcessorNode
+#include <direct.h> // _mkdir
+#include <malloc.h> // _aligned_malloc
+#else
+#include <pthread.h> // pthread_create
+#include <sys/mman.h> // mmap, madvise
+#include <sys/stat.h> // mkdir
+#include <unistd.h> // sysconf, getpid
+#include <dlfcn.h> // dladdr
+#endif
+#ifdef __APPLE__
+#include <sys/types.h>
+#include <sys/sysctl.h> // sysctlbyname
+#endif
+#ifdef __linux__
+#include <sched.h> // sched_setaffinity
+#include <sys/syscall.h> // SYS_mbind
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h> // __cpuid, _xgetbv
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h> // __get_cpuid
+#endif
+
+#ifdef _WIN32
+#   define WFVOPENCL_THREAD_LOCAL __declspec(thread)
+#else
+#   define WFVOPENCL_THREAD_LOCAL __thread
+#endif
+
 #ifdef __APPLE__
 #include <OpenCL/cl.h>
+#include <OpenCL/cl_ext.h>
 #else
 #include <CL/cl.h>
+#include <CL/cl_ext.h>
 #endif
 
 #include "passes/continuationGenerator.h"
 #include "consts.h"
 #include "debug.h"
 #include "llvmTools.hpp"
+#include "builtinLibrary.hpp"
+#include "wfvOpenCL.h"
 
 //----------------------------------------------------------------------------//
 // Tools
@@ -64,6 +112,52 @@ extern "C" {
 namespace WFVOpenCL {
 
 #ifndef WFVOPENCL_NO_WFV
+        // Collects the statistics of 'info' from the vectorization analysis
+        // of a copy of 'f' (the analysis may modify the function it is run
+        // on).
+        static void analyzeKernelFunction(
+            Function* f,
+            const cl_uint packetizationSize,
+            const cl_uint simdDim,
+            const bool use_sse41,
+            const bool use_avx,
+            const bool relaxedMath,
+            const bool alignedPointers,
+            VectorizationInfo& info)
+    {
+        assert (f);
+        Module* mod = f->getParent();
+        Function* copy = CloneFunction(f);
+        copy->setName(f->getNameStr() + "_analysis");
+        mod->getFunctionList().push_back(copy);
+        Function* target = WFVOpenCL::createExternalFunction(copy->getNameStr() + "_SIMD", copy->getFunctionType(), mod);
+
+        {
+            Packetizer::Packetizer packetizer(*mod, packetizationSize, packetizationSize, use_sse41, use_avx, false);
+            WFVOpenCL::addNativeFunctions(copy, simdDim, packetizer, relaxedMath, alignedPointers);
+
+            if (packetizer.analyzeFunction(copy->getNameStr(), target->getNameStr())) {
+                for (Function::iterator BB=copy->begin(), BBE=copy->end(); BB!=BBE; ++BB) {
+                    for (BasicBlock::iterator I=BB->begin(), IE=BB->end(); I!=IE; ++I) {
+                        if (LoadInst* load = dyn_cast<LoadInst>(I)) {
+                            const Value* ptr = load->getPointerOperand();
+                            if (!packetizer.isUniform(ptr) && !packetizer.isConsecutive(ptr)) ++info.numGathers;
+                        } else if (StoreInst* store = dyn_cast<StoreInst>(I)) {
+                            const Value* ptr = store->getPointerOperand();
+                            if (!packetizer.isUniform(ptr) && !packetizer.isConsecutive(ptr)) ++info.numScatters;
+                        }
+                        if (I->getType()->isVoidTy()) continue;
+                        if (packetizer.isUniform(I)) ++info.numUniformValues;
+                        else ++info.numVaryingValues;
+                    }
+                }
+            }
+        }
+
+        target->eraseFromParent();
+        copy->eraseFromParent();
+    }
+
         bool packetizeKernelFunction(
             const std::string& kernelName,
             const std::string& targetKernelName,
@@ -72,32 +166,54 @@ namespace WFVOpenCL {
             const cl_uint simdDim,
             const bool use_sse41,
             const bool use_avx,
-            const bool verbose)
+            const bool verbose,
+            const bool relaxedMath,
+            const bool alignedPointers,
+            VectorizationInfo* info)
     {
+        // Kernels are generated by several threads (see createKernels()),
+        // each in its own LLVMContext. The packetizer library does not
+        // guarantee that it keeps no state across instances, so only one
+        // thread at a time runs it.
+        DriverLockGuard guard(DRIVER_LOCK_PACKETIZER);
+        // The outcome is only recorded for the generic version of a kernel,
+        // not for its variants (the analysis packetizes a copy of it).
+        VectorizationInfo ignoredInfo;
+        VectorizationInfo& result = info ? *info : ignoredInfo;
+        result.simdDim = -1;
         if (!WFVOpenCL::getFunction(kernelName, mod)) {
             errs() << "ERROR: source function '" << kernelName
                     << "' not found in module!\n";
+            result.failure = VECTORIZATION_INTERNAL_ERROR;
             return false;
         }
         if (!WFVOpenCL::getFunction(targetKernelName, mod)) {
             errs() << "ERROR: target function '" << targetKernelName
                     << "' not found in module!\n";
+            result.failure = VECTORIZATION_INTERNAL_ERROR;
             return false;
         }
 
+        if (info) {
+            analyzeKernelFunction(WFVOpenCL::getFunction(kernelName, mod), packetizationSize, simdDim, use_sse41, use_avx, relaxedMath, alignedPointers, *info);
+        }
+
         Packetizer::Packetizer packetizer(*mod, packetizationSize, packetizationSize, use_sse41, use_avx, verbose);
 
         packetizer.addFunction(kernelName, targetKernelName);
 
-        WFVOpenCL::addNativeFunctions(WFVOpenCL::getFunction(kernelName, mod), simdDim, packetizer);
+        WFVOpenCL::addNativeFunctions(WFVOpenCL::getFunction(kernelName, mod), simdDim, packetizer, relaxedMath, alignedPointers);
 
         packetizer.run();
 
         // check if the function has been vectorized
         if (mod->getFunction(targetKernelName)->getBasicBlockList().empty()) {
+            result.failure = VECTORIZATION_PACKETIZER_FAILED;
             return false;
         }
 
+        result.failure = VECTORIZATION_SUCCEEDED;
+        result.simdDim = (int)simdDim;
         return true;
     }
 #endif
@@ -594,9 +710,130 @@ namespace WFVOpenCL {
         }
     }
 
-    // TODO: implement some kind of heuristic
+    // Returns the dimension if 'value' is a call to get_global_id() or
+    // get_local_id() with a constant argument, -1 otherwise.
+    static int getWorkItemIdDimension(const Value* value) {
+        const CallInst* call = dyn_cast<CallInst>(value);
+        if (!call || !call->getCalledFunction()) return -1;
+        const StringRef fnName = call->getCalledFunction()->getName();
+        if (!fnName.equals("get_global_id") && !fnName.equals("get_local_id")) return -1;
+        const ConstantInt* dimConst = dyn_cast<ConstantInt>(call->getArgOperand(0));
+        return dimConst ? (int)dimConst->getZExtValue() : -1;
+    }
+
+    // Returns true if 'value' is computed from the work item id of the given
+    // dimension (if it is not, it is the same for all work items of a SIMD
+    // packet in that dimension).
+    static bool dependsOnDimension(const Value* value, const unsigned dim, std::set<const Value*>& visited) {
+        const Instruction* inst = dyn_cast<Instruction>(value);
+        if (!inst || !visited.insert(inst).second) return false;
+        if (getWorkItemIdDimension(inst) == (int)dim) return true;
+        for (Instruction::const_op_iterator O=inst->op_begin(), OE=inst->op_end(); O!=OE; ++O) {
+            if (dependsOnDimension(*O, dim, visited)) return true;
+        }
+        return false;
+    }
+
+    static bool isMultipleOfSimdWidth(const Value* value) {
+        if (const ConstantInt* c = dyn_cast<ConstantInt>(value)) {
+            return c->getZExtValue() % getSimdWidth() == 0;
+        }
+        const Instruction* inst = dyn_cast<Instruction>(value);
+        if (!inst) return false;
+        switch (inst->getOpcode()) {
+            case Instruction::SExt:
+            case Instruction::ZExt:
+                return isMultipleOfSimdWidth(inst->getOperand(0));
+            case Instruction::Mul:
+                return isMultipleOfSimdWidth(inst->getOperand(0)) || isMultipleOfSimdWidth(inst->getOperand(1));
+            case Instruction::Add:
+                return isMultipleOfSimdWidth(inst->getOperand(0)) && isMultipleOfSimdWidth(inst->getOperand(1));
+            case Instruction::Shl: {
+                const ConstantInt* c = dyn_cast<ConstantInt>(inst->getOperand(1));
+                return c && c->getZExtValue() < 32 && (1U << c->getZExtValue()) % getSimdWidth() == 0;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // Returns true if 'index' is the work item id of the given dimension plus
+    // a value that is the same for all work items of a SIMD packet, i.e. if
+    // the work items access consecutive elements. 'aligned' is cleared if the
+    // offset is not known to be a multiple of the SIMD width.
+    static bool isConsecutiveInDimension(const Value* index, const unsigned dim, bool& aligned) {
+        if (getWorkItemIdDimension(index) == (int)dim) return true;
+        const Instruction* inst = dyn_cast<Instruction>(index);
+        if (!inst) return false;
+
+        std::set<const Value*> visited;
+        switch (inst->getOpcode()) {
+            case Instruction::SExt:
+            case Instruction::ZExt:
+            case Instruction::Trunc:
+                return isConsecutiveInDimension(inst->getOperand(0), dim, aligned);
+            case Instruction::Add:
+                for (unsigned i=0; i<2; ++i) {
+                    const Value* offset = inst->getOperand(1-i);
+                    bool operand_aligned = aligned;
+                    if (!isConsecutiveInDimension(inst->getOperand(i), dim, operand_aligned)) continue;
+                    if (dependsOnDimension(offset, dim, visited)) return false;
+                    aligned = operand_aligned && isMultipleOfSimdWidth(offset);
+                    return true;
+                }
+                return false;
+            case Instruction::Sub: {
+                const Value* offset = inst->getOperand(1);
+                if (!isConsecutiveInDimension(inst->getOperand(0), dim, aligned)) return false;
+                if (dependsOnDimension(offset, dim, visited)) return false;
+                aligned = aligned && isMultipleOfSimdWidth(offset);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // Chooses the dimension that is vectorized: the one in which most memory
+    // accesses of the kernel are consecutive (e.g. 'x' in data[y*width + x]),
+    // which allows to use vector loads and stores instead of gathers and
+    // scatters. Accesses that are also aligned count twice. If no other
+    // dimension is better, we stay with dimension 0.
     unsigned getBestSimdDim(Function* f, const unsigned num_dimensions) {
-        return 0;
+        assert (f);
+        assert (num_dimensions > 0);
+        std::vector<unsigned> score(num_dimensions, 0);
+
+        for (Function::iterator BB=f->begin(), BBE=f->end(); BB!=BBE; ++BB) {
+            for (BasicBlock::iterator I=BB->begin(), IE=BB->end(); I!=IE; ++I) {
+                const Value* pointer = NULL;
+                if (const LoadInst* load = dyn_cast<LoadInst>(I)) pointer = load->getPointerOperand();
+                else if (const StoreInst* store = dyn_cast<StoreInst>(I)) pointer = store->getPointerOperand();
+                else continue;
+
+                // only pointer arithmetic on buffers (data[index])
+                const GetElementPtrInst* gep = dyn_cast<GetElementPtrInst>(pointer->stripPointerCasts());
+                if (!gep || gep->getNumIndices() != 1) continue;
+                const Value* index = *gep->idx_begin();
+
+                for (unsigned dim=0; dim<num_dimensions; ++dim) {
+                    bool aligned = true;
+                    if (!isConsecutiveInDimension(index, dim, aligned)) continue;
+                    score[dim] += aligned ? 2 : 1;
+                }
+            }
+        }
+
+        unsigned best_dim = 0;
+        for (unsigned dim=1; dim<num_dimensions; ++dim) {
+            if (score[dim] > score[best_dim]) best_dim = dim;
+        }
+        WFVOPENCL_DEBUG(
+            outs() << "SIMD dimension scores of kernel '" << f->getNameStr() << "':";
+            for (unsigned dim=0; dim<num_dimensions; ++dim) outs() << " " << score[dim];
+            outs() << " -> " << best_dim << "\n";
+        );
+        return best_dim;
     }
     unsigned determineNumDimensionsUsed(Function* f) {
         unsigned max_dim = 1;
@@ -973,7 +1210,7 @@ namespace WFVOpenCL {
             // fall back to increments of 1 if vectorization failed
             const uint64_t incInt =
                 (simd_dim == -1 ? 1 :
-                    (i == simd_dim ? WFVOPENCL_SIMD_WIDTH : 1U));
+                    (i == simd_dim ? WFVOpenCL::getSimdWidth() : 1U));
 #endif
             BinaryOperator* loopCounterInc = BinaryOperator::Create(Instruction::Add, loopCounterPhi, ConstantInt::get(counterType, incInt, false), "inc", latchBB);
             ICmpInst* exitcond1 = new ICmpInst(*latchBB, ICmpInst::ICMP_UGE, loopCounterInc, local_size, "exitcond");
@@ -1305,7 +1542,7 @@ namespace WFVOpenCL {
         delete [] local_ids;
     }
 
-    Function* createKernel(Function* f, const std::string& kernel_name, const unsigned num_dimensions, int simd_dim, Module* module, TargetData* targetData, LLVMContext& context, cl_int* errcode_ret, Function** f_SIMD_ret) {
+    Function* createKernel(Function* f, const std::string& kernel_name, const unsigned num_dimensions, int simd_dim, Module* module, TargetData* targetData, LLVMContext& context, cl_int* errcode_ret, Function** f_SIMD_ret, const unsigned optimizationLevel, const bool relaxedMath, const bool alignedPointers, CompileReport* report, VectorizationInfo* vectorization) {
         assert (f && module && targetData);
         assert (num_dimensions > 0 && num_dimensions < 4);
         assert (simd_dim < (int)num_dimensions);
@@ -1313,20 +1550,27 @@ namespace WFVOpenCL {
 #ifdef WFVOPENCL_NO_WFV
         assert (simd_dim == -1); // packetization disabled: only -1 is a valid value
         assert (!f_SIMD_ret);
+        if (vectorization) {
+            vectorization->failure = VECTORIZATION_DISABLED;
+            vectorization->simdDim = -1;
+        }
 
         std::stringstream strs;
         strs << kernel_name;
 #else
-        assert (simd_dim >= 0); // packetization enabled: 0, 1, 2 are valid values
-        assert (f_SIMD_ret);
+        // packetization enabled: 0, 1, 2 are valid values, -1 generates the
+        // scalar variant of a vectorized kernel (see KERNEL_VARIANT_SCALAR)
+        assert (simd_dim >= -1);
+        assert (f_SIMD_ret || simd_dim == -1);
 
         // generate packet prototype
         std::stringstream strs;
-        strs << kernel_name << "_SIMD";
+        strs << kernel_name << (simd_dim >= 0 ? "_SIMD" : "");
         const std::string kernel_simd_name = strs.str();
 
-        llvm::Function* f_SIMD = WFVOpenCL::createExternalFunction(kernel_simd_name, f->getFunctionType(), module);
-        if (!f_SIMD) {
+        llvm::Function* f_SIMD = simd_dim < 0 ? NULL :
+            WFVOpenCL::createExternalFunction(kernel_simd_name, f->getFunctionType(), module);
+        if (simd_dim >= 0 && !f_SIMD) {
             errs() << "ERROR: could not create packet prototype for kernel '" << kernel_simd_name << "'!\n";
             return NULL;
         }
@@ -1339,26 +1583,31 @@ namespace WFVOpenCL {
         // packetize scalar function into SIMD function
         WFVOPENCL_DEBUG( WFVOpenCL::writeFunctionToFile(f, "debug_kernel_pre_packetization.ll"); );
 
-#ifdef WFVOPENCL_USE_AVX
-        const bool use_sse41 = false;
-        const bool use_avx = true;
-#else
-        const bool use_sse41 = true;
-        const bool use_avx = false;
-#endif
+        // the instruction set is chosen for the host we are running on
+        const bool use_avx = WFVOpenCL::hostSupportsAVX();
+        const bool use_sse41 = !use_avx && WFVOpenCL::hostSupportsSSE41();
         const bool verbose = false;
-        const bool vectorized =
-            WFVOpenCL::packetizeKernelFunction(f->getNameStr(),
-                                                     kernel_simd_name,
-                                                     module,
-                                                     WFVOPENCL_SIMD_WIDTH,
-                                                     (cl_uint)simd_dim,
-                                                     use_sse41,
-                                                     use_avx,
-                                                     verbose);
+        bool vectorized = false;
+        if (simd_dim >= 0) {
+            beginCompileStage(report, f);
+            vectorized =
+                WFVOpenCL::packetizeKernelFunction(f->getNameStr(),
+                                                         kernel_simd_name,
+                                                         module,
+                                                         WFVOpenCL::getSimdWidth(),
+                                                         (cl_uint)simd_dim,
+                                                         use_sse41,
+                                                         use_avx,
+                                                         verbose,
+                                                         relaxedMath,
+                                                         alignedPointers,
+                                                         vectorization);
+        }
+        WFVOpenCL::allowInliningOfBuiltins(module);
 
         if (vectorized) {
             f_SIMD = WFVOpenCL::getFunction(kernel_simd_name, module); // old pointer not valid anymore!
+            endCompileStage(report, "packetization", f_SIMD);
 
             WFVOPENCL_DEBUG( verifyModule(*module); );
             WFVOPENCL_DEBUG( WFVOpenCL::writeFunctionToFile(f_SIMD, "debug_kernel_packetized.ll"); );
@@ -1392,8 +1641,10 @@ namespace WFVOpenCL {
 
             f = f_SIMD;
         }
-        else {
-            // vectorization failed
+        else if (simd_dim >= 0) {
+            // vectorization failed, the kernel is executed as scalar code
+            endCompileStage(report, "packetization (failed)", f);
+            errs() << "WARNING: could not vectorize kernel '" << kernel_name << "', executing scalar code!\n";
             simd_dim = -1;
         }
 
@@ -1428,6 +1679,7 @@ namespace WFVOpenCL {
             const std::string wrapper_name = strs2.str();
 
             WFVOPENCL_DEBUG( outs() << "  generating kernel wrapper... "; );
+            beginCompileStage(report, f);
             const bool inlineCall = false; // don't inline call immediately (needed for generating loop(s))
             f_wrapper = WFVOpenCL::generateKernelWrapper(wrapper_name, f, module, targetData, inlineCall);
             if (!f_wrapper) {
@@ -1442,9 +1694,11 @@ namespace WFVOpenCL {
             // generate loop(s) over blocksize(s) (BEFORE inlining!)
             CallInst* kernelCall = getWrappedKernelCall(f_wrapper, f);
             generateBlockSizeLoopsForWrapper(f_wrapper, kernelCall, num_dimensions, simd_dim, context, module);
+            endCompileStage(report, "wrapper generation", f_wrapper);
 
         } else {
             // minimize number of live values before splitting
+            beginCompileStage(report, f);
             replaceCallbackUsesByNewCallsInFunction(module->getFunction("get_global_id"), f);
             replaceCallbackUsesByNewCallsInFunction(module->getFunction("get_local_id"), f);
             replaceCallbackUsesByNewCallsInFunction(module->getFunction("get_num_groups"), f);
@@ -1497,6 +1751,16 @@ namespace WFVOpenCL {
             ContinuationGenerator::ContinuationVecType continuations;
             CG->getContinuations(continuations);
 
+            endCompileStage(report, "barrier elimination", f);
+            if (report) {
+                report->numContinuations = continuations.size();
+                SmallVector<const StructType*, 4> liveValueStructTypes;
+                CG->getLiveValueStructTypes(liveValueStructTypes);
+                for (unsigned i=0, e=liveValueStructTypes.size(); i<e; ++i) {
+                    report->liveValueStructSizes.push_back(targetData->getTypeAllocSize(liveValueStructTypes[i]));
+                }
+            }
+
             WFVOPENCL_DEBUG(
                 outs() << "continuations:\n";
                 for (SmallVector<Function*, 4>::iterator it=continuations.begin(), E=continuations.end(); it!=E; ++it) {
@@ -1511,6 +1775,7 @@ namespace WFVOpenCL {
             const std::string wrapper_name = strs.str();
 
             WFVOPENCL_DEBUG( outs() << "  generating kernel wrapper... "; );
+            beginCompileStage(report, f);
             const bool inlineCall = true; // inline call immediately (and only this call)
             f_wrapper = WFVOpenCL::generateKernelWrapper(wrapper_name, f, module, targetData, inlineCall);
             if (!f_wrapper) {
@@ -1530,6 +1795,7 @@ namespace WFVOpenCL {
             // - map "special" arguments of calls to each continuation correctly (either to wrapper-param or to generated value inside loop)
             // - make liveValueUnion an array of unions (size: blocksize[0]*blocksize[1]*blocksize[2]*...)
             WFVOpenCL::generateBlockSizeLoopsForContinuations(num_dimensions, simd_dim, context, f_wrapper, continuations);
+            endCompileStage(report, "wrapper generation", f_wrapper);
 
         }
 
@@ -1538,8 +1804,12 @@ namespace WFVOpenCL {
         // optimize wrapper with inlined kernel
         WFVOPENCL_DEBUG( WFVOpenCL::writeFunctionToFile(f_wrapper, "debug_wrapper_beforeopt.ll"); );
         WFVOPENCL_DEBUG( outs() << "optimizing wrapper... "; );
+        beginCompileStage(report, f_wrapper);
         WFVOpenCL::inlineFunctionCalls(f_wrapper, targetData);
-        WFVOpenCL::optimizeFunction(f_wrapper);
+        endCompileStage(report, "wrapper inlining", f_wrapper);
+        beginCompileStage(report, f_wrapper);
+        WFVOpenCL::optimizeFunction(f_wrapper, false, false, optimizationLevel);
+        endCompileStage(report, "wrapper optimization", f_wrapper);
         WFVOPENCL_DEBUG( WFVOpenCL::writeFunctionToFile(f_wrapper, "debug_wrapper_afteropt.ll"); );
         
         WFVOPENCL_DEBUG_RUNTIME(
@@ -1601,6 +1871,154 @@ namespace WFVOpenCL {
         return f_wrapper;
     }
 
+    // Creates a constant of the given type from the raw value of a kernel
+    // argument (as copied by clSetKernelArg()). Returns NULL for types that
+    // can not be specialized.
+    static Constant* createArgumentConstant(const Type* type, const char* data) {
+        if (const IntegerType* intType = dyn_cast<IntegerType>(type)) {
+            if (intType->getBitWidth() > 64) return NULL;
+            uint64_t value = 0;
+            memcpy(&value, data, (intType->getBitWidth() + 7) / 8);
+            return ConstantInt::get(intType, value);
+        }
+        if (type->isFloatTy()) {
+            float value;
+            memcpy(&value, data, sizeof(float));
+            return ConstantFP::get(type->getContext(), APFloat(value));
+        }
+        if (type->isDoubleTy()) {
+            double value;
+            memcpy(&value, data, sizeof(double));
+            return ConstantFP::get(type->getContext(), APFloat(value));
+        }
+        if (const VectorType* vecType = dyn_cast<VectorType>(type)) {
+            const Type* elementType = vecType->getElementType();
+            const unsigned elementSize = elementType->getPrimitiveSizeInBits() / 8;
+            if (elementSize == 0) return NULL;
+            std::vector<Constant*> elements;
+            for (unsigned i=0, e=vecType->getNumElements(); i<e; ++i) {
+                Constant* element = createArgumentConstant(elementType, data + i*elementSize);
+                if (!element) return NULL;
+                elements.push_back(element);
+            }
+            return ConstantVector::get(vecType, elements);
+        }
+        return NULL;
+    }
+
+    // Returns the index of the element of 'array' that is loaded by 'load'
+    // (-1 if it does not load from 'array' with a constant index).
+    static int getLoadedArrayIndex(const LoadInst* load, const Value* array) {
+        const Value* pointer = load->getPointerOperand();
+        if (pointer == array) return 0;
+        const GetElementPtrInst* gep = dyn_cast<GetElementPtrInst>(pointer);
+        if (!gep || gep->getPointerOperand() != array || gep->getNumIndices() != 1) return -1;
+        const ConstantInt* index = dyn_cast<ConstantInt>(gep->getOperand(1));
+        return index ? (int)index->getZExtValue() : -1;
+    }
+
+    // Creates a copy of the kernel wrapper in which the arguments with the
+    // given indices are not loaded from the argument struct but have the
+    // given values. Trip counts, strides, etc. that depend on them become
+    // constants for the optimizer. If 'local_sizes' is given, the loops over
+    // the work items of a group (see generateBlockSizeLoopsForWrapper()) get
+    // constant bounds as well.
+    Function* createSpecializedWrapper(Function* f_wrapper, const std::string& name, const std::vector<cl_uint>& arg_indices, const std::vector<std::string>& values, const unsigned num_dimensions, const cl_uint* local_sizes, const unsigned optimizationLevel) {
+        assert (f_wrapper && !f_wrapper->isDeclaration());
+        assert (arg_indices.size() == values.size());
+        assert (num_dimensions > 0 && num_dimensions < 4);
+
+        const Type* argStructType = WFVOpenCL::getContainedType(WFVOpenCL::getArgumentType(f_wrapper, 0), 0);
+        const StructType* structType = dyn_cast<StructType>(argStructType);
+        if (!structType) return NULL;
+
+        std::map<cl_uint, Constant*> constants;
+        for (unsigned i=0, e=arg_indices.size(); i<e; ++i) {
+            if (arg_indices[i] >= structType->getNumElements()) return NULL;
+            const Type* argType = structType->getElementType(arg_indices[i]);
+            Constant* c = createArgumentConstant(argType, values[i].data());
+            if (!c) {
+                errs() << "ERROR: can not specialize kernel on argument " << arg_indices[i] << " of type " << *argType << "!\n";
+                return NULL;
+            }
+            constants[arg_indices[i]] = c;
+        }
+
+        Function* f_specialized = CloneFunction(f_wrapper);
+        f_specialized->setName(name);
+        f_wrapper->getParent()->getFunctionList().push_back(f_specialized);
+
+        // replace loads of the arguments from the argument struct and of the
+        // local sizes from their array
+        Function::arg_iterator A = f_specialized->arg_begin();
+        Argument* arg_str = A;
+        std::advance(A, 3);
+        Argument* arg_local_size_array = A;
+        for (Function::iterator BB=f_specialized->begin(), BBE=f_specialized->end(); BB!=BBE; ++BB) {
+            for (BasicBlock::iterator I=BB->begin(), IE=BB->end(); I!=IE; ) {
+                LoadInst* load = dyn_cast<LoadInst>(I++);
+                if (!load) continue;
+                const int dim = local_sizes ? getLoadedArrayIndex(load, arg_local_size_array) : -1;
+                if (dim >= 0 && dim < (int)num_dimensions && load->getType()->isIntegerTy()) {
+                    load->replaceAllUsesWith(ConstantInt::get(load->getType(), local_sizes[dim]));
+                    load->eraseFromParent();
+                    continue;
+                }
+                const GetElementPtrInst* gep = dyn_cast<GetElementPtrInst>(load->getPointerOperand());
+                if (!gep || gep->getPointerOperand() != arg_str || gep->getNumIndices() != 2) continue;
+                const ConstantInt* index = dyn_cast<ConstantInt>(gep->getOperand(2));
+                if (!index) continue;
+                std::map<cl_uint, Constant*>::const_iterator it = constants.find((cl_uint)index->getZExtValue());
+                if (it == constants.end() || it->second->getType() != load->getType()) continue;
+                load->replaceAllUsesWith(it->second);
+                load->eraseFromParent();
+            }
+        }
+
+        WFVOpenCL::optimizeFunction(f_specialized, false, false, optimizationLevel);
+        WFVOPENCL_DEBUG( WFVOpenCL::writeFunctionToFile(f_specialized, "debug_wrapper_specialized.ll"); );
+        WFVOPENCL_DEBUG( verifyFunction(*f_specialized); );
+
+        return f_specialized;
+    }
+
+    // Reads __attribute__((reqd_work_group_size(X, Y, Z))) of a kernel. clc
+    // stores kernel attributes as strings in llvm.global.annotations, the
+    // required size is encoded as "RWG<X>,<Y>,<Z>". Returns false if the
+    // kernel has no required size.
+    bool getRequiredWorkGroupSize(const Function* f, cl_uint sizes[3]) {
+        assert (f);
+        const GlobalVariable* annotations = f->getParent()->getNamedGlobal("llvm.global.annotations");
+        if (!annotations || !annotations->hasInitializer()) return false;
+        const ConstantArray* entries = dyn_cast<ConstantArray>(annotations->getInitializer());
+        if (!entries) return false;
+
+        for (unsigned i=0, e=entries->getNumOperands(); i<e; ++i) {
+            const ConstantStruct* entry = dyn_cast<ConstantStruct>(entries->getOperand(i));
+            if (!entry || entry->getNumOperands() < 2) continue;
+            if (entry->getOperand(0)->stripPointerCasts() != f) continue;
+
+            for (unsigned j=1, je=entry->getNumOperands(); j<je; ++j) {
+                const GlobalVariable* str = dyn_cast<GlobalVariable>(entry->getOperand(j)->stripPointerCasts());
+                if (!str || !str->hasInitializer()) continue;
+                const ConstantArray* strInit = dyn_cast<ConstantArray>(str->getInitializer());
+                if (!strInit || !strInit->isString()) continue;
+
+                const std::string attributes = strInit->getAsString();
+                const size_t pos = attributes.find("RWG");
+                if (pos == std::string::npos) continue;
+                unsigned x, y, z;
+                if (sscanf(attributes.c_str() + pos, "RWG%u,%u,%u", &x, &y, &z) != 3) continue;
+                if (x == 0 || y == 0 || z == 0) continue;
+                sizes[0] = x;
+                sizes[1] = y;
+                sizes[2] = z;
+                return true;
+            }
+        }
+        return false;
+    }
+
 
     cl_uint convertLLVMAddressSpace(cl_uint llvm_address_space) {
         switch (llvm_address_space) {
@@ -1626,10 +2044,1073 @@ namespace WFVOpenCL {
     // host information
     //------------------------------------------------------------------------//
 
-    // TODO: get real info :p
+    // Executes the CPUID instruction, returns false if the leaf is not
+    // supported (or if the host is no x86 processor).
+    static bool cpuid(const unsigned leaf, unsigned regs[4]) {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        int info[4];
+        __cpuid(info, (int)(leaf & 0x80000000));
+        if ((unsigned)info[0] < leaf) return false;
+        __cpuid(info, (int)leaf);
+        for (unsigned i=0; i<4; ++i) regs[i] = (unsigned)info[i];
+        return true;
+#elif defined(__i386__) || defined(__x86_64__)
+        return __get_cpuid(leaf, &regs[0], &regs[1], &regs[2], &regs[3]) != 0;
+#else
+        return false;
+#endif
+    }
+
+    // Reads the extended control register 0 (XGETBV), which tells which
+    // register states are saved by the operating system on context switches.
+    // Must only be called if CPUID reports OSXSAVE.
+    static unsigned long long xgetbv0() {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+        return _xgetbv(0);
+#elif defined(__i386__) || defined(__x86_64__)
+        unsigned eax, edx;
+        __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0)); // xgetbv
+        return ((unsigned long long)edx << 32) | eax;
+#else
+        return 0;
+#endif
+    }
+
+    // AVX requires support by the processor and by the operating system
+    // (which has to save the upper halves of the ymm registers).
+    static bool queryHostAVXSupport() {
+        unsigned regs[4];
+        if (!cpuid(1, regs)) return false;
+        const bool avx = (regs[2] >> 28) & 1;
+        const bool osxsave = (regs[2] >> 27) & 1;
+        if (!avx || !osxsave) return false;
+        return (xgetbv0() & 0x6) == 0x6; // xmm and ymm state
+    }
+
+    static bool queryHostSSE41Support() {
+        unsigned regs[4];
+        return cpuid(1, regs) && ((regs[2] >> 19) & 1);
+    }
+
+    // Returns the size of the data cache of the given level (1-3) in bytes.
+    // If the operating system does not tell us, we assume a typical desktop
+    // processor.
+    static unsigned long long queryHostCacheSize(const unsigned level) {
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+        long size = -1;
+        switch (level) {
+            case 1: size = sysconf(_SC_LEVEL1_DCACHE_SIZE); break;
+            case 2: size = sysconf(_SC_LEVEL2_CACHE_SIZE); break;
+            case 3: size = sysconf(_SC_LEVEL3_CACHE_SIZE); break;
+            default: break;
+        }
+        if (size > 0) return (unsigned long long)size;
+#elif defined(__APPLE__)
+        const char* name = level == 1 ? "hw.l1dcachesize" :
+            level == 2 ? "hw.l2cachesize" : "hw.l3cachesize";
+        unsigned long long size = 0;
+        size_t len = sizeof(size);
+        if (level >= 1 && level <= 3 && !sysctlbyname(name, &size, &len, NULL, 0) && size > 0) {
+            return size;
+        }
+#endif
+        switch (level) {
+            case 1: return 32*1024;
+            case 2: return 256*1024;
+            case 3: return 4*1024*1024;
+            default: return 0;
+        }
+    }
+
+    static unsigned queryHostCacheLineSize() {
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_LINESIZE)
+        const long size = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+        if (size > 0) return (unsigned)size;
+#elif defined(__APPLE__)
+        unsigned long long size = 0;
+        size_t len = sizeof(size);
+        if (!sysctlbyname("hw.cachelinesize", &size, &len, NULL, 0) && size > 0) return (unsigned)size;
+#endif
+        // CLFLUSH line size (in quadwords)
+        unsigned regs[4];
+        if (cpuid(1, regs) && ((regs[1] >> 8) & 0xFF)) return ((regs[1] >> 8) & 0xFF) * 8;
+        return 64;
+    }
+
+    // Returns the maximum clock frequency of the host in MHz (0 = unknown).
+    static unsigned queryHostClockFrequency() {
+#if defined(__linux__)
+        std::ifstream maxFreqFile("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq");
+        unsigned long kHz = 0;
+        if (maxFreqFile && (maxFreqFile >> kHz) && kHz > 0) return (unsigned)(kHz / 1000);
+        // no cpufreq driver (e.g. virtual machines): current frequency
+        std::ifstream cpuInfoFile("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuInfoFile, line)) {
+            if (line.compare(0, 7, "cpu MHz")) continue;
+            const size_t colon = line.find(':');
+            if (colon == std::string::npos) break;
+            return (unsigned)(atof(line.c_str() + colon + 1) + 0.5);
+        }
+#elif defined(__APPLE__)
+        unsigned long long hz = 0;
+        size_t len = sizeof(hz);
+        if (!sysctlbyname("hw.cpufrequency_max", &hz, &len, NULL, 0) && hz > 0) return (unsigned)(hz / 1000000);
+#elif defined(_WIN32)
+        HKEY key;
+        if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", 0, KEY_READ, &key) == ERROR_SUCCESS) {
+            DWORD mhz = 0;
+            DWORD len = sizeof(mhz);
+            const LONG res = RegQueryValueExA(key, "~MHz", NULL, NULL, (LPBYTE)&mhz, &len);
+            RegCloseKey(key);
+            if (res == ERROR_SUCCESS) return (unsigned)mhz;
+        }
+#endif
+        return 0;
+    }
+
+    static unsigned long long queryHostMemorySize() {
+#if defined(_WIN32)
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status)) return status.ullTotalPhys;
+#elif defined(__APPLE__)
+        unsigned long long size = 0;
+        size_t len = sizeof(size);
+        if (!sysctlbyname("hw.memsize", &size, &len, NULL, 0) && size > 0) return size;
+#elif defined(_SC_PHYS_PAGES)
+        const long pages = sysconf(_SC_PHYS_PAGES);
+        const long pageSize = sysconf(_SC_PAGESIZE);
+        if (pages > 0 && pageSize > 0) return (unsigned long long)pages * (unsigned long long)pageSize;
+#endif
+        return 0x100000000ULL; // 4 GB
+    }
+
+    // Removes leading and trailing blanks (the brand string of Intel
+    // processors is right-aligned).
+    static std::string trim(const std::string& str) {
+        const size_t first = str.find_first_not_of(" \t");
+        if (first == std::string::npos) return "";
+        const size_t last = str.find_last_not_of(" \t");
+        return str.substr(first, last - first + 1);
+    }
+
+    // Processor information of the host, queried once
+    struct HostInfo {
+        std::string vendor;
+        std::string name;
+        unsigned clockFrequency; // MHz, 0 = unknown
+        unsigned long long memorySize;
+        unsigned cacheLineSize;
+        unsigned long long cacheSize[3]; // L1D, L2, L3
+        bool sse41;
+        bool avx;
+    };
+
+    // AVX is not used if the driver was built without it (WFVOPENCL_NO_AVX)
+    // or if $WFVOPENCL_NO_AVX is set, which caps the target at SSE4.1.
+    static bool isAVXDisabled() {
+#ifdef WFVOPENCL_NO_AVX
+        return true;
+#else
+        const char* noAVX = getenv("WFVOPENCL_NO_AVX");
+        return noAVX && *noAVX && strcmp(noAVX, "0") != 0;
+#endif
+    }
+
+    static HostInfo createHostInfo() {
+        HostInfo info;
+
+        unsigned regs[4];
+        if (cpuid(0, regs)) {
+            char vendor[13];
+            memcpy(vendor+0, &regs[1], 4); // ebx
+            memcpy(vendor+4, &regs[3], 4); // edx
+            memcpy(vendor+8, &regs[2], 4); // ecx
+            vendor[12] = '\0';
+            info.vendor = vendor;
+        }
+        if (cpuid(0x80000004, regs)) {
+            char brand[49];
+            for (unsigned i=0; i<3; ++i) {
+                cpuid(0x80000002 + i, regs);
+                memcpy(brand + 16*i, regs, 16);
+            }
+            brand[48] = '\0';
+            info.name = trim(brand);
+        }
+        if (info.vendor.empty()) info.vendor = "Unknown CPU vendor";
+        if (info.name.empty()) info.name = "Unknown CPU";
+
+        info.clockFrequency = queryHostClockFrequency();
+        info.memorySize = queryHostMemorySize();
+        info.cacheLineSize = queryHostCacheLineSize();
+        for (unsigned i=0; i<3; ++i) info.cacheSize[i] = queryHostCacheSize(i+1);
+        info.sse41 = queryHostSSE41Support();
+        info.avx = !isAVXDisabled() && queryHostAVXSupport();
+        return info;
+    }
+
+    static const HostInfo& getHostInfo() {
+        static const HostInfo info = createHostInfo();
+        return info;
+    }
+
+    const char* getHostProcessorVendor() {
+        return getHostInfo().vendor.c_str();
+    }
+
+    const char* getHostProcessorName() {
+        return getHostInfo().name.c_str();
+    }
+
+    bool hostSupportsSSE41() {
+        return getHostInfo().sse41;
+    }
+
+    bool hostSupportsAVX() {
+        return getHostInfo().avx;
+    }
+
+    // Number of work items that are executed together by a vectorized
+    // kernel: one float per lane of the SIMD registers of the host.
+    unsigned getSimdWidth() {
+        return hostSupportsAVX() ? 8 : 4;
+    }
+
+    unsigned getHostClockFrequency() {
+        return getHostInfo().clockFrequency;
+    }
+
+    unsigned long long getHostMemorySize() {
+        return getHostInfo().memorySize;
+    }
+
+    // Buffers are ordinary host memory, but we do not want to let a single
+    // allocation take more than half of it (the specification requires at
+    // least a quarter, but no less than 128 MB).
     unsigned long long getDeviceMaxMemAllocSize() {
-        //return 0x3B9ACA00; // 1 GB
-        return 0xEE6B2800; // 4 GB
+        return std::max(getHostMemorySize() / 2, 128ULL*1024*1024);
+    }
+
+    unsigned getHostCacheLineSize() {
+        return getHostInfo().cacheLineSize;
+    }
+
+    // Returns the size of the data cache of the given level (1-3) in bytes.
+    unsigned long long getHostCacheSize(const unsigned level) {
+        return (level >= 1 && level <= 3) ? getHostInfo().cacheSize[level-1] : 0;
+    }
+
+    unsigned getNumHostCores() {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        const long numCores = (long)info.dwNumberOfProcessors;
+#else
+        const long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        return numCores > 0 ? (unsigned)numCores : 1;
+    }
+
+    // NUMA topology of the host, queried once
+    struct HostTopology {
+        unsigned numNodes;
+        std::vector<unsigned> nodeOfCore; // indexed by logical processor
+        std::vector<unsigned> workerCores; // logical processors ordered by node
+    };
+
+#ifdef __linux__
+    // parses lists of the form "0-3,8,10-11"
+    static void parseCpuList(const std::string& list, std::vector<unsigned>& ids) {
+        std::stringstream sstr(list);
+        std::string range;
+        while (std::getline(sstr, range, ',')) {
+            if (range.empty() || range[0] < '0' || range[0] > '9') continue;
+            unsigned first = 0, last = 0;
+            const int n = sscanf(range.c_str(), "%u-%u", &first, &last);
+            if (n < 1) continue;
+            if (n == 1) last = first;
+            for (unsigned i=first; i<=last; ++i) ids.push_back(i);
+        }
+    }
+#endif
+
+    static HostTopology createHostTopology() {
+        HostTopology topology;
+        topology.numNodes = 1;
+
+        const unsigned numCores = getNumHostCores();
+        topology.nodeOfCore.resize(numCores, 0);
+
+#if defined(__linux__)
+        std::ifstream onlineFile("/sys/devices/system/node/online");
+        std::string onlineList;
+        if (onlineFile && std::getline(onlineFile, onlineList)) {
+            std::vector<unsigned> nodes;
+            parseCpuList(onlineList, nodes);
+            if (!nodes.empty()) topology.numNodes = nodes.back() + 1;
+            for (unsigned i=0; i<nodes.size(); ++i) {
+                std::stringstream fileName;
+                fileName << "/sys/devices/system/node/node" << nodes[i] << "/cpulist";
+                std::ifstream cpuFile(fileName.str().c_str());
+                std::string cpuList;
+                if (!cpuFile || !std::getline(cpuFile, cpuList)) continue;
+                std::vector<unsigned> cores;
+                parseCpuList(cpuList, cores);
+                for (unsigned j=0; j<cores.size(); ++j) {
+                    if (cores[j] < numCores) topology.nodeOfCore[cores[j]] = nodes[i];
+                }
+            }
+        }
+#elif defined(_WIN32)
+        ULONG highestNode = 0;
+        if (GetNumaHighestNodeNumber(&highestNode)) {
+            topology.numNodes = highestNode + 1;
+            for (unsigned i=0; i<numCores && i<256; ++i) {
+                UCHAR node = 0;
+                if (GetNumaProcessorNode((UCHAR)i, &node) && node != 0xFF) {
+                    topology.nodeOfCore[i] = node;
+                }
+            }
+        }
+#endif
+
+        // consecutive workers are placed on the same node
+        for (unsigned node=0; node<topology.numNodes; ++node) {
+            for (unsigned i=0; i<numCores; ++i) {
+                if (topology.nodeOfCore[i] == node) topology.workerCores.push_back(i);
+            }
+        }
+        assert (topology.workerCores.size() == numCores);
+        return topology;
+    }
+
+    static const HostTopology& getHostTopology() {
+        static const HostTopology topology = createHostTopology();
+        return topology;
+    }
+
+    unsigned getNumNumaNodes() {
+        return getHostTopology().numNodes;
+    }
+
+    unsigned getNumaNodeOfCore(const unsigned core) {
+        const HostTopology& topology = getHostTopology();
+        return core < topology.nodeOfCore.size() ? topology.nodeOfCore[core] : 0;
+    }
+
+    // Returns an identifier of the cache of the given level that the given
+    // logical processor uses (the lowest-numbered processor that shares it),
+    // or -1 if this is unknown.
+    int getCacheDomainOfCore(const unsigned core, const unsigned level) {
+#if defined(__linux__)
+        for (unsigned index=0; ; ++index) {
+            std::stringstream dirName;
+            dirName << "/sys/devices/system/cpu/cpu" << core << "/cache/index" << index << "/";
+            std::ifstream levelFile((dirName.str() + "level").c_str());
+            if (!levelFile) break;
+            unsigned cacheLevel = 0;
+            if (!(levelFile >> cacheLevel) || cacheLevel != level) continue;
+            std::ifstream typeFile((dirName.str() + "type").c_str());
+            std::string type;
+            if (typeFile && std::getline(typeFile, type) && type == "Instruction") continue;
+            std::ifstream sharedFile((dirName.str() + "shared_cpu_list").c_str());
+            std::string sharedList;
+            if (!sharedFile || !std::getline(sharedFile, sharedList)) return -1;
+            std::vector<unsigned> cores;
+            parseCpuList(sharedList, cores);
+            if (cores.empty()) return -1;
+            return (int)*std::min_element(cores.begin(), cores.end());
+        }
+#endif
+        return -1;
+    }
+
+    // Returns the logical processor that runs the worker with the given index.
+    // Workers with neighbouring indices run on the same NUMA node.
+    unsigned getWorkerCore(const unsigned worker) {
+        const HostTopology& topology = getHostTopology();
+        return topology.workerCores[worker % topology.workerCores.size()];
+    }
+
+    // core/set of cores the calling thread was last pinned to (-1 = not pinned)
+    static WFVOPENCL_THREAD_LOCAL int pinnedCore = -1;
+    static WFVOPENCL_THREAD_LOCAL int pinnedSet = -1;
+    // affinity of the calling thread before it was pinned the first time
+#if defined(_WIN32)
+    static WFVOPENCL_THREAD_LOCAL DWORD_PTR originalAffinity = 0;
+#elif defined(__linux__)
+    static WFVOPENCL_THREAD_LOCAL bool originalAffinitySaved = false;
+    static WFVOPENCL_THREAD_LOCAL cpu_set_t originalAffinity;
+#endif
+
+    // Binds the calling thread to a set of logical processors (e.g. the cores
+    // of a sub-device on one NUMA node). 'set_id' identifies the set, repeated
+    // calls with the same id are cheap.
+    bool pinCurrentThreadToCores(const unsigned* cores, const unsigned num_cores, const unsigned set_id) {
+        if (set_id != ~0U && pinnedSet == (int)set_id) return true;
+        if (num_cores == 0) return false;
+#if defined(_WIN32)
+        DWORD_PTR mask = 0;
+        for (unsigned i=0; i<num_cores; ++i) {
+            if (cores[i] < sizeof(DWORD_PTR)*8) mask |= (DWORD_PTR)1 << cores[i];
+        }
+        if (!mask) return false;
+        const DWORD_PTR previous = SetThreadAffinityMask(GetCurrentThread(), mask);
+        if (!previous) return false;
+        if (!originalAffinity) originalAffinity = previous;
+#elif defined(__linux__)
+        if (!originalAffinitySaved) {
+            if (sched_getaffinity(0, sizeof(originalAffinity), &originalAffinity)) return false;
+            originalAffinitySaved = true;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned i=0; i<num_cores; ++i) {
+            if (cores[i] < CPU_SETSIZE) CPU_SET(cores[i], &set);
+        }
+        if (!CPU_COUNT(&set) || sched_setaffinity(0, sizeof(set), &set)) return false;
+#else
+        // no way to bind threads to cores (e.g. Mac OS X)
+        return false;
+#endif
+        pinnedSet = (int)set_id;
+        pinnedCore = -1;
+        return true;
+    }
+
+    // Binds the calling thread to the given logical processor.
+    // Repeated calls with the same core are cheap, so this can be called
+    // at the beginning of each iteration of a parallel loop.
+    bool pinCurrentThreadToCore(const unsigned core) {
+        if (pinnedCore == (int)core) return true;
+        if (!pinCurrentThreadToCores(&core, 1, ~0U)) return false;
+        pinnedCore = (int)core;
+        pinnedSet = -1;
+        return true;
+    }
+
+    // Restores the affinity the calling thread had before it was pinned.
+    // Cheap if the thread is not pinned.
+    void unpinCurrentThread() {
+        if (pinnedCore == -1 && pinnedSet == -1) return;
+#if defined(_WIN32)
+        if (originalAffinity) SetThreadAffinityMask(GetCurrentThread(), originalAffinity);
+#elif defined(__linux__)
+        if (originalAffinitySaved) sched_setaffinity(0, sizeof(originalAffinity), &originalAffinity);
+#endif
+        pinnedCore = -1;
+        pinnedSet = -1;
+    }
+
+#if !defined(_WIN32)
+    static size_t getBufferMappingSize(const size_t size, const cl_mem_flags flags) {
+        // huge pages can only be used for 2 MB aligned parts of the mapping
+        const size_t alignment = (flags & CL_MEM_HUGE_PAGES_WFV) ? 2*1024*1024 : (size_t)sysconf(_SC_PAGESIZE);
+        return (size + alignment - 1) / alignment * alignment;
+    }
+#endif
+
+    // Allocates the memory of a buffer object. Memory with a special NUMA or
+    // page size policy is mapped directly from the operating system, all
+    // other memory is allocated with an alignment of
+    // WFVOPENCL_BUFFER_ALIGNMENT bytes (malloc only guarantees 16), so the
+    // aligned variants of the kernels can be used. In both cases, no page is
+    // touched here, the caller is responsible for the first-touch
+    // initialization.
+    void* allocateBufferMemory(const size_t size, const cl_mem_flags flags) {
+#if !defined(_WIN32)
+        if (flags & (CL_MEM_NUMA_INTERLEAVE_WFV | CL_MEM_HUGE_PAGES_WFV)) {
+            const size_t mapSize = getBufferMappingSize(size, flags);
+            void* ptr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) return NULL;
+#   if defined(__linux__) && defined(SYS_mbind)
+            if ((flags & CL_MEM_NUMA_INTERLEAVE_WFV) && getNumNumaNodes() > 1) {
+                const unsigned numNodes = std::min(getNumNumaNodes(), (unsigned)sizeof(unsigned long)*8);
+                const unsigned long nodeMask = numNodes == sizeof(unsigned long)*8 ?
+                    ~0UL : (1UL << numNodes) - 1;
+                const int MPOL_INTERLEAVE_ = 3; // from numaif.h, we do not want to depend on libnuma
+                if (syscall(SYS_mbind, ptr, mapSize, MPOL_INTERLEAVE_, &nodeMask, sizeof(nodeMask)*8, 0)) {
+                    WFVOPENCL_DEBUG( errs() << "WARNING: could not set interleave policy for buffer!\n"; );
+                }
+            }
+#   endif
+#   ifdef MADV_HUGEPAGE
+            if (flags & CL_MEM_HUGE_PAGES_WFV) {
+                if (madvise(ptr, mapSize, MADV_HUGEPAGE)) {
+                    WFVOPENCL_DEBUG( errs() << "WARNING: could not enable huge pages for buffer!\n"; );
+                }
+            }
+#   endif
+            return ptr;
+        }
+#endif
+#if defined(_WIN32)
+        return _aligned_malloc(size, WFVOPENCL_BUFFER_ALIGNMENT);
+#else
+        void* ptr = NULL;
+        if (posix_memalign(&ptr, WFVOPENCL_BUFFER_ALIGNMENT, size)) return NULL;
+        return ptr;
+#endif
+    }
+
+    void freeBufferMemory(void* ptr, const size_t size, const cl_mem_flags flags) {
+#if !defined(_WIN32)
+        if (flags & (CL_MEM_NUMA_INTERLEAVE_WFV | CL_MEM_HUGE_PAGES_WFV)) {
+            munmap(ptr, getBufferMappingSize(size, flags));
+            return;
+        }
+#endif
+#if defined(_WIN32)
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+
+
+    //------------------------------------------------------------------------//
+    // compilation cache
+    //------------------------------------------------------------------------//
+
+    static const char* createCacheDirectory() {
+        const char* dir = getenv("WFVOPENCL_CACHE_DIR");
+        if (!dir || *dir == '\0') return NULL;
+#ifdef _WIN32
+        _mkdir(dir); // fails if it already exists, which is fine
+#else
+        mkdir(dir, 0755);
+#endif
+        return dir;
+    }
+
+    // Returns the directory in which compiled programs and kernels are kept
+    // across runs of the application, or NULL if caching is disabled (the
+    // default). The cache is enabled by setting WFVOPENCL_CACHE_DIR.
+    const char* getCacheDirectory() {
+        static const char* dir = createCacheDirectory();
+        return dir;
+    }
+
+    // Identifies the binary that contains the driver by its path, size and
+    // time of the last modification, so that code cached by a previous build
+    // of the driver is not used. If the binary can not be found, the time
+    // at which this file was compiled is used instead.
+    static std::string createDriverBuildId() {
+        std::stringstream sstr;
+#if defined(_WIN32)
+        HMODULE module = NULL;
+        char path[MAX_PATH];
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                               (LPCSTR)&createDriverBuildId, &module) &&
+            GetModuleFileNameA(module, path, MAX_PATH) &&
+            GetFileAttributesExA(path, GetFileExInfoStandard, &attributes))
+        {
+            sstr << path << " " << attributes.nFileSizeHigh << ":" << attributes.nFileSizeLow
+                << " " << attributes.ftLastWriteTime.dwHighDateTime << ":" << attributes.ftLastWriteTime.dwLowDateTime;
+            return sstr.str();
+        }
+#else
+        Dl_info info;
+        struct stat status;
+        if (dladdr((void*)&createDriverBuildId, &info) && info.dli_fname &&
+            !stat(info.dli_fname, &status))
+        {
+            sstr << info.dli_fname << " " << (unsigned long long)status.st_size
+                << " " << (unsigned long long)status.st_mtime;
+            return sstr.str();
+        }
+#endif
+        sstr << __DATE__ << " " << __TIME__;
+        return sstr.str();
+    }
+
+    const std::string& getDriverBuildId() {
+        static const std::string id = createDriverBuildId();
+        return id;
+    }
+
+    // Returns the key under which the result of compiling 'data' is cached
+    // (64 bit FNV-1a hash as a hexadecimal string).
+    std::string getCacheKey(const std::string& data) {
+        unsigned long long hash = 14695981039346656037ULL;
+        for (std::string::const_iterator it=data.begin(), E=data.end(); it!=E; ++it) {
+            hash ^= (unsigned char)*it;
+            hash *= 1099511628211ULL;
+        }
+        std::stringstream sstr;
+        sstr << std::hex << std::setw(16) << std::setfill('0') << hash;
+        return sstr.str();
+    }
+
+    static std::string getCacheFileName(const std::string& key, const char* extension) {
+        std::stringstream sstr;
+        sstr << getCacheDirectory() << "/" << key << extension;
+        return sstr.str();
+    }
+
+    // the description is stored as a single line
+    static std::string getCacheDescriptionLine(const std::string& description) {
+        std::string line = description;
+        std::replace(line.begin(), line.end(), '\n', ' ');
+        std::replace(line.begin(), line.end(), '\r', ' ');
+        return line;
+    }
+
+    // Loads the module that was cached under the given key. The entry is
+    // only used if it was stored with the same description (driver version,
+    // target, options, ...), this also protects against hash collisions.
+    // Additional lines stored with the module are returned in 'info'.
+    Module* loadCachedModule(const std::string& key, const std::string& description, std::vector<std::string>& info, LLVMContext& context) {
+        if (!getCacheDirectory()) return NULL;
+
+        std::ifstream infoFile(getCacheFileName(key, ".info").c_str());
+        if (!infoFile.good()) return NULL;
+        std::string line;
+        if (!std::getline(infoFile, line) || line != getCacheDescriptionLine(description)) {
+            WFVOPENCL_DEBUG( outs() << "cache entry '" << key << "' is stale, ignored.\n"; );
+            return NULL;
+        }
+        info.clear();
+        while (std::getline(infoFile, line)) info.push_back(line);
+        infoFile.close();
+
+        OwningPtr<MemoryBuffer> buffer;
+        if (MemoryBuffer::getFile(getCacheFileName(key, ".bc").c_str(), buffer)) return NULL;
+
+        std::string errorMessage;
+        Module* mod = ParseBitcodeFile(buffer.get(), context, &errorMessage);
+        if (!mod) {
+            errs() << "WARNING: ignoring corrupt cache entry '" << key << "': " << errorMessage << "\n";
+            return NULL;
+        }
+
+        WFVOPENCL_DEBUG( outs() << "loaded module from cache entry '" << key << "'.\n"; );
+        return mod;
+    }
+
+    // moves a completely written file to its final location
+    static bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+        remove(to.c_str()); // rename does not overwrite on Windows
+#endif
+        if (rename(from.c_str(), to.c_str())) {
+            remove(from.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Stores the module under the given key (see loadCachedModule()).
+    // Failures are not fatal, the entry is just not available next time.
+    void storeCachedModule(const std::string& key, const std::string& description, const Module* mod, const std::vector<std::string>& info) {
+        assert (mod);
+        if (!getCacheDirectory()) return;
+
+        // Write to temporary files first, other processes that use the same
+        // cache must never see a partially written entry.
+        std::stringstream sstr;
+#ifdef _WIN32
+        sstr << ".tmp" << GetCurrentProcessId();
+#else
+        sstr << ".tmp" << getpid();
+#endif
+        const std::string bcFileName = getCacheFileName(key, ".bc");
+        const std::string infoFileName = getCacheFileName(key, ".info");
+        const std::string tmpBcFileName = bcFileName + sstr.str();
+        const std::string tmpInfoFileName = infoFileName + sstr.str();
+
+        if (!writeModuleBitcodeToFile(mod, tmpBcFileName)) {
+            remove(tmpBcFileName.c_str());
+            return;
+        }
+
+        std::ofstream infoFile(tmpInfoFileName.c_str());
+        infoFile << getCacheDescriptionLine(description) << "\n";
+        for (std::vector<std::string>::const_iterator it=info.begin(), E=info.end(); it!=E; ++it) {
+            infoFile << *it << "\n";
+        }
+        infoFile.close();
+        if (infoFile.fail()) {
+            errs() << "WARNING: could not write cache entry '" << key << "'!\n";
+            remove(tmpBcFileName.c_str());
+            remove(tmpInfoFileName.c_str());
+            return;
+        }
+
+        // the description is moved last, it makes the entry visible
+        if (!replaceFile(tmpBcFileName, bcFileName) ||
+                !replaceFile(tmpInfoFileName, infoFileName))
+        {
+            errs() << "WARNING: could not write cache entry '" << key << "'!\n";
+            remove(tmpInfoFileName.c_str());
+            return;
+        }
+
+        WFVOPENCL_DEBUG( outs() << "stored module in cache entry '" << key << "'.\n"; );
+    }
+
+    // Collects the functions and global variables that 'value' refers to
+    // (also through constant expressions and initializers).
+    static void collectReferencedGlobals(const Value* value, std::set<const GlobalValue*>& globals, std::vector<const GlobalValue*>& worklist) {
+        if (const GlobalValue* gv = dyn_cast<GlobalValue>(value)) {
+            if (globals.insert(gv).second) worklist.push_back(gv);
+            return;
+        }
+        if (!isa<Constant>(value)) return;
+        const Constant* c = cast<Constant>(value);
+        for (User::const_op_iterator O=c->op_begin(), OE=c->op_end(); O!=OE; ++O) {
+            collectReferencedGlobals(*O, globals, worklist);
+        }
+    }
+
+    // Returns a new module that only contains 'f', all functions it calls
+    // (directly or indirectly) and all globals they use. Everything else
+    // the functions refer to is declared only. Kernels are generated and
+    // compiled in such modules, so their cost does not depend on the size
+    // of the program. The module is also used to move a generated wrapper
+    // between programs (cache, binaries).
+    Module* extractFunction(Module* module, Function* f) {
+        return extractFunctions(module, std::vector<Function*>(1, f));
+    }
+
+    // Same for several functions, e.g. all variants of the wrapper of a
+    // kernel.
+    Module* extractFunctions(Module* module, const std::vector<Function*>& functions) {
+        assert (module && !functions.empty());
+
+        std::set<const GlobalValue*> globals;
+        std::vector<const GlobalValue*> worklist;
+        for (std::vector<Function*>::const_iterator it=functions.begin(), E=functions.end(); it!=E; ++it) {
+            assert (*it && (*it)->getParent() == module);
+            collectReferencedGlobals(*it, globals, worklist);
+        }
+        while (!worklist.empty()) {
+            const GlobalValue* gv = worklist.back();
+            worklist.pop_back();
+            if (isa<GlobalAlias>(gv)) return CloneModule(module); // not worth the effort
+            if (const GlobalVariable* var = dyn_cast<GlobalVariable>(gv)) {
+                if (var->hasInitializer()) collectReferencedGlobals(var->getInitializer(), globals, worklist);
+                continue;
+            }
+            const Function* fn = cast<Function>(gv);
+            for (Function::const_iterator BB=fn->begin(), BBE=fn->end(); BB!=BBE; ++BB) {
+                for (BasicBlock::const_iterator I=BB->begin(), IE=BB->end(); I!=IE; ++I) {
+                    for (User::const_op_iterator O=I->op_begin(), OE=I->op_end(); O!=OE; ++O) {
+                        collectReferencedGlobals(*O, globals, worklist);
+                    }
+                }
+            }
+        }
+
+        // same as CloneModule(), restricted to the collected globals
+        Module* mod = new Module(module->getModuleIdentifier(), module->getContext());
+        mod->setDataLayout(module->getDataLayout());
+        mod->setTargetTriple(module->getTargetTriple());
+        mod->setModuleInlineAsm(module->getModuleInlineAsm());
+
+        ValueToValueMapTy valueMap;
+        for (Module::global_iterator GV=module->global_begin(), GVE=module->global_end(); GV!=GVE; ++GV) {
+            if (!globals.count(GV)) continue;
+            GlobalVariable* copy = new GlobalVariable(*mod,
+                                                      GV->getType()->getElementType(),
+                                                      GV->isConstant(),
+                                                      GV->getLinkage(),
+                                                      (Constant*)NULL,
+                                                      GV->getName(),
+                                                      (GlobalVariable*)NULL,
+                                                      GV->isThreadLocal(),
+                                                      GV->getType()->getAddressSpace());
+            copy->copyAttributesFrom(GV);
+            valueMap[GV] = copy;
+        }
+        for (Module::iterator F=module->begin(), FE=module->end(); F!=FE; ++F) {
+            if (!globals.count(F)) continue;
+            Function* copy = Function::Create(cast<FunctionType>(F->getType()->getElementType()),
+                                              F->getLinkage(),
+                                              F->getName(),
+                                              mod);
+            copy->copyAttributesFrom(F);
+            valueMap[F] = copy;
+        }
+
+        for (Module::global_iterator GV=module->global_begin(), GVE=module->global_end(); GV!=GVE; ++GV) {
+            if (!globals.count(GV) || !GV->hasInitializer()) continue;
+            cast<GlobalVariable>(valueMap[GV])->setInitializer(MapValue(GV->getInitializer(), valueMap));
+        }
+        for (Module::iterator F=module->begin(), FE=module->end(); F!=FE; ++F) {
+            if (!globals.count(F) || F->isDeclaration()) continue;
+            Function* copy = cast<Function>(valueMap[F]);
+            Function::arg_iterator A2 = copy->arg_begin();
+            for (Function::const_arg_iterator A=F->arg_begin(), AE=F->arg_end(); A!=AE; ++A, ++A2) {
+                A2->setName(A->getName());
+                valueMap[A] = A2;
+            }
+            SmallVector<ReturnInst*, 8> returns;
+            CloneFunctionInto(copy, F, valueMap, true, returns);
+        }
+
+        return mod;
+    }
+
+
+    //------------------------------------------------------------------------//
+    // compile report
+    //------------------------------------------------------------------------//
+
+    // Returns the file to which a report of the compilation of each kernel
+    // is appended, or NULL if no reports are collected (the default). The
+    // report is enabled by setting WFVOPENCL_COMPILE_REPORT.
+    const char* getCompileReportPath() {
+        static const char* path = getenv("WFVOPENCL_COMPILE_REPORT");
+        return path && *path != '\0' ? path : NULL;
+    }
+
+    // Counts the instructions of 'f' and of all functions it calls (directly
+    // or indirectly), so the numbers can be compared before and after
+    // inlining or when the kernel is split into continuations.
+    unsigned getNumInstructions(const Function* f) {
+        assert (f);
+        std::set<const Function*> visited;
+        std::vector<const Function*> worklist(1, f);
+        unsigned count = 0;
+        while (!worklist.empty()) {
+            const Function* fn = worklist.back();
+            worklist.pop_back();
+            if (fn->isDeclaration() || !visited.insert(fn).second) continue;
+            for (Function::const_iterator BB=fn->begin(), BBE=fn->end(); BB!=BBE; ++BB) {
+                count += BB->size();
+                for (BasicBlock::const_iterator I=BB->begin(), IE=BB->end(); I!=IE; ++I) {
+                    if (!isa<CallInst>(I)) continue;
+                    const Function* callee = cast<CallInst>(I)->getCalledFunction();
+                    if (callee) worklist.push_back(callee);
+                }
+            }
+        }
+        return count;
+    }
+
+    static double getWallTime() {
+        return TimeRecord::getCurrentTime(true).getWallTime();
+    }
+
+    // A stage starts with function 'f' and ends with the function that it
+    // generated from 'f' (or with 'f' itself). Nothing is done if no report
+    // is collected.
+    void beginCompileStage(CompileReport* report, const Function* f) {
+        if (!report) return;
+        report->stageInstructions = getNumInstructions(f);
+        report->stageStart = getWallTime();
+    }
+
+    void endCompileStage(CompileReport* report, const std::string& name, const Function* f) {
+        if (!report) return;
+        CompileStage stage;
+        stage.name = name;
+        stage.seconds = getWallTime() - report->stageStart;
+        stage.instructionsBefore = report->stageInstructions;
+        stage.instructionsAfter = getNumInstructions(f);
+        report->stages.push_back(stage);
+    }
+
+    // Returns the report as a single line of JSON.
+    std::string printCompileReport(const std::string& kernel_name, const CompileReport& report) {
+        std::stringstream sstr;
+        sstr << "{\"kernel\": \"" << kernel_name << "\", \"stages\": [";
+        double total = 0.0;
+        for (std::vector<CompileStage>::const_iterator it=report.stages.begin(), E=report.stages.end(); it!=E; ++it) {
+            if (it != report.stages.begin()) sstr << ", ";
+            sstr << "{\"name\": \"" << it->name << "\", "
+                << "\"seconds\": " << std::fixed << std::setprecision(6) << it->seconds << ", "
+                << "\"instructions_before\": " << it->instructionsBefore << ", "
+                << "\"instructions_after\": " << it->instructionsAfter << "}";
+            total += it->seconds;
+        }
+        sstr << "], \"total_seconds\": " << std::fixed << std::setprecision(6) << total
+            << ", \"continuations\": " << report.numContinuations
+            << ", \"live_value_struct_sizes\": [";
+        for (size_t i=0, e=report.liveValueStructSizes.size(); i<e; ++i) {
+            if (i > 0) sstr << ", ";
+            sstr << report.liveValueStructSizes[i];
+        }
+        sstr << "], \"machine_code_size\": " << report.machineCodeSize << "}";
+        return sstr.str();
+    }
+
+    // Appends one report to the file given by WFVOPENCL_COMPILE_REPORT (one
+    // JSON object per line, the file may contain several runs).
+    void writeCompileReport(const std::string& json) {
+        const char* path = getCompileReportPath();
+        if (!path) return;
+        std::ofstream file(path, std::ios::app);
+        file << json << "\n";
+        if (!file.good()) {
+            errs() << "WARNING: could not write compile report to '" << path << "'!\n";
+        }
+    }
+
+
+    //------------------------------------------------------------------------//
+    // background jobs
+    //------------------------------------------------------------------------//
+
+    // LLVM has to be prepared once before it is used by several threads.
+    bool startMultithreadedLLVM() {
+        static const bool multithreaded = llvm_start_multithreaded();
+        return multithreaded;
+    }
+
+    // The locks of the driver need no initialization at runtime, so they can
+    // be used at any time, also during the initialization of static objects
+    // (one initializer per DriverLock).
+#ifdef _WIN32
+    static SRWLOCK driverLocks[NUM_DRIVER_LOCKS] = {
+        SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT, SRWLOCK_INIT
+    };
+    void lockDriver(const DriverLock lock) { AcquireSRWLockExclusive(&driverLocks[lock]); }
+    void unlockDriver(const DriverLock lock) { ReleaseSRWLockExclusive(&driverLocks[lock]); }
+#else
+    static pthread_mutex_t driverLocks[NUM_DRIVER_LOCKS] = {
+        PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+        PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+        PTHREAD_MUTEX_INITIALIZER
+    };
+    void lockDriver(const DriverLock lock) { pthread_mutex_lock(&driverLocks[lock]); }
+    void unlockDriver(const DriverLock lock) { pthread_mutex_unlock(&driverLocks[lock]); }
+#endif
+
+    // One lock protects the job queue and the 'finished' flags of all jobs.
+#ifdef _WIN32
+    static SRWLOCK backgroundLock = SRWLOCK_INIT;
+    static CONDITION_VARIABLE backgroundJobQueued = CONDITION_VARIABLE_INIT;
+    static CONDITION_VARIABLE backgroundJobFinished = CONDITION_VARIABLE_INIT;
+
+    static void lockBackgroundJobs() { AcquireSRWLockExclusive(&backgroundLock); }
+    static void unlockBackgroundJobs() { ReleaseSRWLockExclusive(&backgroundLock); }
+    static void waitForBackgroundJobs(CONDITION_VARIABLE* condition) {
+        SleepConditionVariableSRW(condition, &backgroundLock, INFINITE, 0);
+    }
+    static void wakeOneBackgroundThread(CONDITION_VARIABLE* condition) { WakeConditionVariable(condition); }
+    static void wakeAllBackgroundThreads(CONDITION_VARIABLE* condition) { WakeAllConditionVariable(condition); }
+#else
+    static pthread_mutex_t backgroundLock = PTHREAD_MUTEX_INITIALIZER;
+    static pthread_cond_t backgroundJobQueued = PTHREAD_COND_INITIALIZER;
+    static pthread_cond_t backgroundJobFinished = PTHREAD_COND_INITIALIZER;
+
+    static void lockBackgroundJobs() { pthread_mutex_lock(&backgroundLock); }
+    static void unlockBackgroundJobs() { pthread_mutex_unlock(&backgroundLock); }
+    static void waitForBackgroundJobs(pthread_cond_t* condition) {
+        pthread_cond_wait(condition, &backgroundLock);
+    }
+    static void wakeOneBackgroundThread(pthread_cond_t* condition) { pthread_cond_signal(condition); }
+    static void wakeAllBackgroundThreads(pthread_cond_t* condition) { pthread_cond_broadcast(condition); }
+#endif
+
+    typedef void (*BackgroundJobFunction)(void* data);
+    struct BackgroundJob {
+        BackgroundJobFunction function;
+        void* data;
+    };
+    static std::deque<BackgroundJob> backgroundJobs;
+    static unsigned numBackgroundThreads = 0;
+    static unsigned numIdleBackgroundThreads = 0;
+
+    // The threads of the pool run until the application exits.
+    static void runBackgroundJobs() {
+        lockBackgroundJobs();
+        while (true) {
+            while (backgroundJobs.empty()) {
+                ++numIdleBackgroundThreads;
+                waitForBackgroundJobs(&backgroundJobQueued);
+                --numIdleBackgroundThreads;
+            }
+            const BackgroundJob job = backgroundJobs.front();
+            backgroundJobs.pop_front();
+
+            unlockBackgroundJobs();
+            job.function(job.data);
+            lockBackgroundJobs();
+        }
+    }
+
+#ifdef _WIN32
+    static DWORD WINAPI backgroundThreadMain(LPVOID) {
+        runBackgroundJobs();
+        return 0;
+    }
+#else
+    static void* backgroundThreadMain(void*) {
+        runBackgroundJobs();
+        return NULL;
+    }
+#endif
+
+    static bool startBackgroundThread() {
+#ifdef _WIN32
+        HANDLE thread = CreateThread(NULL, 0, backgroundThreadMain, NULL, 0, NULL);
+        if (!thread) return false;
+        CloseHandle(thread);
+#else
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, backgroundThreadMain, NULL)) return false;
+        pthread_detach(thread);
+#endif
+        return true;
+    }
+
+    // Runs 'function' on a pool of background threads (used for compilation,
+    // at most one thread per core is started, when it is required first).
+    // Returns false if no thread could be started, the caller then has to run
+    // the job itself.
+    bool startBackgroundJob(BackgroundJobFunction function, void* data) {
+        assert (function);
+        if (!startMultithreadedLLVM()) return false;
+
+        lockBackgroundJobs();
+        if (numIdleBackgroundThreads <= backgroundJobs.size() &&
+                numBackgroundThreads < getNumHostCores() &&
+                startBackgroundThread())
+        {
+            ++numBackgroundThreads;
+        }
+        const bool started = numBackgroundThreads > 0;
+        if (started) {
+            BackgroundJob job;
+            job.function = function;
+            job.data = data;
+            backgroundJobs.push_back(job);
+            wakeOneBackgroundThread(&backgroundJobQueued);
+        }
+        unlockBackgroundJobs();
+
+        return started;
+    }
+
+    // A job signals its completion through a flag that it owns. Everything
+    // the job wrote before is visible to threads that see the flag set.
+    void finishBackgroundJob(bool* finished) {
+        assert (finished);
+        lockBackgroundJobs();
+        *finished = true;
+        wakeAllBackgroundThreads(&backgroundJobFinished);
+        unlockBackgroundJobs();
+    }
+
+    bool isBackgroundJobFinished(const bool* finished) {
+        assert (finished);
+        lockBackgroundJobs();
+        const bool result = *finished;
+        unlockBackgroundJobs();
+        return result;
+    }
+
+    void waitForBackgroundJob(const bool* finished) {
+        assert (finished);
+        lockBackgroundJobs();
+        while (!*finished) waitForBackgroundJobs(&backgroundJobFinished);
+        unlockBackgroundJobs();
     }
 
 }
@@ -9,8 +9,56 @@ extern "C" {
 
 using namespace llvm;
 
+// Alignment of the memory of buffer objects in bytes (see
+// allocateBufferMemory()): a cache line, which is also enough for the
+// widest vector loads and stores.
+#define WFVOPENCL_BUFFER_ALIGNMENT 64
+
 namespace WFVOpenCL {
 
+// Statistics of the generation of one kernel, only collected if a compile
+// report was requested (see getCompileReportPath()).
+struct CompileStage {
+    std::string name;
+    double seconds; // wall time
+    unsigned instructionsBefore; // of the kernel and the functions it calls
+    unsigned instructionsAfter;
+};
+struct CompileReport {
+    std::vector<CompileStage> stages;
+    double stageStart; // of the stage that is running
+    unsigned stageInstructions;
+    unsigned numContinuations; // 0 if the kernel has no barriers
+    std::vector<unsigned long long> liveValueStructSizes; // bytes, one per continuation
+    size_t machineCodeSize; // bytes
+
+    CompileReport() : stageStart(0.0), stageInstructions(0), numContinuations(0), machineCodeSize(0) {}
+};
+
+// Outcome of the vectorization of one kernel. It is stored with the
+// kernel (cache, program binaries), so the reason has to be a code.
+enum VectorizationFailure {
+    VECTORIZATION_SUCCEEDED = 0,
+    VECTORIZATION_DISABLED,          // driver built with WFVOPENCL_NO_WFV
+    VECTORIZATION_PACKETIZER_FAILED, // packetizer did not generate code
+    VECTORIZATION_INTERNAL_ERROR,    // kernel or packet prototype missing
+    VECTORIZATION_UNKNOWN            // kernel generated by an older driver
+};
+struct VectorizationInfo {
+    VectorizationFailure failure;
+    int simdDim; // -1 if not vectorized
+    // results of the vectorization analysis of the scalar kernel
+    unsigned numUniformValues;
+    unsigned numVaryingValues;
+    unsigned numGathers; // loads from non-consecutive addresses
+    unsigned numScatters; // stores to non-consecutive addresses
+
+    VectorizationInfo()
+        : failure(VECTORIZATION_UNKNOWN), simdDim(-1), numUniformValues(0),
+        numVaryingValues(0), numGathers(0), numScatters(0)
+    {}
+};
+
 bool packetizeKernelFunction(
     const std::string& kernelName,
     const std::string& targetKernelName,
@@ -19,7 +67,10 @@ bool packetizeKernelFunction(
     const cl_uint simdDim,
     const bool use_sse41,
     const bool use_avx,
-    const bool verbose);
+    const bool verbose,
+    const bool relaxedMath,
+    const bool alignedPointers,
+    VectorizationInfo* info); // NULL: no vectorization analysis
     CallInst* insertPrintf(const std::string& message, Value* value, const bool endLine, Instruction* insertBefore);
     bool barrierBetweenInstructions(BasicBlock* block, Instruction* A, Instruction* B, std::set<BasicBlock*>& visitedBlocks);
     void findStepThroughCallbackUses(Instruction* inst, CallInst* call, std::vector<CallInst*>& calls, std::vector<Instruction*>& uses, std::vector<Instruction*>& targets);
@@ -63,10 +114,68 @@ bool packetizeKernelFunction(
     );
     void generateBlockSizeLoopsForWrapper(Function* f, CallInst* call, const unsigned num_dimensions, const int simd_dim, LLVMContext& context, Module* module);
     void generateBlockSizeLoopsForContinuations(const unsigned num_dimensions, const int simd_dim, LLVMContext& context, Function* f, ContinuationGenerator::ContinuationVecType& continuations);
-    Function* createKernel(Function* f, const std::string& kernel_name, const unsigned num_dimensions, const int simd_dim, Module* module, TargetData* targetData, LLVMContext& context, cl_int* errcode_ret, Function** f_SIMD_ret);
+    Function* createKernel(Function* f, const std::string& kernel_name, const unsigned num_dimensions, const int simd_dim, Module* module, TargetData* targetData, LLVMContext& context, cl_int* errcode_ret, Function** f_SIMD_ret, const unsigned optimizationLevel, const bool relaxedMath, const bool alignedPointers, CompileReport* report, VectorizationInfo* vectorization);
+    Function* createSpecializedWrapper(Function* f_wrapper, const std::string& name, const std::vector<cl_uint>& arg_indices, const std::vector<std::string>& values, const unsigned num_dimensions, const cl_uint* local_sizes, const unsigned optimizationLevel);
+    bool getRequiredWorkGroupSize(const Function* f, cl_uint sizes[3]);
     cl_uint convertLLVMAddressSpace(cl_uint llvm_address_space);
     std::string getAddressSpaceString(cl_uint cl_address_space);
+    const char* getHostProcessorVendor();
+    const char* getHostProcessorName();
+    unsigned getHostClockFrequency();
+    unsigned long long getHostMemorySize();
     unsigned long long getDeviceMaxMemAllocSize();
+    unsigned getHostCacheLineSize();
+    unsigned long long getHostCacheSize(const unsigned level);
+    unsigned getNumHostCores();
+    unsigned getNumNumaNodes();
+    unsigned getNumaNodeOfCore(const unsigned core);
+    int getCacheDomainOfCore(const unsigned core, const unsigned level);
+    unsigned getWorkerCore(const unsigned worker);
+    bool pinCurrentThreadToCore(const unsigned core);
+    bool pinCurrentThreadToCores(const unsigned* cores, const unsigned num_cores, const unsigned set_id);
+    void unpinCurrentThread();
+    void* allocateBufferMemory(const size_t size, const cl_mem_flags flags);
+    void freeBufferMemory(void* ptr, const size_t size, const cl_mem_flags flags);
+    const char* getCacheDirectory();
+    const std::string& getDriverBuildId();
+    std::string getCacheKey(const std::string& data);
+    Module* loadCachedModule(const std::string& key, const std::string& description, std::vector<std::string>& info, LLVMContext& context);
+    void storeCachedModule(const std::string& key, const std::string& description, const Module* mod, const std::vector<std::string>& info);
+    Module* extractFunction(Module* module, Function* f);
+    Module* extractFunctions(Module* module, const std::vector<Function*>& functions);
+    const char* getCompileReportPath();
+    unsigned getNumInstructions(const Function* f);
+    void beginCompileStage(CompileReport* report, const Function* f);
+    void endCompileStage(CompileReport* report, const std::string& name, const Function* f);
+    std::string printCompileReport(const std::string& kernel_name, const CompileReport& report);
+    void writeCompileReport(const std::string& json);
+    bool startMultithreadedLLVM();
+    // Locks that serialize state of the driver shared by all threads.
+    enum DriverLock {
+        DRIVER_LOCK_ROOT_DEVICE, // creation of the root device
+        DRIVER_LOCK_PACKETIZER, // the packetizer is not known to be reentrant
+        DRIVER_LOCK_PROGRAM_BUILD, // _cl_program::build of all programs
+        DRIVER_LOCK_CODE_GENERATION, // global floating point options of LLVM
+        DRIVER_LOCK_GROUP_ORDER, // cached group order tables of all kernels
+        NUM_DRIVER_LOCKS
+    };
+    void lockDriver(const DriverLock lock);
+    void unlockDriver(const DriverLock lock);
+    // Holds a lock of the driver as long as it is in scope.
+    class DriverLockGuard {
+    public:
+        explicit DriverLockGuard(const DriverLock l) : lock(l) { lockDriver(lock); }
+        ~DriverLockGuard() { unlockDriver(lock); }
+    private:
+        const DriverLock lock;
+        DriverLockGuard(const DriverLockGuard&);
+        DriverLockGuard& operator=(const DriverLockGuard&);
+    };
+    typedef void (*BackgroundJobFunction)(void* data);
+    bool startBackgroundJob(BackgroundJobFunction function, void* data);
+    void finishBackgroundJob(bool* finished);
+    bool isBackgroundJobFinished(const bool* finished);
+    void waitForBackgroundJob(const bool* finished);
 
 }
 
@@ -13,7 +13,10 @@
 #include <cstring> // memcpy
 
 #include <fstream>
+#include <map>
+#include <set>
 #include <sstream>  // std::stringstream
+#include <vector>
 
 //#include <xmmintrin.h> // test output etc.
 //#include <emmintrin.h> // test output etc. (windows requires this for __m128i)
@@ -48,6 +51,7 @@
 #include "passes/continuationGenerator.h"
 #include "passes/livenessAnalyzer.h"
 #include "llvmTools.hpp"
+#include "builtinLibrary.hpp"
 #include "wfvOpenCL.h"
 
 #ifndef WFVOPENCL_FUNCTION_NAME_BARRIER
@@ -59,7 +63,7 @@
 //----------------------------------------------------------------------------//
 #define WFVOPENCL_VERSION_STRING "0.1" // <major_number>.<minor_number>
 
-#define WFVOPENCL_EXTENSIONS "cl_khr_icd cl_amd_fp64 cl_khr_global_int32_base_atomics cl_khr_global_int32_extended_atomics cl_khr_local_int32_base_atomics cl_khr_local_int32_extended_atomics cl_khr_int64_base_atomics cl_khr_int64_extended_atomics cl_khr_byte_addressable_store cl_khr_gl_sharing cl_ext_device_fission cl_amd_device_attribute_query cl_amd_printf"
+#define WFVOPENCL_EXTENSIONS "cl_khr_icd cl_amd_fp64 cl_khr_global_int32_base_atomics cl_khr_global_int32_extended_atomics cl_khr_local_int32_base_atomics cl_khr_local_int32_extended_atomics cl_khr_int64_base_atomics cl_khr_int64_extended_atomics cl_khr_byte_addressable_store cl_khr_gl_sharing cl_ext_device_fission cl_amd_device_attribute_query cl_amd_printf cl_wfv_kernel_exec_info"
 #define WFVOPENCL_ICD_SUFFIX "pkt"
 #ifdef __APPLE__
 #   define WFVOPENCL_LLVM_DATA_LAYOUT_64 "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
@@ -70,22 +74,18 @@
 #define WFVOPENCL_MAX_WORK_GROUP_SIZE 100000//8192
 #define WFVOPENCL_MAX_NUM_DIMENSIONS 3
 
-#ifdef WFVOPENCL_USE_AVX
-    #undef WFVOPENCL_USE_SSE41
-    #define WFVOPENCL_SIMD_WIDTH 8
-#else
-    #define WFVOPENCL_USE_SSE41
-    #define WFVOPENCL_SIMD_WIDTH 4
-#endif
+// The SIMD width is chosen at runtime for the host (see
+// WFVOpenCL::getSimdWidth()).
 
 #ifdef WFVOPENCL_USE_OPENMP // TODO: #ifdef _OPENMP
     #ifndef WFVOPENCL_NUM_CORES // can be supplied by build script
-        #define WFVOPENCL_NUM_CORES 4 // TODO: determine somehow, omp_get_num_threads() does not work because it is dynamic (=1 if called here)
+        #define WFVOPENCL_NUM_CORES 0 // 0 = use all cores of the host (see getRootDevice())
     #endif
 #else
     #define WFVOPENCL_NUM_CORES 1
 #endif
-#define WFVOPENCL_MAX_NUM_THREADS WFVOPENCL_NUM_CORES*2 // *4 is too much for FloydWarshall (up to 50% slower than *2), NUM_CORES only is not enough (execution times very unstable for some kernels)
+#define WFVOPENCL_MAX_SPECIALIZATIONS 8 // specialized versions per kernel (see _cl_kernel::get_function_for_execution())
+#define WFVOPENCL_THREADS_PER_WORKER 2 // *4 is too much for FloydWarshall (up to 50% slower than *2), NUM_CORES only is not enough (execution times very unstable for some kernels)
     // 5 threads: SimpleConvolution works with 2048/2048/3, segfaults starting somewhere above
     // 8 threads: SimpleConvolution works with 2048/x/3, where x can be as high as 32k (probably higher), 2048 for width is max (segfault above)
     // 5/8 threads: PrefixSum sometimes succeeds, sometimes fails
@@ -777,9 +777,80 @@ struct _cl_platform_id { struct _cl_icd_dispatch* dispatch; };
 static struct _cl_platform_id static_platform = { &static_dispatch };
 
 
-struct _cl_device_id { struct _cl_icd_dispatch* dispatch; };
+/*
+The CPU of the host is exposed as one root device. With cl_ext_device_fission,
+it can be partitioned into sub-devices. Each device owns a set of workers
+(logical processors of the host), and kernels enqueued to a queue of a device
+are only executed by threads bound to the cores of that device.
+*/
+struct _cl_device_id {
+    struct _cl_icd_dispatch* dispatch;
+private:
+    _cl_device_id* parent;
+    std::vector<unsigned> cores; // core of each worker, workers of the same NUMA node are neighbours
+    std::vector<std::vector<unsigned> > node_cores; // cores of this device per NUMA node
+    std::vector<unsigned> node_of_worker; // index into node_cores
+    std::vector<unsigned> node_set_ids; // identify node_cores for WFVOpenCL::pinCurrentThreadToCores()
+    std::vector<cl_device_partition_property_ext> partition_style;
+    cl_uint reference_count;
 
-static struct _cl_device_id static_device = { &static_dispatch };
+public:
+    _cl_device_id(_cl_device_id* parent_device, const std::vector<unsigned>& worker_cores,
+                  const std::vector<cl_device_partition_property_ext>& style)
+        : dispatch(&static_dispatch), parent(parent_device), cores(worker_cores),
+        partition_style(style), reference_count(1)
+    {
+        assert (!cores.empty());
+        static unsigned next_set_id = 0;
+        for (unsigned i=0; i<cores.size(); ++i) {
+            const unsigned node = WFVOpenCL::getNumaNodeOfCore(cores[i]);
+            unsigned j = 0;
+            while (j<node_cores.size() && WFVOpenCL::getNumaNodeOfCore(node_cores[j][0]) != node) ++j;
+            if (j == node_cores.size()) {
+                node_cores.push_back(std::vector<unsigned>());
+                node_set_ids.push_back(next_set_id++);
+            }
+            node_cores[j].push_back(cores[i]);
+            node_of_worker.push_back(j);
+        }
+    }
+
+    inline bool is_root() const { return parent == NULL; }
+    inline _cl_device_id* get_parent() const { return parent; }
+    inline cl_uint get_num_workers() const { return (cl_uint)cores.size(); }
+    inline unsigned get_worker_core(const unsigned worker) const { return cores[worker]; }
+    inline const std::vector<unsigned>& get_cores() const { return cores; }
+    inline unsigned get_num_nodes() const { return (unsigned)node_cores.size(); }
+    inline unsigned get_num_node_workers(const unsigned node) const { return (unsigned)node_cores[node].size(); }
+    inline const std::vector<cl_device_partition_property_ext>& get_partition_style() const { return partition_style; }
+    inline cl_uint get_reference_count() const { return reference_count; }
+    inline void retain() { ++reference_count; }
+    inline bool release() { assert (reference_count > 0); return --reference_count == 0; }
+
+    // Binds thread 'tid' of a team of 'num_threads' threads that executes
+    // the 'tid'-th contiguous part of an iteration space. The corresponding
+    // part of a buffer was first touched by worker
+    // tid*num_workers/num_threads (see clCreateBuffer). If 'exclusive' is
+    // set, the thread gets the core of that worker, otherwise it may float
+    // on the cores of this device on the worker's NUMA node.
+    inline void pin_thread(const unsigned tid, const unsigned num_threads, const bool exclusive) const {
+        const unsigned worker = (unsigned)((unsigned long long)tid * cores.size() / num_threads);
+        if (exclusive) {
+            WFVOpenCL::pinCurrentThreadToCore(cores[worker]);
+            return;
+        }
+        // the root device on a single node leaves placement to the OS, so
+        // threads pinned by a previous launch get back all cores
+        if (is_root() && node_cores.size() < 2) {
+            WFVOpenCL::unpinCurrentThread();
+            return;
+        }
+        const std::vector<unsigned>& set = node_cores[node_of_worker[worker]];
+        WFVOpenCL::pinCurrentThreadToCores(&set[0], (unsigned)set.size(), node_set_ids[node_of_worker[worker]]);
+    }
+};
+
+_cl_device_id* getRootDevice();
 
 /*
 An OpenCL context is created with one or more devices. Contexts
@@ -787,7 +858,10 @@ are used by the OpenCL runtime for managing objects such as command-queues,
 memory, program and kernel objects and for executing kernels on one or more
 devices specified in the context.
 */
-struct _cl_context { struct _cl_icd_dispatch* dispatch; };
+struct _cl_context {
+    struct _cl_icd_dispatch* dispatch;
+    std::vector<_cl_device_id*> devices;
+};
 
 /*
 OpenCL objects such as memory, program and kernel objects are created using a
@@ -803,6 +877,7 @@ synchronization. This is described in Appendix A.
 struct _cl_command_queue {
     struct _cl_icd_dispatch* dispatch;
     _cl_context* context;
+    _cl_device_id* device;
 };
 
 /*
@@ -824,9 +899,17 @@ private:
     void* data;
     const bool canRead;
     const bool canWrite;
+    const cl_mem_flags flags;
+    const bool ownsData; // data was allocated by WFVOpenCL::allocateBufferMemory()
 public:
-    _cl_mem(_cl_context* ctx, size_t bytes, void* values, bool can_read, bool can_write)
-            : dispatch(&static_dispatch), context(ctx), size(bytes), data(values), canRead(can_read), canWrite(can_write) {}
+    _cl_mem(_cl_context* ctx, size_t bytes, void* values, bool can_read, bool can_write,
+            cl_mem_flags mem_flags=0, bool owns_data=false)
+            : dispatch(&static_dispatch), context(ctx), size(bytes), data(values), canRead(can_read), canWrite(can_write),
+            flags(mem_flags), ownsData(owns_data) {}
+
+    ~_cl_mem() {
+        if (ownsData) WFVOpenCL::freeBufferMemory(data, size, flags);
+    }
 
     inline _cl_context* get_context() const { return context; }
     inline void* get_data() const { return data; }
@@ -877,14 +960,137 @@ A program object encapsulates the following information:
        log.
        The number of kernel objects currently attached.
 */
+struct ProgramBuild; // see wfvocl_program.cpp
+
+// A generated kernel lives in a module of its own: its final wrapper,
+// everything the wrapper calls, and the globals they use (see
+// WFVOpenCL::extractFunction()). It is compiled to native code by an
+// execution engine of its own, so the cost of compiling a kernel does not
+// depend on the other kernels of the program.
+struct KernelModule {
+    std::string kernel_name;
+    llvm::Module* module;
+    llvm::ExecutionEngine* engine; // created on first compilation, owns the module from then on
+    // wrapper name -> its version for the required work group size of the
+    // kernel, shared by all kernel objects and kept with the module (see
+    // _cl_kernel::specialize_on_compile_work_group_size())
+    std::map<std::string, llvm::Function*> reqd_wrappers;
+    // versions of the wrappers that kernel objects specialized at runtime
+    // (see _cl_kernel::specialize()), freed with the last kernel object
+    std::vector<llvm::Function*> specialized_functions;
+    cl_uint num_kernels; // kernel objects of the kernel
+
+    KernelModule() : module(NULL), engine(NULL), num_kernels(0) {}
+};
+
+// Versions of a generated kernel besides its generic wrapper. Each one may
+// only be executed if the arguments of a launch have a certain property,
+// which is checked before every launch (see _cl_kernel::select_variant()).
+// The values are flags, variants of several properties combine them. The
+// scalar variant of a vectorized kernel is executed instead of all others
+// if the group size does not fit the SIMD width (see
+// _cl_kernel::fits_simd_width()).
+enum KernelVariant {
+    KERNEL_VARIANT_GENERIC = 0,
+    KERNEL_VARIANT_ALIGNED = 1, // all buffers are aligned to WFVOPENCL_BUFFER_ALIGNMENT
+    KERNEL_VARIANT_NOALIAS = 2, // no buffer that may be written overlaps another one
+    KERNEL_VARIANT_SCALAR = 4, // not vectorized
+    NUM_KERNEL_VARIANTS = 5
+};
+
+// The information about a generated kernel lists the wrappers of its
+// variants after the outcome of its vectorization, "-" if a variant was not
+// generated. Returns the name of the wrapper of 'variant', or an empty
+// string.
+inline std::string getVariantWrapperName(const std::vector<std::string>& info, const cl_uint variant) {
+    if (variant == KERNEL_VARIANT_GENERIC) return info.empty() ? std::string() : info[0];
+    const size_t index = 8 + variant - 1;
+    return index < info.size() && info[index] != "-" ? info[index] : std::string();
+}
+
+// Name of the version of a wrapper for the required work group size of its
+// kernel.
+inline std::string getReqdWrapperName(const std::string& wrapper_name) {
+    return wrapper_name + "_reqd";
+}
+
+// Options of clBuildProgram() that influence code generation.
+struct CompilerOptions {
+    std::vector<std::string> frontendArgs; // -D, -I (passed to clc)
+    unsigned optimizationLevel; // -O0 ... -O3, -cl-opt-disable: 0
+    bool unsafeMath; // -cl-unsafe-math-optimizations, -cl-fast-relaxed-math
+    bool finiteMath; // -cl-finite-math-only, -cl-fast-relaxed-math
+    bool madEnable; // -cl-mad-enable (implied by unsafeMath)
+
+    CompilerOptions()
+        : optimizationLevel(3), unsafeMath(false), finiteMath(false), madEnable(false)
+    {}
+};
+
 struct _cl_program {
     struct _cl_icd_dispatch* dispatch;
     _cl_context* context;
-    const char* fileName;
+    std::vector<_cl_device_id*> devices;
+    std::string source;
     llvm::Module* module;
     llvm::TargetData* targetData;
+    std::string cacheKey; // empty if the compilation cache is disabled
+    std::string cacheDescription;
+    // kernels generated so far (kernel name -> wrapper name, number of
+    // dimensions, SIMD dimension (-1 = not vectorized), outcome of
+    // vectorization, wrappers of the variants), their wrappers are in
+    // 'kernelModules', or in 'module' if it was loaded from a binary
+    std::map<std::string, std::vector<std::string> > generatedKernels;
+    std::map<std::string, KernelModule> kernelModules; // kernel name -> module of generated kernel
+    // build that may still run in the background, its result is not part
+    // of the program before finishProgramBuild() was called
+    ProgramBuild* build;
+    cl_build_status buildStatus;
+    std::string buildOptions;
+    CompilerOptions compilerOptions;
+    std::string buildLog;
+    std::vector<std::string> kernelNames; // all kernels defined in the module
+    std::set<std::string> compiledWrappers; // wrappers compiled to native code
+    // Once all kernels are compiled, the function bodies are released and
+    // only the binary of the program is kept (see releaseProgramBodies()).
+    bool bodiesReleased;
+    // binary for clGetProgramInfo(), created once and kept until kernels are
+    // generated or the program is built again (see getProgramBinary())
+    std::string binary;
+    bool binaryUpToDate;
+    // kernels of the program are specialized at runtime, their wrappers
+    // have to be kept
+    bool bodiesRequired;
+    // references of the application and of the kernel objects, the program
+    // and the native code of its kernels are deleted with the last one
+    cl_uint referenceCount;
+    // kernel objects created from the program, it can not be built again
+    // as long as one of them exists
+    cl_uint numKernels;
+    // created by clCreateProgramWithBinary(), clBuildProgram() has nothing
+    // to compile
+    bool fromBinary;
 };
 
+// Waits for a build that was started by clBuildProgram() and moves its
+// result into the program.
+cl_int finishProgramBuild(_cl_program* program);
+
+// Returns true if native code was generated for the wrapper 'wrapper_name'
+// or for its version for the required work group size.
+bool isWrapperCompiled(const _cl_program* program, const std::string& wrapper_name);
+
+// Releases the function bodies of the program if native code was generated
+// for all of its kernels.
+void releaseProgramBodies(_cl_program* program);
+
+// Drops one reference to the program, deletes it with the last one.
+void releaseProgram(_cl_program* program);
+
+// Appends the compile report of the kernel to the build log of the program
+// and to the report file.
+void emitCompileReport(_cl_program* program, const std::string& kernel_name, const WFVOpenCL::CompileReport& report);
+
 
 struct _cl_kernel_arg {
 private:
@@ -895,6 +1101,7 @@ private:
 
     // only known after clSetKernelArg
     size_t size; // size of entire argument value
+    const _cl_mem* buffer; // memory object of a __global argument
 
 public:
     _cl_kernel_arg(
@@ -905,15 +1112,18 @@ public:
         : element_size(_elem_size),
         address_space(_address_space),
         mem_address(_mem_address),
-        size(_size)
+        size(_size),
+        buffer(NULL)
     {}
 
     inline void set_size(size_t _size) { size = _size; }
+    inline void set_buffer(const _cl_mem* mem) { buffer = mem; }
 
     inline size_t get_size() const { return size; }
     inline size_t get_element_size() const { return element_size; }
     inline cl_uint get_address_space() const { return address_space; }
     inline void* get_mem_address() const { return mem_address; } // must not assert (data) -> can be 0 if non-pointer type (e.g. float)
+    inline const _cl_mem* get_buffer() const { return buffer; }
 };
 
 /*
@@ -927,7 +1137,15 @@ struct _cl_kernel {
 private:
     _cl_context* context;
     _cl_program* program;
-    const void* compiled_function;
+    KernelModule* kernel_module; // shared by all kernel objects of the same kernel
+    cl_uint reference_count;
+    const void* compiled_function; // generated when the kernel is executed first
+    bool compilation_failed;
+    // wrappers of the variants of the kernel and their native code (NULL if
+    // not generated, each one is compiled when it is selected first, see
+    // compile_variant())
+    llvm::Function* variant_wrappers[NUM_KERNEL_VARIANTS];
+    const void* compiled_variants[NUM_KERNEL_VARIANTS];
 
     const cl_uint num_args;
     std::vector<_cl_kernel_arg*> args;
@@ -937,69 +1155,60 @@ private:
 
     cl_uint num_dimensions;
     cl_uint best_simd_dim;
+    WFVOpenCL::VectorizationInfo vectorization_info; // CL_KERNEL_*_WFV queries
+
+    cl_uint group_order; // traversal order of 2D work groups (CL_GROUP_ORDER_*_WFV)
+    size_t bytes_per_work_item; // estimated global memory footprint of one work item
+    bool affinity; // execute each range of groups on the same pinned thread in every launch
+
+    // __attribute__((reqd_work_group_size)), 0 if not given
+    cl_uint compile_work_group_size[3];
+
+    // The values of the selected private arguments and, if requested, the
+    // local sizes are folded into specialized versions of the wrapper (see
+    // get_function_for_execution()).
+    std::vector<cl_uint> specialized_args;
+    bool specialize_local_size;
+    std::string previous_specialization_key; // local sizes and values of the previous launch
+    std::map<std::string, const void*> specialized_functions; // key -> native code (NULL = failed)
+    bool compilation_finished; // see finish_compilation()
+
+    // cached traversal order of 2D work groups (pairs of group ids),
+    // only recomputed if the number of groups, the order, the tile size, or
+    // the bands of the NUMA nodes change (guarded by DRIVER_LOCK_GROUP_ORDER,
+    // several host threads may enqueue the kernel)
+    std::vector<cl_int> group_order_table;
+    cl_uint group_order_table_size[2];
+    cl_uint group_order_table_mode;
+    cl_uint group_order_table_tile;
+    std::vector<cl_uint> group_order_table_bands;
 
 public:
-    _cl_kernel(_cl_context* ctx, _cl_program* prog, llvm::Function* f,
+    _cl_kernel(_cl_context* ctx, _cl_program* prog, llvm::Function* f, KernelModule* kernel_mod,
             llvm::Function* f_wrapper, llvm::Function* f_SIMD=NULL)
-        : dispatch(&static_dispatch), context(ctx), program(prog), compiled_function(NULL), num_args(WFVOpenCL::getNumArgs(f)), args(num_args),
+        : dispatch(&static_dispatch), context(ctx), program(prog), kernel_module(kernel_mod), reference_count(1), compiled_function(NULL), compilation_failed(false), num_args(WFVOpenCL::getNumArgs(f)), args(num_args),
         argument_struct(NULL), argument_struct_size(0), num_dimensions(0), best_simd_dim(0),
+        group_order(CL_GROUP_ORDER_AUTO_WFV), bytes_per_work_item(0), affinity(false), specialize_local_size(false), compilation_finished(false),
+        group_order_table_mode(CL_GROUP_ORDER_AUTO_WFV), group_order_table_tile(0),
         function(f), function_wrapper(f_wrapper), function_SIMD(f_SIMD)
     {
         WFVOPENCL_DEBUG( outs() << "  creating kernel object... \n"; );
-        assert (ctx && prog && f && f_wrapper);
-
-        // compile wrapper function (to be called in clEnqueueNDRangeKernel())
-        // NOTE: be sure that f_SIMD or f are inlined and f_wrapper was optimized to the max :p
-        WFVOPENCL_DEBUG( outs() << "    compiling function '" << f_wrapper->getNameStr() << "'... "; );
-        WFVOPENCL_DEBUG( verifyModule(*prog->module); );
-        WFVOPENCL_DEBUG( WFVOpenCL::writeModuleToFile(prog->module, "debug_kernel_final_before_compilation.mod.ll"); );
-#if 0
-        for (Function::iterator BB=f_wrapper->begin(), BBE=f_wrapper->end(); BB!=BBE; ++BB) {
-            for (BasicBlock::iterator I=BB->begin(), IE=BB->end(); I!=IE; ++I) {
-                if (isa<FPToUIInst>(I)) {
-                    Value* castedVal = I->getOperand(0);
-                    for (Instruction::use_iterator U=I->use_begin(), UE=I->use_end(); U!=UE; ++U) {
-                        if (isa<UIToFPInst>(U)) {
-                            assert (U->getType() == castedVal->getType());
-                            U->replaceAllUsesWith(castedVal);
-                        }
-                    }
-                }
-                if (isa<UIToFPInst>(I)) {
-                    Value* castedVal = I->getOperand(0);
-                    for (Instruction::use_iterator U=I->use_begin(), UE=I->use_end(); U!=UE; ++U) {
-                        if (isa<FPToUIInst>(U)) {
-                            assert (U->getType() == castedVal->getType());
-                            U->replaceAllUsesWith(castedVal);
-                        }
-                    }
-                }
-            }
-        }
-#endif
-        compiled_function = WFVOpenCL::getPointerToFunction(prog->module, f_wrapper);
-        if (!compiled_function) {
-            errs() << "\nERROR: JIT compilation of kernel function failed!\n";
+        assert (ctx && prog && f && kernel_mod && f_wrapper);
+        assert (f_wrapper->getParent() == kernel_mod->module);
+        group_order_table_size[0] = group_order_table_size[1] = 0;
+        for (cl_uint i=0; i<NUM_KERNEL_VARIANTS; ++i) {
+            variant_wrappers[i] = NULL;
+            compiled_variants[i] = NULL;
         }
-#ifdef WFVOPENCL_ENABLE_JIT_PROFILING
-        iJIT_Method_Load ml;
-        ml.method_id = iJIT_GetNewMethodID();
-        const unsigned mnamesize = f_wrapper->getNameStr().size();
-        char* mname = new char[mnamesize]();
-        for (unsigned i=0; i<mnamesize; ++i) {
-            mname[i] = f_wrapper->getNameStr().c_str()[i];
+        variant_wrappers[KERNEL_VARIANT_GENERIC] = f_wrapper;
+
+        ++program->referenceCount; // the program owns the native code of the kernel
+        ++program->numKernels;
+        ++kernel_module->num_kernels;
+
+        if (!WFVOpenCL::getRequiredWorkGroupSize(f, compile_work_group_size)) {
+            compile_work_group_size[0] = compile_work_group_size[1] = compile_work_group_size[2] = 0;
         }
-        ml.method_name = mname;
-        ml.method_load_address = const_cast<void*>(compiled_function);
-        ml.method_size = 42;
-        ml.line_number_size = 0;
-        ml.line_number_table = NULL;
-        ml.class_id = 0;
-        ml.class_file_name = NULL;
-        ml.source_file_name = NULL;
-        iJIT_NotifyEvent(iJVM_EVENT_TYPE_METHOD_LOAD_FINISHED, (void*)&ml);
-#endif
-        WFVOPENCL_DEBUG( if (compiled_function) outs() << "done.\n"; );
 
         // get argument information
         WFVOPENCL_DEBUG( outs() << "    collecting argument information...\n"; );
@@ -1064,7 +1273,16 @@ public:
             WFVOPENCL_DEBUG( outs() << "        addrspace: " << WFVOpenCL::getAddressSpaceString(address_space) << "\n"; );
 
             args[arg_index] = new _cl_kernel_arg(arg_size_bytes, address_space, arg_struct_addr);
+
+            // assume that each work item touches one element of each buffer
+            if (address_space == CL_GLOBAL) {
+                const llvm::Type* elemType = WFVOpenCL::getContainedType(argType, 0);
+                if (elemType->isSized()) {
+                    bytes_per_work_item += WFVOpenCL::getTypeSizeInBits(program->targetData, elemType) / 8;
+                }
+            }
         }
+        if (bytes_per_work_item == 0) bytes_per_work_item = 4;
 
         WFVOPENCL_DEBUG( outs() << "  kernel object created successfully!\n\n"; );
     }
@@ -1072,10 +1290,229 @@ public:
     ~_cl_kernel() {
         args.clear();
         free(argument_struct);
+
+        // Versions specialized at runtime are freed with the last kernel
+        // object of the kernel, the others when the program is deleted.
+        if (--kernel_module->num_kernels == 0) {
+            WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_CODE_GENERATION);
+            for (std::vector<llvm::Function*>::const_iterator it=kernel_module->specialized_functions.begin(),
+                    E=kernel_module->specialized_functions.end(); it!=E; ++it)
+            {
+                WFVOpenCL::freeFunction(kernel_module->engine, *it);
+            }
+            kernel_module->specialized_functions.clear();
+        }
+        --program->numKernels;
+        releaseProgram(program);
+    }
+
+private:
+    // A kernel with a required work group size is never executed with
+    // another one, so only a version of 'f_wrapper' for that size is
+    // compiled (except for a size of 1 in 1D, which executeRangeKernel1D()
+    // increases). The version is created by the first kernel object of the
+    // kernel, the others (also those created after the IR was released)
+    // compile the same one. Returns the wrapper to compile.
+    llvm::Function* specialize_on_compile_work_group_size(llvm::Function* f_wrapper) {
+        if (!has_compile_work_group_size() || (num_dimensions == 1 && compile_work_group_size[0] == 1)) {
+            return f_wrapper;
+        }
+        const std::string wrapper_name = f_wrapper->getNameStr();
+        std::map<std::string, llvm::Function*>::const_iterator it = kernel_module->reqd_wrappers.find(wrapper_name);
+        if (it != kernel_module->reqd_wrappers.end()) return it->second;
+        if (f_wrapper->isDeclaration()) return f_wrapper;
+
+        llvm::Function* f_specialized = WFVOpenCL::createSpecializedWrapper(f_wrapper,
+                                                                            getReqdWrapperName(wrapper_name),
+                                                                            std::vector<cl_uint>(),
+                                                                            std::vector<std::string>(),
+                                                                            num_dimensions,
+                                                                            compile_work_group_size,
+                                                                            program->compilerOptions.optimizationLevel);
+        if (!f_specialized) return f_wrapper;
+        kernel_module->reqd_wrappers[wrapper_name] = f_specialized;
+        return f_specialized;
     }
 
+    // Generates native code for 'f_wrapper' (the generic wrapper or the one
+    // of a variant).
+    const void* compile_wrapper(llvm::Function* f_wrapper, size_t* code_size) {
+        WFVOPENCL_DEBUG( outs() << "    compiling function '" << f_wrapper->getNameStr() << "'... "; );
+        WFVOPENCL_DEBUG( if (!program->bodiesReleased) verifyModule(*kernel_module->module); );
+        WFVOPENCL_DEBUG( WFVOpenCL::writeModuleToFile(kernel_module->module, "debug_kernel_final_before_compilation.mod.ll"); );
+#if 0
+        for (Function::iterator BB=f_wrapper->begin(), BBE=f_wrapper->end(); BB!=BBE; ++BB) {
+            for (BasicBlock::iterator I=BB->begin(), IE=BB->end(); I!=IE; ++I) {
+                if (isa<FPToUIInst>(I)) {
+                    Value* castedVal = I->getOperand(0);
+                    for (Instruction::use_iterator U=I->use_begin(), UE=I->use_end(); U!=UE; ++U) {
+                        if (isa<UIToFPInst>(U)) {
+                            assert (U->getType() == castedVal->getType());
+                            U->replaceAllUsesWith(castedVal);
+                        }
+                    }
+                }
+                if (isa<UIToFPInst>(I)) {
+                    Value* castedVal = I->getOperand(0);
+                    for (Instruction::use_iterator U=I->use_begin(), UE=I->use_end(); U!=UE; ++U) {
+                        if (isa<FPToUIInst>(U)) {
+                            assert (U->getType() == castedVal->getType());
+                            U->replaceAllUsesWith(castedVal);
+                        }
+                    }
+                }
+            }
+        }
+#endif
+        llvm::ExecutionEngine* engine = get_execution_engine();
+        const void* fn = engine ? WFVOpenCL::getPointerToFunction(engine, f_wrapper, code_size) : NULL;
+        if (!fn) return NULL;
+#ifdef WFVOPENCL_ENABLE_JIT_PROFILING
+        iJIT_Method_Load ml;
+        ml.method_id = iJIT_GetNewMethodID();
+        const unsigned mnamesize = f_wrapper->getNameStr().size();
+        char* mname = new char[mnamesize]();
+        for (unsigned i=0; i<mnamesize; ++i) {
+            mname[i] = f_wrapper->getNameStr().c_str()[i];
+        }
+        ml.method_name = mname;
+        ml.method_load_address = const_cast<void*>(fn);
+        ml.method_size = 42;
+        ml.line_number_size = 0;
+        ml.line_number_table = NULL;
+        ml.class_id = 0;
+        ml.class_file_name = NULL;
+        ml.source_file_name = NULL;
+        iJIT_NotifyEvent(iJVM_EVENT_TYPE_METHOD_LOAD_FINISHED, (void*)&ml);
+#endif
+        WFVOPENCL_DEBUG( outs() << "done.\n"; );
+        return fn;
+    }
+
+    // Native code is only generated when the kernel is executed first, many
+    // applications create kernels that they never use. Only the generic
+    // wrapper is compiled (and reported) here, the variants are compiled
+    // when a launch selects them (see compile_variant()).
+    void compile() {
+        assert (!compiled_function && !compilation_failed);
+        // compile wrapper function (to be called in clEnqueueNDRangeKernel())
+        // NOTE: be sure that f_SIMD or f are inlined and f_wrapper was optimized to the max :p
+        const CompilerOptions& options = program->compilerOptions;
+        // the stages of kernel generation were reported when the kernel was
+        // created (see createKernels())
+        WFVOpenCL::CompileReport compile_report;
+        WFVOpenCL::CompileReport* report = WFVOpenCL::getCompileReportPath() ? &compile_report : NULL;
+
+        llvm::Function* f_wrapper = variant_wrappers[KERNEL_VARIANT_GENERIC];
+        if (has_compile_work_group_size()) {
+            WFVOpenCL::beginCompileStage(report, function_wrapper);
+            {
+                // other kernel objects of the kernel share the version
+                WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_CODE_GENERATION);
+                f_wrapper = specialize_on_compile_work_group_size(f_wrapper);
+            }
+            WFVOpenCL::endCompileStage(report, "work group size specialization", f_wrapper);
+        }
+
+        WFVOpenCL::beginCompileStage(report, f_wrapper);
+        size_t code_size = 0;
+        {
+            // the floating point options are global, kernels of other
+            // programs must not be compiled with them at the same time
+            WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_CODE_GENERATION);
+            WFVOpenCL::setFloatingPointOptions(options.unsafeMath, options.finiteMath, options.madEnable);
+            compiled_function = compile_wrapper(f_wrapper, &code_size);
+            WFVOpenCL::setFloatingPointOptions(false, false, false);
+            if (compiled_function) program->compiledWrappers.insert(f_wrapper->getNameStr());
+        }
+        if (report) {
+            WFVOpenCL::endCompileStage(report, "native code generation", f_wrapper);
+            report->machineCodeSize = code_size;
+            emitCompileReport(program, kernel_module->kernel_name, *report);
+        }
+        if (!compiled_function) {
+            errs() << "\nERROR: JIT compilation of kernel function failed!\n";
+            compilation_failed = true;
+            return;
+        }
+        compiled_variants[KERNEL_VARIANT_GENERIC] = compiled_function;
+    }
+
+    // Returns the native code of 'variant', compiles it if it is selected
+    // for the first time. Returns NULL if the variant was not generated, if
+    // its compilation failed, or if its IR was released before (the launches
+    // that ran until then did not need it).
+    const void* compile_variant(const cl_uint variant) {
+        if (compiled_variants[variant] || !variant_wrappers[variant]) return compiled_variants[variant];
+
+        const CompilerOptions& options = program->compilerOptions;
+        WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_CODE_GENERATION);
+        llvm::Function* f_wrapper = specialize_on_compile_work_group_size(variant_wrappers[variant]);
+        // other kernel objects of the kernel may have compiled it already
+        if (!f_wrapper->isDeclaration() || program->compiledWrappers.count(f_wrapper->getNameStr())) {
+            size_t code_size = 0;
+            WFVOpenCL::setFloatingPointOptions(options.unsafeMath, options.finiteMath, options.madEnable);
+            compiled_variants[variant] = compile_wrapper(f_wrapper, &code_size);
+            WFVOpenCL::setFloatingPointOptions(false, false, false);
+        }
+        if (compiled_variants[variant]) program->compiledWrappers.insert(f_wrapper->getNameStr());
+        else variant_wrappers[variant] = NULL; // not tried again
+        return compiled_variants[variant];
+    }
+
+    // All versions of the kernel (see specialize()) are compiled by the
+    // engine of its module.
+    llvm::ExecutionEngine* get_execution_engine() {
+        if (!kernel_module->engine) kernel_module->engine = WFVOpenCL::createExecutionEngine(kernel_module->module);
+        return kernel_module->engine;
+    }
+
+    // The IR of the program can be released once the native code of all of
+    // its kernels is final (see releaseProgramBodies()), which it is not if
+    // a kernel is specialized (see set_specialized_args()). It is only
+    // released after the first launch of the kernel compiled the variant
+    // that the launch selected, variants that are selected first later on
+    // are not available anymore (a variant with a subset of their
+    // properties is executed instead).
+    void finish_compilation() {
+        if (compilation_finished) return;
+        compilation_finished = true;
+        releaseProgramBodies(program);
+    }
+
+    // Generates native code for a version of the wrapper of 'variant' in
+    // which the specialized arguments and the local sizes (unless NULL) have
+    // the given values.
+    const void* specialize(const cl_uint variant, const cl_uint num_dims, const cl_uint* local_work_size, const std::vector<std::string>& values) {
+        assert (values.size() == specialized_args.size());
+        assert (variant_wrappers[variant]);
+        std::stringstream sstr;
+        sstr << variant_wrappers[variant]->getNameStr() << "_specialized";
+        llvm::Function* f_specialized = WFVOpenCL::createSpecializedWrapper(variant_wrappers[variant],
+                                                                            sstr.str(),
+                                                                            specialized_args,
+                                                                            values,
+                                                                            num_dims,
+                                                                            local_work_size,
+                                                                            program->compilerOptions.optimizationLevel);
+        if (!f_specialized) return NULL;
+
+        const CompilerOptions& options = program->compilerOptions;
+        const void* fn = NULL;
+        {
+            WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_CODE_GENERATION);
+            kernel_module->specialized_functions.push_back(f_specialized);
+            WFVOpenCL::setFloatingPointOptions(options.unsafeMath, options.finiteMath, options.madEnable);
+            fn = WFVOpenCL::getPointerToFunction(get_execution_engine(), f_specialized);
+            WFVOpenCL::setFloatingPointOptions(false, false, false);
+        }
+        WFVOPENCL_DEBUG( outs() << "    specialized kernel '" << f_specialized->getNameStr() << "'\n"; );
+        return fn;
+    }
+
+public:
     const llvm::Function* function;
-    const llvm::Function* function_wrapper;
+    llvm::Function* function_wrapper;
     const llvm::Function* function_SIMD;
 
     // Copy 'arg_size' bytes from 'data' into argument_struct at the position
@@ -1116,6 +1553,7 @@ public:
                 //const void* datax = mem->get_data();
                 //memcpy(arg_pos, &datax, arg_size);
                 *(void**)arg_pos = mem->get_data();
+                args[arg_index]->set_buffer(mem); // see select_variant()
                 break;
             }
             case CL_PRIVATE: {
@@ -1151,15 +1589,170 @@ public:
     }
     inline void set_num_dimensions(const cl_uint num_dim) { num_dimensions = num_dim; }
     inline void set_best_simd_dim(const cl_uint dim) { best_simd_dim = dim; }
+    inline void set_vectorization_info(const WFVOpenCL::VectorizationInfo& info) { vectorization_info = info; }
+    inline void set_variant_wrapper(const cl_uint variant, llvm::Function* f_variant) {
+        assert (variant > KERNEL_VARIANT_GENERIC && variant < NUM_KERNEL_VARIANTS);
+        assert (!compiled_function && f_variant && f_variant->getParent() == kernel_module->module);
+        variant_wrappers[variant] = f_variant;
+    }
+    inline void set_group_order(const cl_uint order) { group_order = order; }
+    inline void set_group_order_table(const cl_uint order, const cl_uint num_groups_0, const cl_uint num_groups_1,
+                                      const cl_uint tile, const std::vector<cl_uint>& bands,
+                                      const std::vector<cl_int>& table)
+    {
+        WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_GROUP_ORDER);
+        group_order_table = table;
+        group_order_table_mode = order;
+        group_order_table_tile = tile;
+        group_order_table_bands = bands;
+        group_order_table_size[0] = num_groups_0;
+        group_order_table_size[1] = num_groups_1;
+    }
+    inline void set_affinity(const bool a) { affinity = a; }
+    // Specialization has to be enabled before the kernel is executed first,
+    // afterwards the IR it requires may have been released.
+    inline void set_specialized_args(const std::vector<cl_uint>& indices) {
+        specialized_args = indices;
+        previous_specialization_key.clear();
+        specialized_functions.clear();
+        if (is_specialized()) program->bodiesRequired = true;
+    }
+    inline void set_specialize_local_size(const bool s) {
+        specialize_local_size = s;
+        previous_specialization_key.clear();
+        specialized_functions.clear();
+        if (is_specialized()) program->bodiesRequired = true;
+    }
 
     inline _cl_context* get_context() const { return context; }
     inline _cl_program* get_program() const { return program; }
-    inline const void* get_compiled_function() const { return compiled_function; }
+    inline const void* get_compiled_function() {
+        if (!compiled_function && !compilation_failed) compile();
+        return compiled_function;
+    }
+    // Returns the fastest variant of the kernel that may be executed with the
+    // current arguments and can be compiled (see KernelVariant). The kernel
+    // has to be compiled already.
+    inline cl_uint select_variant() {
+        // all buffers are aligned if the addresses of all of them are
+        size_t addresses = 0;
+        for (cl_uint i=0; i<num_args; ++i) {
+            if (arg_is_global(i)) addresses |= (size_t)*(void**)arg_get_data(i);
+        }
+        cl_uint variant = KERNEL_VARIANT_GENERIC;
+        if (addresses % WFVOPENCL_BUFFER_ALIGNMENT == 0) variant |= KERNEL_VARIANT_ALIGNED;
+
+        // Buffers overlap if the same one is bound to several arguments or
+        // if host pointers overlap (CL_MEM_USE_HOST_PTR). Buffers that the
+        // kernel only reads may overlap.
+        bool disjoint = true;
+        for (cl_uint i=0; i<num_args && disjoint; ++i) {
+            const _cl_mem* a = args[i]->get_buffer();
+            if (!a || !arg_is_global(i)) continue;
+            const char* a_begin = (const char*)a->get_data();
+            for (cl_uint j=i+1; j<num_args && disjoint; ++j) {
+                const _cl_mem* b = args[j]->get_buffer();
+                if (!b || !arg_is_global(j) || (a->isReadOnly() && b->isReadOnly())) continue;
+                const char* b_begin = (const char*)b->get_data();
+                disjoint = a_begin + a->get_size() <= b_begin || b_begin + b->get_size() <= a_begin;
+            }
+        }
+        if (disjoint) variant |= KERNEL_VARIANT_NOALIAS;
+
+        // without the variant, a variant with a subset of its properties
+        // (at least the generic one) is executed
+        for (cl_uint v=variant; ; v=(v-1) & variant) {
+            if (compile_variant(v)) return v;
+        }
+    }
+    // Returns true if the vectorized wrappers can execute groups of the
+    // given size: each one processes a multiple of the SIMD width of work
+    // items in the SIMD dimension.
+    inline bool fits_simd_width(const cl_uint num_dims, const cl_uint* local_work_size) const {
+#ifdef WFVOPENCL_NO_WFV
+        return true;
+#else
+        if (vectorization_info.simdDim < 0) return true; // not vectorized
+        return best_simd_dim < num_dims && local_work_size[best_simd_dim] % WFVOpenCL::getSimdWidth() == 0;
+#endif
+    }
+    // Returns the native code to execute with the given local sizes (as
+    // passed to the wrapper) and the current argument values, or NULL if
+    // the kernel can not be executed with them. If specialization is enabled
+    // (see clSetKernelExecInfoWFV()) and the specialized arguments (and the
+    // local sizes, if requested) are the same in two consecutive launches, a
+    // version specialized on them is generated and used whenever they occur
+    // again. Otherwise, the variant selected for the arguments is used.
+    inline const void* get_function_for_execution(const cl_uint num_dims, const cl_uint* local_work_size) {
+        if (!get_compiled_function()) return NULL;
+        cl_uint variant = KERNEL_VARIANT_SCALAR;
+        if (fits_simd_width(num_dims, local_work_size)) {
+            variant = select_variant();
+        } else if (!compile_variant(variant)) {
+            // the scalar variant does not exist if its generation failed
+            return NULL;
+        }
+        finish_compilation();
+        const void* variant_function = compiled_variants[variant];
+        if (has_compile_work_group_size() || !is_specialized()) return variant_function;
+
+        std::string key(1, (char)variant);
+        if (specialize_local_size) key.append((const char*)local_work_size, num_dims * sizeof(cl_uint));
+        std::vector<std::string> values;
+        for (std::vector<cl_uint>::const_iterator it=specialized_args.begin(), E=specialized_args.end(); it!=E; ++it) {
+            values.push_back(std::string((const char*)arg_get_data(*it), arg_get_element_size(*it)));
+            key += values.back();
+        }
+
+        std::map<std::string, const void*>::const_iterator it = specialized_functions.find(key);
+        if (it != specialized_functions.end()) return it->second ? it->second : variant_function;
+
+        const bool stable = key == previous_specialization_key;
+        previous_specialization_key = key;
+        if (!stable) return variant_function;
+
+        const void* specialized_function = NULL;
+        if (!program->bodiesReleased && specialized_functions.size() < WFVOPENCL_MAX_SPECIALIZATIONS) {
+            specialized_function = specialize(variant, num_dims, specialize_local_size ? local_work_size : NULL, values);
+            specialized_functions[key] = specialized_function;
+        }
+        return specialized_function ? specialized_function : variant_function;
+    }
+    inline bool is_specialized() const { return specialize_local_size || !specialized_args.empty(); }
+    inline bool has_compile_work_group_size() const { return compile_work_group_size[0] != 0; }
+    inline const cl_uint* get_compile_work_group_size() const { return compile_work_group_size; }
     inline cl_uint get_num_args() const { return num_args; }
     inline const void* get_argument_struct() const { return argument_struct; }
     inline size_t get_argument_struct_size() const { return argument_struct_size; }
     inline cl_uint get_num_dimensions() const { return num_dimensions; }
+    inline cl_uint get_reference_count() const { return reference_count; }
+    inline void retain() { ++reference_count; }
+    inline bool release() { assert (reference_count > 0); return --reference_count == 0; }
     inline cl_uint get_best_simd_dim() const { return best_simd_dim; }
+    inline const WFVOpenCL::VectorizationInfo& get_vectorization_info() const { return vectorization_info; }
+    inline const std::string& get_kernel_name() const { return kernel_module->kernel_name; }
+    inline cl_uint get_group_order() const { return group_order; }
+    // Copies the cached group order into 'table' if it was computed for the
+    // given launch, the copy stays valid while other threads replace it.
+    inline bool get_group_order_table(const cl_uint order, const cl_uint num_groups_0, const cl_uint num_groups_1,
+                                      const cl_uint tile, const std::vector<cl_uint>& bands,
+                                      std::vector<cl_int>& table) const
+    {
+        WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_GROUP_ORDER);
+        if (group_order_table.empty() ||
+                group_order_table_mode != order ||
+                group_order_table_tile != tile ||
+                group_order_table_bands != bands ||
+                group_order_table_size[0] != num_groups_0 ||
+                group_order_table_size[1] != num_groups_1)
+        {
+            return false;
+        }
+        table = group_order_table;
+        return true;
+    }
+    inline size_t get_bytes_per_work_item() const { return bytes_per_work_item; }
+    inline bool get_affinity() const { return affinity; }
 
     inline size_t arg_get_size(const cl_uint arg_index) const {
         assert (arg_index < num_args);
@@ -22,6 +22,46 @@ or a frame-buffer. The elements of an image object are selected from a list of p
 formats. The minimum number of elements in a memory object is one.
 */
 
+/**
+ * Helper for clCreateBuffer: initialization of freshly allocated memory.
+ * The pages of a buffer are placed on the NUMA node of the thread that
+ * touches them first. The buffer is split into as many contiguous parts as
+ * the device has workers, and each part is copied from the host (or zeroed)
+ * by a thread on the NUMA node of the worker that also executes the
+ * corresponding part of the groups: the same range of a 1D kernel, or the
+ * same band of group rows of a 2D kernel on a row-major buffer (see
+ * _cl_device_id::pin_thread() and getGroupBands2D()).
+ * Interleaved memory (CL_MEM_NUMA_INTERLEAVE_WFV) is placed by its policy
+ * and buffers of less than a page per worker are not worth a parallel
+ * region, both only get the data of the host.
+ */
+inline void initializeBufferMemory(const _cl_device_id* device, void* device_ptr, const void* host_ptr, const size_t size, const cl_mem_flags flags) {
+#ifdef WFVOPENCL_USE_OPENMP
+    const int num_workers = (int)device->get_num_workers();
+    const size_t page_size = 4096; // the smallest one of the supported hosts
+    if (!(flags & CL_MEM_NUMA_INTERLEAVE_WFV) && size >= (size_t)num_workers * page_size) {
+        int w;
+        const int dynamic = omp_get_dynamic();
+        omp_set_dynamic(0);
+#       pragma omp parallel num_threads(num_workers)
+        {
+#           pragma omp for private(w) schedule(static)
+            for (w=0; w<num_workers; ++w) {
+                device->pin_thread(w, num_workers, false);
+                const size_t begin = (size_t)((unsigned long long)size * w / num_workers);
+                const size_t end   = (size_t)((unsigned long long)size * (w+1) / num_workers);
+                if (host_ptr) memcpy((char*)device_ptr + begin, (const char*)host_ptr + begin, end - begin);
+                else memset((char*)device_ptr + begin, 0, end - begin);
+            }
+            WFVOpenCL::unpinCurrentThread();
+        }
+        omp_set_dynamic(dynamic);
+        return;
+    }
+#endif
+    if (host_ptr) memcpy(device_ptr, host_ptr, size);
+}
+
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_mem CL_API_CALL
 clCreateBuffer(cl_context   context,
                cl_mem_flags flags,
@@ -56,41 +96,30 @@ clCreateBuffer(cl_context   context,
         assert (host_ptr);
         device_ptr = host_ptr;
         WFVOPENCL_DEBUG( outs() << "    using supplied host ptr: " << device_ptr << "\n"; );
+        if (errcode_ret) *errcode_ret = CL_SUCCESS;
+        return new _cl_mem(context, size, device_ptr, canRead, canWrite, flags, false);
     }
 
-    if (allocHostPtr) {
-        device_ptr = malloc(size);
-        WFVOPENCL_DEBUG( outs() << "    new host ptr allocated: " << device_ptr << "\n"; );
-        if (!device_ptr) { if (errcode_ret) *errcode_ret = CL_MEM_OBJECT_ALLOCATION_FAILURE; return NULL; }
-    }
-
-    if (copyHostPtr) {
-        // CL_MEM_COPY_HOST_PTR can be used with
-        // CL_MEM_ALLOC_HOST_PTR to initialize the contents of
-        // the cl_mem object allocated using host-accessible (e.g.
-        // PCIe) memory.
-        assert (host_ptr);
-        if (!allocHostPtr) {
-            device_ptr = malloc(size);
-            WFVOPENCL_DEBUG( outs() << "    new host ptr allocated for copying: " << device_ptr << "\n"; );
-            if (!device_ptr) { if (errcode_ret) *errcode_ret = CL_MEM_OBJECT_ALLOCATION_FAILURE; return NULL; }
-        }
-        // copy data into new_host_ptr
-        WFVOPENCL_DEBUG( outs() << "    copying data of supplied host ptr to new host ptr... "; );
-        memcpy(device_ptr, host_ptr, size);
-        WFVOPENCL_DEBUG( outs() << "done.\n"; );
-    }
+    // In all other cases (CL_MEM_ALLOC_HOST_PTR, CL_MEM_COPY_HOST_PTR or no
+    // flag at all), we allocate new memory.
+    // CL_MEM_COPY_HOST_PTR can be used with CL_MEM_ALLOC_HOST_PTR to initialize
+    // the contents of the cl_mem object allocated using host-accessible (e.g.
+    // PCIe) memory.
+    assert (copyHostPtr || !host_ptr);
+    device_ptr = WFVOpenCL::allocateBufferMemory(size, flags);
+    WFVOPENCL_DEBUG( outs() << "    new host ptr allocated: " << device_ptr << "\n"; );
+    if (!device_ptr) { if (errcode_ret) *errcode_ret = CL_MEM_OBJECT_ALLOCATION_FAILURE; return NULL; }
 
-    // if no flag was supplied, allocate memory (host_ptr must be NULL by specification)
-    if (!device_ptr) {
-        assert (!host_ptr);
-        device_ptr = malloc(size);
-        WFVOPENCL_DEBUG( outs() << "    new host ptr allocated (no flag specified): " << device_ptr << "\n"; );
-        if (!device_ptr) { if (errcode_ret) *errcode_ret = CL_MEM_OBJECT_ALLOCATION_FAILURE; return NULL; }
-    }
+    // copy data of supplied host ptr (if any) to the new memory
+    WFVOPENCL_DEBUG( outs() << "    initializing new host ptr... "; );
+    // If the context holds several (sub-)devices, we can not know which of
+    // them will use the buffer, so the pages are spread over the root device.
+    const _cl_device_id* device = context->devices.size() == 1 ? context->devices[0] : getRootDevice();
+    initializeBufferMemory(device, device_ptr, copyHostPtr ? host_ptr : NULL, size, flags);
+    WFVOPENCL_DEBUG( outs() << "done.\n"; );
 
     if (errcode_ret) *errcode_ret = CL_SUCCESS;
-    return new _cl_mem(context, size, device_ptr, canRead, canWrite);
+    return new _cl_mem(context, size, device_ptr, canRead, canWrite, flags, true);
 }
 
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_mem CL_API_CALL
@@ -10,6 +10,8 @@
  * chapter 5.1 of the OpenCL 1.1 specification.
  */
 
+#include <algorithm> // std::find
+
 #include "wfvocl.h"
 
 /*
@@ -23,10 +25,18 @@ clCreateCommandQueue(cl_context                     context,
                      cl_int *                       errcode_ret)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clCreateCommandQueue!\n"; );
-    errcode_ret = CL_SUCCESS;
+    if (!context) { if (errcode_ret) *errcode_ret = CL_INVALID_CONTEXT; return NULL; }
+    if (!device) { if (errcode_ret) *errcode_ret = CL_INVALID_DEVICE; return NULL; }
+    // the device has to be one of the context (the root device or a sub-device)
+    if (std::find(context->devices.begin(), context->devices.end(), device) == context->devices.end()) {
+        if (errcode_ret) *errcode_ret = CL_INVALID_DEVICE;
+        return NULL;
+    }
+    if (errcode_ret) *errcode_ret = CL_SUCCESS;
     _cl_command_queue* cq = new _cl_command_queue();
     cq->dispatch = &static_dispatch;
     cq->context = context;
+    cq->device = device;
     return cq;
 }
 
@@ -27,6 +27,18 @@ WFVOPENCL_DLLEXPORT CL_API_ENTRY void * CL_API_CALL clGetExtensionFunctionAddres
     if (!strcmp(func_name, "clIcdGetPlatformIDsKHR")) {
         return (void*)clIcdGetPlatformIDsKHR;
     }
+    if (!strcmp(func_name, "clSetKernelExecInfoWFV")) {
+        return (void*)clSetKernelExecInfoWFV;
+    }
+    if (!strcmp(func_name, "clCreateSubDevicesEXT")) {
+        return (void*)clCreateSubDevicesEXT;
+    }
+    if (!strcmp(func_name, "clRetainDeviceEXT")) {
+        return (void*)clRetainDeviceEXT;
+    }
+    if (!strcmp(func_name, "clReleaseDeviceEXT")) {
+        return (void*)clReleaseDeviceEXT;
+    }
 
     return (void*)clIcdGetPlatformIDsKHR;
 
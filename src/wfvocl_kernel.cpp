@@ -10,13 +10,33 @@
  * chapter 5.7 and 5.8 of the OpenCL 1.1 specification.
  */
 
+#include <algorithm> // std::min
+#include <cstdlib> // atoi
+
 #include "cast.h"
 #include "wfvocl.h"
 
+/**
+ * Helper for executeRangeKernel1D: if the application leaves the group size to
+ * us, we want as few groups as possible, but at least one per worker of the
+ * device. The group size has to divide the global size and has to be a
+ * multiple of the SIMD width.
+ */
+inline cl_uint getDefaultLocalWorkSize1D(const cl_uint global_work_size, const cl_uint num_workers) {
+    const cl_uint simd_width = WFVOpenCL::getSimdWidth();
+    const cl_uint max_num_groups = global_work_size / simd_width;
+    for (cl_uint n=std::min(num_workers, max_num_groups); n<max_num_groups; ++n) {
+        if (global_work_size % n == 0 && (global_work_size / n) % simd_width == 0) {
+            return global_work_size / n;
+        }
+    }
+    return simd_width;
+}
+
 /**
  * Helper for clEnqueueNDRangeKernel
  */
-inline cl_int executeRangeKernel1D(cl_kernel kernel, const size_t global_work_size, const size_t local_work_size) {
+inline cl_int executeRangeKernel1D(cl_kernel kernel, const _cl_device_id* device, const size_t global_work_size, const size_t local_work_size) {
     WFVOPENCL_DEBUG( outs() << "  global_work_size: " << global_work_size << "\n"; );
     WFVOPENCL_DEBUG( outs() << "  local_work_size: " << local_work_size << "\n"; );
     if (global_work_size % local_work_size != 0) return CL_INVALID_WORK_GROUP_SIZE;
@@ -28,7 +48,6 @@ typedef void (*kernelFnPtr)(
             const cl_uint*,
             const cl_uint*,
             const cl_int*);
-    kernelFnPtr typedPtr = ptr_cast<kernelFnPtr>(kernel->get_compiled_function());
 
     const void* argument_struct = kernel->get_argument_struct();
 
@@ -36,13 +55,6 @@ typedef void (*kernelFnPtr)(
     // In any case, changing the local work size can introduce arbitrary problems
     // except for the case where it is 1.
 
-#ifndef WFVOPENCL_NO_WFV
-    assert (global_work_size >= WFVOPENCL_SIMD_WIDTH);
-    assert (local_work_size == 1 || local_work_size >= WFVOPENCL_SIMD_WIDTH);
-    assert (global_work_size % WFVOPENCL_SIMD_WIDTH == 0);
-    assert (local_work_size == 1 || local_work_size % WFVOPENCL_SIMD_WIDTH == 0);
-#endif
-
     // unfortunately we have to convert to 32bit values because we work with 32bit internally
     // TODO: in the 1D case we can optimize because only the first value is loaded (automatic truncation)
     const cl_uint modified_global_work_size = (cl_uint)global_work_size;
@@ -50,13 +62,14 @@ typedef void (*kernelFnPtr)(
 #ifdef WFVOPENCL_NO_WFV
     const cl_uint modified_local_work_size = (cl_uint)local_work_size;
 #else
-    if (local_work_size != 1 && local_work_size < WFVOPENCL_SIMD_WIDTH) {
-        errs() << "\nERROR: group size of dimension " << kernel->get_best_simd_dim() << " is smaller than the SIMD width!\n\n";
-        exit(-1);
-    }
+    // Group sizes that are not a multiple of the SIMD width are executed by
+    // the scalar variant of the kernel (see get_function_for_execution()).
+    const cl_uint simd_width = WFVOpenCL::getSimdWidth();
     WFVOPENCL_DEBUG(
         if (local_work_size == 1) {
             errs() << "\nWARNING: group size of dimension " << kernel->get_best_simd_dim() << " is 1, will be increased to multiple of SIMD width!\n\n";
+        } else if (local_work_size % simd_width != 0) {
+            errs() << "\nWARNING: group size of dimension " << kernel->get_best_simd_dim() << " is not a multiple of the SIMD width, executing scalar code!\n\n";
         }
     );
 
@@ -65,10 +78,10 @@ typedef void (*kernelFnPtr)(
     // value unless the application does weird things.
     // TODO: Test if kernel calls get_group_id or get_group_size, in which case we must not change anything!
     // If not, the natural choice is to set the work size in a way that we end up with
-    // exactly as many iterations of the outermost loop as we have cores for multi-threading.
+    // exactly as many iterations of the outermost loop as the device has workers.
     // Using larger amounts of iterations can severely degrade performance (e.g. FloydWarshall, Mandelbrot)
-    const cl_uint modified_local_work_size = local_work_size == 1 ?
-        modified_global_work_size/WFVOPENCL_NUM_CORES : (cl_uint)local_work_size;
+    const cl_uint modified_local_work_size = local_work_size == 1 && modified_global_work_size % simd_width == 0 ?
+        getDefaultLocalWorkSize1D(modified_global_work_size, device->get_num_workers()) : (cl_uint)local_work_size;
 #   else
     const cl_uint modified_local_work_size = local_work_size == 1 ?
         modified_global_work_size : (cl_uint)local_work_size;
@@ -76,6 +89,9 @@ typedef void (*kernelFnPtr)(
 
 #endif
 
+    kernelFnPtr typedPtr = ptr_cast<kernelFnPtr>(kernel->get_function_for_execution(1U, &modified_local_work_size));
+    if (!typedPtr) return CL_INVALID_WORK_GROUP_SIZE;
+
     //
     // execute the kernel
     //
@@ -87,14 +103,22 @@ typedef void (*kernelFnPtr)(
     assert (num_iterations > 0 && "should give error message before executeRangeKernel!");
 
 #ifdef WFVOPENCL_USE_OPENMP
+    // In affinity mode, we use exactly one thread per worker of the device
+    // and a static schedule, so each thread always receives the same range
+    // of groups. Otherwise, threads are only bound to the cores of the device
+    // on the NUMA node that holds the data of their range (see clCreateBuffer).
+    const bool affinity = kernel->get_affinity();
+    const int num_threads = affinity ? device->get_num_workers() :
+        device->get_num_workers() * WFVOPENCL_THREADS_PER_WORKER;
+
     // allocate local memory for each thread to prevent data races
     // TODO: move somewhere else? should all be "static" information!
     const cl_uint numArgs = kernel->get_num_args();
-    void* argstructs[WFVOPENCL_MAX_NUM_THREADS];
-    void** localdata[WFVOPENCL_MAX_NUM_THREADS]; // too much, but easier to access
+    std::vector<void*> argstructs(num_threads);
+    std::vector<void**> localdata(num_threads); // too much, but easier to access
 
     const cl_uint argStrSize = kernel->get_argument_struct_size();
-    for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+    for (cl_int j=0; j<num_threads; ++j) {
         localdata[j] = (void**)malloc(numArgs*sizeof(void*));
         for (cl_uint i=0; i<numArgs; ++i) {
             if (kernel->arg_is_local(i)) {
@@ -115,44 +139,59 @@ typedef void (*kernelFnPtr)(
     cl_int i;
 
 #ifdef WFVOPENCL_USE_OPENMP
-    omp_set_num_threads(WFVOPENCL_MAX_NUM_THREADS);
-#   pragma omp parallel for shared(argument_struct, kernel) private(i)
+    const int dynamic = omp_get_dynamic();
+    omp_set_dynamic(0);
+#   pragma omp parallel shared(argument_struct, kernel) num_threads(num_threads)
+#endif
+    {
+#ifdef WFVOPENCL_USE_OPENMP
+#       pragma omp for private(i) schedule(static)
 #endif
-    for (i=0; i<num_iterations; ++i) {
-        WFVOPENCL_DEBUG_RUNTIME( outs() << "\niteration " << i << " (= group id)\n"; );
-        WFVOPENCL_DEBUG_RUNTIME( verifyModule(*kernel->get_program()->module); );
-        WFVOPENCL_DEBUG_RUNTIME( outs() << "  verification before execution successful!\n"; );
+        for (i=0; i<(cl_int)num_iterations; ++i) {
+            WFVOPENCL_DEBUG_RUNTIME( outs() << "\niteration " << i << " (= group id)\n"; );
+            WFVOPENCL_DEBUG_RUNTIME( verifyModule(*kernel->get_program()->module); );
+            WFVOPENCL_DEBUG_RUNTIME( outs() << "  verification before execution successful!\n"; );
 
 #ifdef WFVOPENCL_USE_OPENMP
-        // fetch this thread's argument struct
-        const cl_uint tid = omp_get_thread_num();
-        void* newargstr = argstructs[tid];
-        // TODO: Adding a local copy seems to help OpenMP-based implementation?!
-        //       Otherwise, TestBarrier2 on Windows crashed (regardless of wrong results).
-        //const cl_uint mg = modified_global_work_size;
-        //const cl_uint ml = modified_local_work_size;
-        //typedPtr(newargstr, 1U, &mg, &ml, &i);
-        typedPtr(newargstr, 1U, &modified_global_work_size, &modified_local_work_size, &i);
+            // fetch this thread's argument struct
+            const cl_uint tid = omp_get_thread_num();
+            device->pin_thread(tid, num_threads, affinity);
+            void* newargstr = argstructs[tid];
+            // TODO: Adding a local copy seems to help OpenMP-based implementation?!
+            //       Otherwise, TestBarrier2 on Windows crashed (regardless of wrong results).
+            //const cl_uint mg = modified_global_work_size;
+            //const cl_uint ml = modified_local_work_size;
+            //typedPtr(newargstr, 1U, &mg, &ml, &i);
+            typedPtr(newargstr, 1U, &modified_global_work_size, &modified_local_work_size, &i);
 #else
-        typedPtr(argument_struct, 1U, &modified_global_work_size, &modified_local_work_size, &i);
+            typedPtr(argument_struct, 1U, &modified_global_work_size, &modified_local_work_size, &i);
 #endif
 
 
-        WFVOPENCL_DEBUG_RUNTIME( outs() << "iteration " << i << " finished!\n"; );
-        WFVOPENCL_DEBUG_RUNTIME( verifyModule(*kernel->get_program()->module); );
-        WFVOPENCL_DEBUG_RUNTIME( outs() << "  verification after execution successful!\n"; );
+            WFVOPENCL_DEBUG_RUNTIME( outs() << "iteration " << i << " finished!\n"; );
+            WFVOPENCL_DEBUG_RUNTIME( verifyModule(*kernel->get_program()->module); );
+            WFVOPENCL_DEBUG_RUNTIME( outs() << "  verification after execution successful!\n"; );
+        }
+
+#ifdef WFVOPENCL_USE_OPENMP
+        // each thread restores the affinity it had before it was pinned in
+        // this region, a later region may run on other threads
+        WFVOpenCL::unpinCurrentThread();
+#endif
     }
 
 #ifdef WFVOPENCL_USE_OPENMP
+    omp_set_dynamic(dynamic);
+
     // clean up memory allocated for local data and each thread's argument struct
     for (cl_uint i=0; i<numArgs; ++i) {
         if (kernel->arg_is_local(i)) {
-            for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+            for (cl_int j=0; j<num_threads; ++j) {
                 free(localdata[j][i]);
             }
         }
     }
-    for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+    for (cl_int j=0; j<num_threads; ++j) {
         free(argstructs[j]);
     }
 #endif
@@ -161,7 +200,115 @@ typedef void (*kernelFnPtr)(
 
     return CL_SUCCESS;
 }
-inline cl_int executeRangeKernel2D(cl_kernel kernel, const size_t* global_work_size, const size_t* local_work_size) {
+/**
+ * Helpers for the traversal order of 2D work groups.
+ * Groups are processed in square tiles whose data fits into the L2 cache, and
+ * the tiles themselves are visited along a space-filling curve. This way,
+ * neighbouring tiles (which share rows/columns of stencil-like kernels) are
+ * executed close in time and mostly by the same thread.
+ * Each order is split into bands of group rows (dimension 1), one per NUMA
+ * node of the device, which are traversed one after the other. The static
+ * schedule hands the band of a node to the threads on that node, which
+ * first touched the same contiguous part of row-major buffers (see
+ * initializeBufferMemory()).
+ */
+inline void mortonIndexToCoords(cl_ulong d, cl_uint& x, cl_uint& y) {
+    x = y = 0;
+    for (cl_uint bit=0; d; ++bit, d >>= 2) {
+        x |= (cl_uint)(d & 1) << bit;
+        y |= (cl_uint)((d >> 1) & 1) << bit;
+    }
+}
+inline void hilbertIndexToCoords(const cl_uint n, cl_ulong d, cl_uint& x, cl_uint& y) {
+    x = y = 0;
+    for (cl_uint s=1; s<n; s*=2) {
+        const cl_uint rx = (cl_uint)(1 & (d/2));
+        const cl_uint ry = (cl_uint)(1 & (d ^ rx));
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s-1-x;
+                y = s-1-y;
+            }
+            const cl_uint tmp = x;
+            x = y;
+            y = tmp;
+        }
+        x += s*rx;
+        y += s*ry;
+        d /= 4;
+    }
+}
+// Returns the number of groups per tile side such that the data touched by
+// one tile fits into half of the L2 cache.
+inline cl_uint getGroupTileSize(cl_kernel kernel, const cl_uint* local_work_size) {
+    const unsigned long long cacheSize = WFVOpenCL::getHostCacheSize(2) / 2;
+    const unsigned long long groupBytes = (unsigned long long)local_work_size[0] *
+        local_work_size[1] * kernel->get_bytes_per_work_item();
+    cl_uint tile = 1;
+    while ((unsigned long long)(2*tile) * (2*tile) * groupBytes <= cacheSize) tile *= 2;
+    return tile;
+}
+inline cl_uint selectGroupOrder(cl_kernel kernel, const cl_uint num_groups_0, const cl_uint num_groups_1, const cl_uint tile) {
+    const cl_uint order = kernel->get_group_order();
+    if (order != CL_GROUP_ORDER_AUTO_WFV) return order;
+    // If the groups of one dimension fit into a single tile, the data
+    // already stays in the cache when walking along the other one.
+    if (num_groups_0 <= tile || num_groups_1 <= tile) return CL_GROUP_ORDER_ROW_MAJOR_WFV;
+    return CL_GROUP_ORDER_HILBERT_WFV;
+}
+// Fills 'bands' with the first group row of the band of each NUMA node of
+// 'device' and the number of rows. The bands are as large as the share of
+// the node in the workers of the device.
+inline void getGroupBands2D(const _cl_device_id* device, const cl_uint num_groups_1, std::vector<cl_uint>& bands) {
+    bands.clear();
+    bands.push_back(0);
+    unsigned workers = 0;
+    for (unsigned node=0; node<device->get_num_nodes(); ++node) {
+        workers += device->get_num_node_workers(node);
+        bands.push_back((cl_uint)((unsigned long long)num_groups_1 * workers / device->get_num_workers()));
+    }
+}
+// Fills 'table' with pairs of group ids in the given (tiled) order, one band
+// (see getGroupBands2D()) after the other.
+inline void computeGroupOrder2D(const cl_uint order, const cl_uint num_groups_0, const cl_uint num_groups_1, const cl_uint tile,
+                                const std::vector<cl_uint>& bands, std::vector<cl_int>& table)
+{
+    assert (order == CL_GROUP_ORDER_MORTON_WFV || order == CL_GROUP_ORDER_HILBERT_WFV);
+    assert (bands.size() >= 2 && bands.front() == 0 && bands.back() == num_groups_1);
+    table.clear();
+    table.reserve(2 * num_groups_0 * num_groups_1);
+
+    for (size_t b=0; b+1<bands.size(); ++b) {
+        const cl_uint begin_1 = bands[b];
+        const cl_uint num_tiles_0 = (num_groups_0 + tile - 1) / tile;
+        const cl_uint num_tiles_1 = (bands[b+1] - begin_1 + tile - 1) / tile;
+
+        // both curves are defined on a square grid with power-of-two side
+        // length, tiles outside of the actual grid are skipped.
+        cl_uint n = 1;
+        while (n < num_tiles_0 || n < num_tiles_1) n *= 2;
+
+        for (cl_ulong d=0, e=(cl_ulong)n*n; d<e; ++d) {
+            cl_uint tx, ty;
+            if (order == CL_GROUP_ORDER_MORTON_WFV) mortonIndexToCoords(d, tx, ty);
+            else hilbertIndexToCoords(n, d, tx, ty);
+            if (tx >= num_tiles_0 || ty >= num_tiles_1) continue;
+
+            // inside a tile, dimension 0 is traversed fastest
+            const cl_uint end_0 = std::min((tx+1)*tile, num_groups_0);
+            const cl_uint end_1 = std::min(begin_1 + (ty+1)*tile, bands[b+1]);
+            for (cl_uint j=begin_1 + ty*tile; j<end_1; ++j) {
+                for (cl_uint i=tx*tile; i<end_0; ++i) {
+                    table.push_back((cl_int)i);
+                    table.push_back((cl_int)j);
+                }
+            }
+        }
+    }
+    assert (table.size() == 2 * num_groups_0 * num_groups_1);
+}
+
+inline cl_int executeRangeKernel2D(cl_kernel kernel, const _cl_device_id* device, const size_t* global_work_size, const size_t* local_work_size) {
     WFVOPENCL_DEBUG( outs() << "  global_work_sizes: " << global_work_size[0] << ", " << global_work_size[1] << "\n"; );
     WFVOPENCL_DEBUG( outs() << "  local_work_sizes: " << local_work_size[0] << ", " << local_work_size[1] << "\n"; );
     if (global_work_size[0] % local_work_size[0] != 0) return CL_INVALID_WORK_GROUP_SIZE;
@@ -174,7 +321,6 @@ inline cl_int executeRangeKernel2D(cl_kernel kernel, const size_t* global_work_s
             const cl_uint*,
             const cl_uint*,
             const cl_int*);
-    kernelFnPtr typedPtr = ptr_cast<kernelFnPtr>(kernel->get_compiled_function());
 
     const void* argument_struct = kernel->get_argument_struct();
 
@@ -182,16 +328,14 @@ inline cl_int executeRangeKernel2D(cl_kernel kernel, const size_t* global_work_s
     const cl_uint modified_global_work_size[2] = { (cl_uint)global_work_size[0], (cl_uint)global_work_size[1] };
     const cl_uint modified_local_work_size[2] = { (cl_uint)local_work_size[0], (cl_uint)local_work_size[1] };
 
-#ifndef WFVOPENCL_NO_WFV
-    const cl_uint simd_dim = kernel->get_best_simd_dim();
-
-    assert (global_work_size[simd_dim] >= WFVOPENCL_SIMD_WIDTH);
-    assert (local_work_size[simd_dim] == 1 || local_work_size[simd_dim] >= WFVOPENCL_SIMD_WIDTH);
-    assert (global_work_size[simd_dim] % WFVOPENCL_SIMD_WIDTH == 0);
-    assert (local_work_size[simd_dim] == 1 || local_work_size[simd_dim] % WFVOPENCL_SIMD_WIDTH == 0);
-#endif
-
-    // TODO: insert warnings as in 1D case if sizes do not match simd width etc.
+    // (group sizes that do not fit the SIMD width select the scalar variant)
+    kernelFnPtr typedPtr = ptr_cast<kernelFnPtr>(kernel->get_function_for_execution(2U, modified_local_work_size));
+    if (!typedPtr) return CL_INVALID_WORK_GROUP_SIZE;
+    WFVOPENCL_DEBUG(
+        if (!kernel->fits_simd_width(2U, modified_local_work_size)) {
+            errs() << "\nWARNING: group size of dimension " << kernel->get_best_simd_dim() << " is not a multiple of the SIMD width, executing scalar code!\n\n";
+        }
+    );
 
     //
     // execute the kernel
@@ -205,14 +349,22 @@ inline cl_int executeRangeKernel2D(cl_kernel kernel, const size_t* global_work_s
     assert (num_iterations_0 > 0 && num_iterations_1 > 0 && "should give error message before executeRangeKernel!");
 
 #ifdef WFVOPENCL_USE_OPENMP
+    // In affinity mode, we use exactly one thread per worker of the device
+    // and a static schedule, so each thread always receives the same range
+    // of groups. Otherwise, threads are only bound to the cores of the device
+    // on the NUMA node that holds the data of their range (see clCreateBuffer).
+    const bool affinity = kernel->get_affinity();
+    const int num_threads = affinity ? device->get_num_workers() :
+        device->get_num_workers() * WFVOPENCL_THREADS_PER_WORKER;
+
     // allocate local memory for each thread to prevent data races
     // TODO: move somewhere else? should all be "static" information!
     const cl_uint numArgs = kernel->get_num_args();
-    void* argstructs[WFVOPENCL_MAX_NUM_THREADS];
-    void** localdata[WFVOPENCL_MAX_NUM_THREADS]; // too much, but easier to access
+    std::vector<void*> argstructs(num_threads);
+    std::vector<void**> localdata(num_threads); // too much, but easier to access
 
     const cl_uint argStrSize = kernel->get_argument_struct_size();
-    for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+    for (cl_int j=0; j<num_threads; ++j) {
         localdata[j] = (void**)malloc(numArgs*sizeof(void*));
         for (cl_uint i=0; i<numArgs; ++i) {
             if (kernel->arg_is_local(i)) {
@@ -230,32 +382,57 @@ inline cl_int executeRangeKernel2D(cl_kernel kernel, const size_t* global_work_s
     }
 #endif
 
-    cl_int i, j;
+    // determine order in which the groups are executed
+    const cl_uint tile = getGroupTileSize(kernel, modified_local_work_size);
+    const cl_uint order = selectGroupOrder(kernel, num_iterations_0, num_iterations_1, tile);
+    // (a copy of the table cached in the kernel, which another thread may
+    // replace during the launch)
+    std::vector<cl_int> group_order_table;
+    const cl_int* group_order = NULL;
+    if (order != CL_GROUP_ORDER_ROW_MAJOR_WFV) {
+        std::vector<cl_uint> bands;
+        getGroupBands2D(device, num_iterations_1, bands);
+        if (!kernel->get_group_order_table(order, num_iterations_0, num_iterations_1, tile, bands, group_order_table)) {
+            computeGroupOrder2D(order, num_iterations_0, num_iterations_1, tile, bands, group_order_table);
+            kernel->set_group_order_table(order, num_iterations_0, num_iterations_1, tile, bands, group_order_table);
+        }
+        group_order = &group_order_table[0];
+    }
+    WFVOPENCL_DEBUG( outs() << "  group order: " << order << " (tile size: " << tile << ")\n"; );
+
+    const cl_int num_iterations = (cl_int)(num_iterations_0 * num_iterations_1);
+    cl_int g;
 
 #ifdef WFVOPENCL_USE_OPENMP
-    omp_set_num_threads(WFVOPENCL_MAX_NUM_THREADS);
-#   ifdef _WIN32
-#      pragma omp parallel for shared(argument_struct) private(i, j) // VS2010 only supports OpenMP 2.5
-#   else
-#      pragma omp parallel for shared(argument_struct) private(i, j) collapse(2) // collapse requires OpenMP 3.0
-#   endif
+    // static schedule: each thread executes a contiguous part of the order
+    const int dynamic = omp_get_dynamic();
+    omp_set_dynamic(0);
+#   pragma omp parallel shared(argument_struct, group_order) num_threads(num_threads)
 #endif
-    for (i=0; i<num_iterations_0; ++i) {
-        for (j=0; j<num_iterations_1; ++j) {
-            WFVOPENCL_DEBUG_RUNTIME( outs() << "\niteration " << i << "/"  << j << " (= group ids)\n"; );
-            WFVOPENCL_DEBUG_RUNTIME( verifyModule(*kernel->get_program()->module); );
+    {
+#ifdef WFVOPENCL_USE_OPENMP
+#       pragma omp for private(g) schedule(static)
+#endif
+        for (g=0; g<num_iterations; ++g) {
+            cl_int group_id[2];
+            if (group_order) {
+                group_id[0] = group_order[2*g];
+                group_id[1] = group_order[2*g+1];
+            } else {
+                // rows of groups (dimension 1) one after the other, so each
+                // thread executes a band of rows
+                group_id[0] = g % num_iterations_0;
+                group_id[1] = g / num_iterations_0;
+            }
 
-            const cl_int group_id[2] = { i, j };
+            WFVOPENCL_DEBUG_RUNTIME( outs() << "\niteration " << group_id[0] << "/"  << group_id[1] << " (= group ids)\n"; );
+            WFVOPENCL_DEBUG_RUNTIME( verifyModule(*kernel->get_program()->module); );
 
 #ifdef WFVOPENCL_USE_OPENMP
             // fetch this thread's argument struct
             const cl_uint tid = omp_get_thread_num();
+            device->pin_thread(tid, num_threads, affinity);
             void* newargstr = argstructs[tid];
-            // TODO: Adding a local copy seems to help OpenMP-based implementation?!
-            //       Otherwise, TestBarrier2 on Windows crashed (regardless of wrong results).
-            //const cl_uint mg = modified_global_work_size;
-            //const cl_uint ml = modified_local_work_size;
-            //typedPtr(newargstr, 1U, &mg, &ml, &i);
             typedPtr(newargstr,
                 2U,
                 modified_global_work_size,
@@ -272,21 +449,29 @@ inline cl_int executeRangeKernel2D(cl_kernel kernel, const size_t* global_work_s
             );
 #endif
 
-            WFVOPENCL_DEBUG_RUNTIME( outs() << "iteration " << i << "/" << j << " finished!\n"; );
+            WFVOPENCL_DEBUG_RUNTIME( outs() << "iteration " << group_id[0] << "/" << group_id[1] << " finished!\n"; );
             WFVOPENCL_DEBUG_RUNTIME( verifyModule(*kernel->get_program()->module); );
         }
+
+#ifdef WFVOPENCL_USE_OPENMP
+        // each thread restores the affinity it had before it was pinned in
+        // this region, a later region may run on other threads
+        WFVOpenCL::unpinCurrentThread();
+#endif
     }
 
 #ifdef WFVOPENCL_USE_OPENMP
+    omp_set_dynamic(dynamic);
+
     // clean up memory allocated for local data and each thread's argument struct
     for (cl_uint i=0; i<numArgs; ++i) {
         if (kernel->arg_is_local(i)) {
-            for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+            for (cl_int j=0; j<num_threads; ++j) {
                 free(localdata[j][i]);
             }
         }
     }
-    for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+    for (cl_int j=0; j<num_threads; ++j) {
         free(argstructs[j]);
     }
 #endif
@@ -295,7 +480,7 @@ inline cl_int executeRangeKernel2D(cl_kernel kernel, const size_t* global_work_s
 
     return CL_SUCCESS;
 }
-inline cl_int executeRangeKernel3D(cl_kernel kernel, const size_t* global_work_size, const size_t* local_work_size) {
+inline cl_int executeRangeKernel3D(cl_kernel kernel, const _cl_device_id* device, const size_t* global_work_size, const size_t* local_work_size) {
     assert (false && "NOT IMPLEMENTED!");
     outs() << "Support for kernels with #dimensions > 2 not fully implemented yet!\n";
     return CL_INVALID_WORK_DIMENSION;
@@ -313,7 +498,6 @@ inline cl_int executeRangeKernel3D(cl_kernel kernel, const size_t* global_work_s
             const cl_uint*,
             const cl_uint*,
             const cl_int*);
-    kernelFnPtr typedPtr = ptr_cast<kernelFnPtr>(kernel->get_compiled_function());
 
     const void* argument_struct = kernel->get_argument_struct();
 
@@ -321,6 +505,9 @@ inline cl_int executeRangeKernel3D(cl_kernel kernel, const size_t* global_work_s
     const cl_uint modified_global_work_size[3] = { (cl_uint)global_work_size[0], (cl_uint)global_work_size[1], (cl_uint)global_work_size[2] };
     const cl_uint modified_local_work_size[3] = { (cl_uint)local_work_size[0], (cl_uint)local_work_size[1],(cl_uint)local_work_size[2] };
 
+    kernelFnPtr typedPtr = ptr_cast<kernelFnPtr>(kernel->get_function_for_execution(3U, modified_local_work_size));
+    if (!typedPtr) return CL_INVALID_WORK_GROUP_SIZE;
+
     //
     // execute the kernel
     //
@@ -332,14 +519,16 @@ inline cl_int executeRangeKernel3D(cl_kernel kernel, const size_t* global_work_s
     assert (num_iterations_0 > 0 && num_iterations_1 > 0 && num_iterations_2 && "should give error message before executeRangeKernel!");
 
 #ifdef WFVOPENCL_USE_OPENMP
+    const int num_threads = device->get_num_workers() * WFVOPENCL_THREADS_PER_WORKER;
+
     // allocate local memory for each thread to prevent data races
     // TODO: move somewhere else? should all be "static" information!
     const cl_uint numArgs = kernel->get_num_args();
-    void* argstructs[WFVOPENCL_MAX_NUM_THREADS];
-    void** localdata[WFVOPENCL_MAX_NUM_THREADS]; // too much, but easier to access
+    std::vector<void*> argstructs(num_threads);
+    std::vector<void**> localdata(num_threads); // too much, but easier to access
 
     const cl_uint argStrSize = kernel->get_argument_struct_size();
-    for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+    for (cl_int j=0; j<num_threads; ++j) {
         localdata[j] = (void**)malloc(numArgs*sizeof(void*));
         for (cl_uint i=0; i<numArgs; ++i) {
             if (kernel->arg_is_local(i)) {
@@ -360,7 +549,7 @@ inline cl_int executeRangeKernel3D(cl_kernel kernel, const size_t* global_work_s
     cl_int i, j, k;
 
 #ifdef WFVOPENCL_USE_OPENMP
-    omp_set_num_threads(WFVOPENCL_MAX_NUM_THREADS);
+    omp_set_num_threads(num_threads);
 #   ifdef _WIN32
 #       pragma omp parallel for shared(argument_struct) private(i, j, k) // VS2010 only supports OpenMP 2.5
 #   else
@@ -393,12 +582,12 @@ inline cl_int executeRangeKernel3D(cl_kernel kernel, const size_t* global_work_s
     // clean up memory allocated for local data and each thread's argument struct
     for (cl_uint i=0; i<numArgs; ++i) {
         if (kernel->arg_is_local(i)) {
-            for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+            for (cl_int j=0; j<num_threads; ++j) {
                 free(localdata[j][i]);
             }
         }
     }
-    for (cl_uint j=0; j<WFVOPENCL_MAX_NUM_THREADS; ++j) {
+    for (cl_int j=0; j<num_threads; ++j) {
         free(argstructs[j]);
     }
 #endif
@@ -417,52 +606,284 @@ inline cl_int executeRangeKernelND(cl_kernel kernel, const cl_uint num_dimension
  * from chapter 5.7
  */
 
-// -> compile bitcode of function from .bc file to native code
-// -> store void* in _cl_kernel object
-WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_kernel CL_API_CALL
-clCreateKernel(cl_program      program,
-               const char *    kernel_name,
-               cl_int *        errcode_ret)
+// Builds the information that is stored about a generated kernel.
+static void getKernelInfo(llvm::Function* const variant_wrappers[NUM_KERNEL_VARIANTS], const unsigned num_dimensions, const int simd_dim,
+                          const WFVOpenCL::VectorizationInfo& vectorization, std::vector<std::string>& info)
 {
-    WFVOPENCL_DEBUG ( outs() << "ENTERED clCreateKernel!\n"; );
-    if (!program) { *errcode_ret = CL_INVALID_PROGRAM; return NULL; }
-    if (!program->module) {
-        if (errcode_ret != NULL) {
-            *errcode_ret = CL_INVALID_PROGRAM_EXECUTABLE;
+    assert (variant_wrappers[KERNEL_VARIANT_GENERIC]);
+    info.clear();
+    info.push_back(variant_wrappers[KERNEL_VARIANT_GENERIC]->getNameStr());
+    std::stringstream sstr;
+    sstr << num_dimensions;
+    info.push_back(sstr.str());
+    sstr.str("");
+    sstr << simd_dim;
+    info.push_back(sstr.str());
+
+    // outcome of vectorization: failure code, uniform values, varying
+    // values, gathers, scatters
+    const unsigned values[] = {
+        (unsigned)vectorization.failure,
+        vectorization.numUniformValues,
+        vectorization.numVaryingValues,
+        vectorization.numGathers,
+        vectorization.numScatters
+    };
+    for (unsigned i=0; i<5; ++i) {
+        sstr.str("");
+        sstr << values[i];
+        info.push_back(sstr.str());
+    }
+
+    // wrappers of the variants (see getVariantWrapperName())
+    for (cl_uint i=1; i<NUM_KERNEL_VARIANTS; ++i) {
+        info.push_back(variant_wrappers[i] ? variant_wrappers[i]->getNameStr() : "-");
+    }
+}
+
+// Kernels that were generated by an older version of the driver have no
+// information about their vectorization.
+static WFVOpenCL::VectorizationInfo getVectorizationInfo(const std::vector<std::string>& info) {
+    WFVOpenCL::VectorizationInfo vectorization;
+    vectorization.simdDim = atoi(info[2].c_str());
+    if (info.size() < 8) return vectorization;
+    const int failure = atoi(info[3].c_str());
+    if (failure < WFVOpenCL::VECTORIZATION_SUCCEEDED || failure > WFVOpenCL::VECTORIZATION_UNKNOWN) return vectorization;
+    vectorization.failure = (WFVOpenCL::VectorizationFailure)failure;
+    vectorization.numUniformValues = (unsigned)atoi(info[4].c_str());
+    vectorization.numVaryingValues = (unsigned)atoi(info[5].c_str());
+    vectorization.numGathers = (unsigned)atoi(info[6].c_str());
+    vectorization.numScatters = (unsigned)atoi(info[7].c_str());
+    return vectorization;
+}
+
+// Describes the outcome of the vectorization of a kernel (for the build log
+// and CL_KERNEL_VECTORIZATION_LOG_WFV).
+static std::string printVectorizationInfo(const std::string& kernel_name, const WFVOpenCL::VectorizationInfo& vectorization) {
+    std::stringstream sstr;
+    sstr << "kernel '" << kernel_name << "': ";
+    switch (vectorization.failure) {
+        case WFVOpenCL::VECTORIZATION_SUCCEEDED:
+            sstr << "vectorized in dimension " << vectorization.simdDim;
+            break;
+        case WFVOpenCL::VECTORIZATION_DISABLED:
+            sstr << "not vectorized (vectorization is disabled in this driver), executing scalar code";
+            break;
+        case WFVOpenCL::VECTORIZATION_PACKETIZER_FAILED:
+            sstr << "not vectorized (packetizer could not vectorize the kernel), executing scalar code";
+            break;
+        case WFVOpenCL::VECTORIZATION_INTERNAL_ERROR:
+            sstr << "not vectorized (internal error), executing scalar code";
+            break;
+        default:
+            if (vectorization.simdDim >= 0) sstr << "vectorized in dimension " << vectorization.simdDim;
+            else sstr << "not vectorized (reason unknown), executing scalar code";
+            return sstr.str();
+    }
+    if (vectorization.failure == WFVOpenCL::VECTORIZATION_DISABLED) return sstr.str();
+    sstr << " (uniform values: " << vectorization.numUniformValues
+        << ", varying values: " << vectorization.numVaryingValues
+        << ", gathers: " << vectorization.numGathers
+        << ", scatters: " << vectorization.numScatters << ")";
+    return sstr.str();
+}
+
+// Makes 'mod' the module of the generated kernel 'kernel_name'. The program
+// owns it from then on.
+static KernelModule* addKernelModule(_cl_program* program, const std::string& kernel_name, llvm::Module* mod) {
+    assert (mod && !program->kernelModules.count(kernel_name));
+    KernelModule* kernel_module = &program->kernelModules[kernel_name];
+    kernel_module->module = mod;
+    kernel_module->kernel_name = kernel_name;
+    return kernel_module;
+}
+
+// Creates the kernel from a wrapper that was generated before, described by
+// 'info' (see getKernelInfo()). If the wrapper was loaded with a program
+// binary, it is moved to a module of its own first. Returns NULL if the
+// information is invalid.
+static _cl_kernel* createKernelFromInfo(_cl_program* program, llvm::Function* f, const std::string& kernel_name, const std::vector<std::string>& info) {
+    // info: wrapper name, number of dimensions, SIMD dimension (-1 = not
+    // vectorized), outcome of vectorization, wrappers of the variants (see
+    // getKernelInfo())
+    if (info.size() < 3) return NULL;
+    const unsigned num_dimensions = (unsigned)atoi(info[1].c_str());
+    const int simd_dim = atoi(info[2].c_str());
+    if (num_dimensions < 1 || num_dimensions > 3 || simd_dim >= (int)num_dimensions) return NULL;
+
+    std::map<std::string, KernelModule>::iterator it = program->kernelModules.find(kernel_name);
+    KernelModule* kernel_module = it != program->kernelModules.end() ? &it->second : NULL;
+    if (!kernel_module) {
+        std::vector<llvm::Function*> wrappers;
+        for (cl_uint i=0; i<NUM_KERNEL_VARIANTS; ++i) {
+            const std::string wrapper_name = getVariantWrapperName(info, i);
+            llvm::Function* f_wrapper = wrapper_name.empty() ? NULL : program->module->getFunction(wrapper_name);
+            if (f_wrapper && !f_wrapper->isDeclaration()) wrappers.push_back(f_wrapper);
+            else if (i == KERNEL_VARIANT_GENERIC) return NULL;
         }
+        kernel_module = addKernelModule(program, kernel_name, WFVOpenCL::extractFunctions(program->module, wrappers));
+    }
+
+    // after all kernels were compiled, only their native code is left
+    llvm::Function* f_wrapper = kernel_module->module->getFunction(info[0]);
+    if (!f_wrapper) return NULL;
+    if (f_wrapper->isDeclaration() && !isWrapperCompiled(program, info[0])) return NULL;
+
+    _cl_kernel* kernel = new _cl_kernel(program->context, program, f, kernel_module, f_wrapper);
+    for (cl_uint i=1; i<NUM_KERNEL_VARIANTS; ++i) {
+        const std::string wrapper_name = getVariantWrapperName(info, i);
+        llvm::Function* f_variant = wrapper_name.empty() ? NULL : kernel_module->module->getFunction(wrapper_name);
+        if (!f_variant) continue;
+        if (f_variant->isDeclaration() && !isWrapperCompiled(program, wrapper_name)) continue;
+        kernel->set_variant_wrapper(i, f_variant);
+    }
+    kernel->set_num_dimensions(num_dimensions);
+    if (simd_dim >= 0) kernel->set_best_simd_dim(simd_dim);
+    kernel->set_vectorization_info(getVectorizationInfo(info));
+    return kernel;
+}
+
+// A cached kernel consists of its module (see WFVOpenCL::extractFunction())
+// and the information that is otherwise derived during kernel generation.
+// (Entries that only held the wrapper are not valid anymore.)
+static std::string getKernelCacheDescription(const _cl_program* program, const std::string& kernel_name) {
+    return program->cacheDescription + " kernel module: " + kernel_name;
+}
+
+static std::string getKernelCacheKey(const _cl_program* program, const std::string& kernel_name) {
+    return WFVOpenCL::getCacheKey(program->cacheKey + "\n" + kernel_name);
+}
+
+static void storeKernelInCache(const _cl_program* program, const std::string& kernel_name, const llvm::Module* mod, const std::vector<std::string>& info) {
+    if (program->cacheKey.empty()) return;
+    WFVOpenCL::storeCachedModule(getKernelCacheKey(program, kernel_name),
+                                 getKernelCacheDescription(program, kernel_name),
+                                 mod,
+                                 info);
+}
+
+// Creates the kernel from the module that an earlier run generated for the
+// same program, or returns NULL if the cache holds no valid entry.
+static _cl_kernel* createKernelFromCache(_cl_program* program, llvm::Function* f, const std::string& kernel_name) {
+    if (program->cacheKey.empty() || program->kernelModules.count(kernel_name)) return NULL;
+
+    std::vector<std::string> info;
+    llvm::Module* cached = WFVOpenCL::loadCachedModule(getKernelCacheKey(program, kernel_name),
+                                                       getKernelCacheDescription(program, kernel_name),
+                                                       info,
+                                                       program->module->getContext());
+    if (!cached) return NULL;
+    if (info.empty() || !cached->getFunction(info[0])) {
+        delete cached;
         return NULL;
     }
-    WFVOPENCL_DEBUG( outs() << "\nclCreateKernel(" << program->module->getModuleIdentifier() << ", " << kernel_name << ")\n"; );
 
-    // does the returned error code mean we should compile before??
-    llvm::Module* module = program->module;
+    addKernelModule(program, kernel_name, cached);
+    _cl_kernel* kernel = createKernelFromInfo(program, f, kernel_name, info);
+    if (!kernel) {
+        program->kernelModules.erase(kernel_name);
+        delete cached;
+        return NULL;
+    }
+    program->generatedKernels[kernel_name] = info;
+    program->binaryUpToDate = false;
+    program->buildLog += printVectorizationInfo(kernel_name, getVectorizationInfo(info)) + "\n";
 
-    if (!kernel_name) { *errcode_ret = CL_INVALID_VALUE; return NULL; }
+    WFVOPENCL_DEBUG( outs() << "  loaded kernel '" << kernel_name << "' from cache.\n"; );
+    return kernel;
+}
 
-    std::stringstream strs;
-    strs << "__OpenCL_" << kernel_name << "_kernel";
-    const std::string new_kernel_name = strs.str();
+// Returns true if 'arg' is a __global pointer.
+static bool isBufferArgument(const llvm::Argument* arg) {
+    return WFVOpenCL::isPointerType(arg->getType()) && WFVOpenCL::getAddressSpace(arg->getType()) == 1;
+}
 
-    WFVOPENCL_DEBUG( outs() << "new kernel name: " << new_kernel_name << "\n"; );
+// Returns the number of __global pointer arguments of kernel 'f'.
+static unsigned getNumBufferArguments(const llvm::Function* f) {
+    unsigned num_buffers = 0;
+    for (llvm::Function::const_arg_iterator A=f->arg_begin(), AE=f->arg_end(); A!=AE; ++A) {
+        if (isBufferArgument(A)) ++num_buffers;
+    }
+    return num_buffers;
+}
 
-    llvm::Function* f = WFVOpenCL::getFunction(new_kernel_name, module);
-    if (!f) { *errcode_ret = CL_INVALID_KERNEL_NAME; return NULL; }
+// Returns the name of 'variant' (see KernelVariant), e.g. "aligned_noalias".
+static std::string getVariantName(const cl_uint variant) {
+    if (variant == KERNEL_VARIANT_SCALAR) return "scalar";
+    std::string name;
+    if (variant & KERNEL_VARIANT_ALIGNED) name += "_aligned";
+    if (variant & KERNEL_VARIANT_NOALIAS) name += "_noalias";
+    return name.empty() ? "generic" : name.substr(1);
+}
 
-    WFVOPENCL_DEBUG( WFVOpenCL::writeModuleToFile(module, "debug_kernel_orig_noopt.mod.ll"); );
+// Generates the wrapper of 'variant' from 'f_variant', a copy of the
+// optimized kernel (see generateKernel()). Returns NULL if the variant
+// could not be generated or would not be faster than the generic wrapper.
+static llvm::Function* generateKernelVariant(llvm::Function* f_variant, const cl_uint variant, const std::string& kernel_name,
+                                             llvm::Module* module, llvm::TargetData* targetData, const CompilerOptions& options,
+                                             const unsigned num_dimensions, const int simd_dim)
+{
+    if (variant & KERNEL_VARIANT_NOALIAS) {
+        // The buffers do not overlap (see _cl_kernel::select_variant()).
+        // Inlining the kernel into its wrapper drops the attributes, so the
+        // kernel is optimized again with them: loads can be hoisted and
+        // stores sunk across accesses to other buffers.
+        for (llvm::Function::arg_iterator A=f_variant->arg_begin(), AE=f_variant->arg_end(); A!=AE; ++A) {
+            if (isBufferArgument(A)) f_variant->addAttribute(A->getArgNo() + 1, llvm::Attribute::NoAlias);
+        }
+#ifdef WFVOPENCL_NO_WFV
+        WFVOpenCL::optimizeFunction(f_variant, false, false, options.optimizationLevel);
+#else
+        WFVOpenCL::optimizeFunction(f_variant, false, true, options.optimizationLevel);
+#endif
+    }
 
-    // before doing anything, replace function names generated by clc
-    WFVOpenCL::fixFunctionNames(module);
+    const std::string variant_kernel_name = kernel_name + "_" + getVariantName(variant);
+    cl_int err = CL_SUCCESS;
+#ifdef WFVOPENCL_NO_WFV
+    return WFVOpenCL::createKernel(f_variant, variant_kernel_name, num_dimensions, -1, module, targetData, module->getContext(), &err, NULL, options.optimizationLevel, options.unsafeMath, false, NULL, NULL);
+#else
+    if (variant == KERNEL_VARIANT_SCALAR) {
+        return WFVOpenCL::createKernel(f_variant, variant_kernel_name, num_dimensions, -1, module, targetData, module->getContext(), &err, NULL,
+                                       options.optimizationLevel, options.unsafeMath, false, NULL, NULL);
+    }
+
+    // a variant that is not vectorized is slower than the generic wrapper
+    llvm::Function* f_variant_SIMD = NULL;
+    llvm::Function* f_wrapper = WFVOpenCL::createKernel(f_variant, variant_kernel_name, num_dimensions, simd_dim, module, targetData, module->getContext(), &err, &f_variant_SIMD,
+                                                        options.optimizationLevel, options.unsafeMath, (variant & KERNEL_VARIANT_ALIGNED) != 0, NULL, NULL);
+    return f_variant_SIMD ? f_wrapper : NULL;
+#endif
+}
+
+// Generates the wrapper of kernel 'f' inside 'module': inlining,
+// optimization, vectorization, barrier elimination and optimization of the
+// wrapper. Returns NULL if kernel generation failed. The stages are
+// recorded in 'report' unless it is NULL. The wrappers of the variants of
+// the kernel (see KernelVariant) that were generated are returned in
+// 'variant_wrappers', the generic one is the returned wrapper.
+static llvm::Function* generateKernel(llvm::Function* f, const std::string& kernel_name, llvm::Module* module, llvm::TargetData* targetData,
+                                      const CompilerOptions& options, unsigned& num_dimensions, int& simd_dim, cl_int* errcode_ret,
+                                      WFVOpenCL::CompileReport* report, WFVOpenCL::VectorizationInfo* vectorization,
+                                      llvm::Function* variant_wrappers[NUM_KERNEL_VARIANTS])
+{
+    for (cl_uint i=0; i<NUM_KERNEL_VARIANTS; ++i) variant_wrappers[i] = NULL;
 
     // optimize kernel // TODO: not necessary if we optimize wrapper afterwards
-    WFVOpenCL::inlineFunctionCalls(f, program->targetData);
+    WFVOpenCL::beginCompileStage(report, f);
+    WFVOpenCL::inlineFunctionCalls(f, targetData);
+    WFVOpenCL::endCompileStage(report, "inlining", f);
     // Optimize
     // This is essential, we have to get rid of allocas etc.
     // Unfortunately, for packetization enabled, loop rotate has to be disabled (otherwise, Mandelbrot breaks).
+    WFVOpenCL::beginCompileStage(report, f);
 #ifdef WFVOPENCL_NO_WFV
-    WFVOpenCL::optimizeFunction(f); // enable all optimizations
+    WFVOpenCL::optimizeFunction(f, false, false, options.optimizationLevel); // enable all optimizations
 #else
-    WFVOpenCL::optimizeFunction(f, false, true); // enable LICM, disable loop rotate
+    WFVOpenCL::optimizeFunction(f, false, true, options.optimizationLevel); // enable LICM, disable loop rotate
 #endif
+    if (options.unsafeMath) WFVOpenCL::relaxFloatingPointMath(f);
+    WFVOpenCL::endCompileStage(report, "optimization", f);
 
     WFVOPENCL_DEBUG( WFVOpenCL::writeFunctionToFile(f, "debug_kernel_orig.ll"); );
     WFVOPENCL_DEBUG( WFVOpenCL::writeModuleToFile(module, "debug_kernel_orig.mod.ll"); );
@@ -470,52 +891,234 @@ clCreateKernel(cl_program      program,
     LLVMContext& context = module->getContext();
 
     // determine number of dimensions required by kernel
-    const unsigned num_dimensions = WFVOpenCL::determineNumDimensionsUsed(f);
-
-
+    num_dimensions = WFVOpenCL::determineNumDimensionsUsed(f);
+
+    // The variants are generated from copies of the optimized kernel,
+    // kernel generation modifies it. Aligned buffers only make a difference
+    // for vectorized code (aligned vector loads and stores), the absence of
+    // aliasing only if there are at least two buffers. Without
+    // vectorization, the generic wrapper already is scalar code.
+    const unsigned num_buffers = getNumBufferArguments(f);
+    llvm::Function* variant_kernels[NUM_KERNEL_VARIANTS];
+    for (cl_uint i=0; i<NUM_KERNEL_VARIANTS; ++i) {
+        variant_kernels[i] = NULL;
+        if (i == KERNEL_VARIANT_GENERIC) continue;
 #ifdef WFVOPENCL_NO_WFV
-
-    const int simd_dim = -1;
-    llvm::Function* f_wrapper = WFVOpenCL::createKernel(f, kernel_name, num_dimensions, simd_dim, module, program->targetData, context, errcode_ret, NULL);
-    if (!f_wrapper) {
-        errs() << "ERROR: kernel generation failed!\n";
-        return NULL;
+        if (i & (KERNEL_VARIANT_ALIGNED | KERNEL_VARIANT_SCALAR)) continue;
+#endif
+        if (i != KERNEL_VARIANT_SCALAR && num_buffers == 0) continue;
+        if ((i & KERNEL_VARIANT_NOALIAS) && num_buffers < 2) continue;
+        variant_kernels[i] = llvm::CloneFunction(f);
+        variant_kernels[i]->setName(f->getNameStr() + "_" + getVariantName(i));
+        module->getFunctionList().push_back(variant_kernels[i]);
     }
 
-    _cl_kernel* kernel = new _cl_kernel(program->context, program, f, f_wrapper);
-    kernel->set_num_dimensions(num_dimensions);
-
+#ifdef WFVOPENCL_NO_WFV
+    simd_dim = -1;
+    llvm::Function* f_wrapper = WFVOpenCL::createKernel(f, kernel_name, num_dimensions, simd_dim, module, targetData, context, errcode_ret, NULL, options.optimizationLevel, options.unsafeMath, false, report, vectorization);
 #else
-
     // determine best dimension for packetization
-    const int simd_dim = WFVOpenCL::getBestSimdDim(f, num_dimensions);
+    simd_dim = WFVOpenCL::getBestSimdDim(f, num_dimensions);
 
+    // Buffers are not guaranteed to be aligned to the SIMD width
+    // (CL_MEM_USE_HOST_PTR), so the generic version does not assume it.
     llvm::Function* f_SIMD = NULL;
-    llvm::Function* f_wrapper = WFVOpenCL::createKernel(f, kernel_name, num_dimensions, simd_dim, module, program->targetData, context, errcode_ret, &f_SIMD);
+    llvm::Function* f_wrapper = WFVOpenCL::createKernel(f, kernel_name, num_dimensions, simd_dim, module, targetData, context, errcode_ret, &f_SIMD, options.optimizationLevel, options.unsafeMath, false, report, vectorization);
+    if (!f_SIMD) simd_dim = -1; // vectorization did not work
+#endif
+
     if (!f_wrapper) {
         errs() << "ERROR: kernel generation failed!\n";
         return NULL;
     }
-    _cl_kernel* kernel;
-    if (f_SIMD) {
-        // vectorization was successful
-        kernel = new _cl_kernel(program->context, program, f, f_wrapper, f_SIMD);
-        kernel->set_num_dimensions(num_dimensions);
-        kernel->set_best_simd_dim(simd_dim);
+    variant_wrappers[KERNEL_VARIANT_GENERIC] = f_wrapper;
+
+    for (cl_uint i=1; i<NUM_KERNEL_VARIANTS; ++i) {
+        if (!variant_kernels[i]) continue;
+#ifndef WFVOPENCL_NO_WFV
+        if (simd_dim < 0) continue; // the packetizer would fail again, the generic wrapper is scalar
+#endif
+        WFVOpenCL::beginCompileStage(report, variant_kernels[i]);
+        variant_wrappers[i] = generateKernelVariant(variant_kernels[i], i, kernel_name, module, targetData, options, num_dimensions, simd_dim);
+        WFVOpenCL::endCompileStage(report, getVariantName(i) + " variant", variant_wrappers[i] ? variant_wrappers[i] : variant_kernels[i]);
     }
-    else {
-        // vectorization did not work
-        kernel = new _cl_kernel(program->context, program, f, f_wrapper);
-        kernel->set_num_dimensions(num_dimensions);
+    return f_wrapper;
+}
+
+// Generation of one kernel in a module that only contains the kernel and
+// the functions it calls (see WFVOpenCL::extractFunction()). Each module
+// lives in its own LLVMContext, so several kernels can be generated at the
+// same time (only their packetization is serialized, see
+// WFVOpenCL::packetizeKernelFunction()). The result is the bitcode of the
+// module of the kernel, which contains its final wrapper.
+struct KernelGenerationJob {
+    size_t index; // of the kernel in the list passed to createKernels()
+    std::string kernel_name;
+    std::string kernelBitcode; // input
+    std::string bitcode; // output
+    std::vector<std::string> info;
+    bool success;
+    WFVOpenCL::CompileReport report; // only if WFVOpenCL::getCompileReportPath() is set
+    WFVOpenCL::VectorizationInfo vectorization;
+};
+
+static void runKernelGenerationJob(const CompilerOptions& options, KernelGenerationJob& job) {
+    job.success = false;
+
+    llvm::LLVMContext context;
+    llvm::OwningPtr<llvm::MemoryBuffer> buffer(llvm::MemoryBuffer::getMemBufferCopy(job.kernelBitcode, job.kernel_name));
+    std::string errorMessage;
+    llvm::Module* module = llvm::ParseBitcodeFile(buffer.get(), context, &errorMessage);
+    if (!module) {
+        errs() << "ERROR: could not copy kernel '" << job.kernel_name << "': " << errorMessage << "\n";
+        return;
     }
-    assert(kernel);
 
+    // before doing anything, replace function names generated by clc
+    WFVOpenCL::fixFunctionNames(module);
+    WFVOpenCL::linkBuiltinLibrary(module, WFVOpenCL::getSimdWidth());
+
+    llvm::TargetData targetData(module);
+    llvm::Function* f = module->getFunction("__OpenCL_" + job.kernel_name + "_kernel");
+    assert (f);
+
+    unsigned num_dimensions;
+    int simd_dim;
+    cl_int err = CL_SUCCESS;
+    WFVOpenCL::CompileReport* report = WFVOpenCL::getCompileReportPath() ? &job.report : NULL;
+    llvm::Function* variant_wrappers[NUM_KERNEL_VARIANTS];
+    llvm::Function* f_wrapper = generateKernel(f, job.kernel_name, module, &targetData, options, num_dimensions, simd_dim, &err, report, &job.vectorization, variant_wrappers);
+    if (f_wrapper) {
+        // the original kernel and its vectorized version are not needed anymore
+        std::vector<llvm::Function*> wrappers;
+        for (cl_uint i=0; i<NUM_KERNEL_VARIANTS; ++i) {
+            if (variant_wrappers[i]) wrappers.push_back(variant_wrappers[i]);
+        }
+        llvm::Module* wrapperModule = WFVOpenCL::extractFunctions(module, wrappers);
+        llvm::raw_string_ostream os(job.bitcode);
+        llvm::WriteBitcodeToFile(wrapperModule, os);
+        os.flush();
+        delete wrapperModule;
+
+        getKernelInfo(variant_wrappers, num_dimensions, simd_dim, job.vectorization, job.info);
+        job.success = true;
+    }
+
+    delete module;
+}
+
+// Creates the kernels with the given names. Kernels that were not generated
+// before are generated in parallel, each in a module of its own. The
+// program module is not modified.
+static cl_int createKernels(_cl_program* program, const std::vector<std::string>& kernel_names, std::vector<_cl_kernel*>& kernels) {
+    llvm::Module* module = program->module;
+    assert (module);
+
+    std::vector<llvm::Function*> functions(kernel_names.size());
+    for (size_t i=0, e=kernel_names.size(); i<e; ++i) {
+        functions[i] = WFVOpenCL::getFunction("__OpenCL_" + kernel_names[i] + "_kernel", module);
+        if (!functions[i]) return CL_INVALID_KERNEL_NAME;
+    }
+
+    WFVOPENCL_DEBUG( WFVOpenCL::writeModuleToFile(module, "debug_kernel_orig_noopt.mod.ll"); );
+
+    // A kernel that was generated for this program before (by this or an
+    // earlier run, or before the program binary was created) only has to be
+    // compiled to native code again.
+    kernels.assign(kernel_names.size(), NULL);
+    std::vector<KernelGenerationJob> jobs;
+    for (size_t i=0, e=kernel_names.size(); i<e; ++i) {
+        std::map<std::string, std::vector<std::string> >::const_iterator it =
+            program->generatedKernels.find(kernel_names[i]);
+        if (it != program->generatedKernels.end()) {
+            kernels[i] = createKernelFromInfo(program, functions[i], kernel_names[i], it->second);
+        }
+        if (!kernels[i]) kernels[i] = createKernelFromCache(program, functions[i], kernel_names[i]);
+        if (kernels[i]) continue;
+        // bodies released already, or the kernel exists but is unusable
+        if (functions[i]->isDeclaration() || program->kernelModules.count(kernel_names[i])) continue;
+
+        jobs.push_back(KernelGenerationJob());
+        KernelGenerationJob& job = jobs.back();
+        job.index = i;
+        job.kernel_name = kernel_names[i];
+
+        llvm::Module* kernelModule = WFVOpenCL::extractFunction(module, functions[i]);
+        llvm::raw_string_ostream os(job.kernelBitcode);
+        llvm::WriteBitcodeToFile(kernelModule, os);
+        os.flush();
+        delete kernelModule;
+    }
+
+    if (!jobs.empty()) {
+        const int num_jobs = (int)jobs.size();
+#ifdef WFVOPENCL_USE_OPENMP
+        const bool parallel = num_jobs > 1 && WFVOpenCL::startMultithreadedLLVM();
+#   pragma omp parallel for shared(jobs) schedule(dynamic) if(parallel)
 #endif
+        for (int j=0; j<num_jobs; ++j) {
+            runKernelGenerationJob(program->compilerOptions, jobs[j]);
+        }
 
-    if (!kernel->get_compiled_function()) { *errcode_ret = CL_INVALID_PROGRAM_EXECUTABLE; return NULL; }
+        for (int j=0; j<num_jobs; ++j) {
+            KernelGenerationJob& job = jobs[j];
+            if (!job.success) continue;
 
-    *errcode_ret = CL_SUCCESS;
-    return kernel;
+            llvm::OwningPtr<llvm::MemoryBuffer> buffer(llvm::MemoryBuffer::getMemBufferCopy(job.bitcode, job.kernel_name));
+            std::string errorMessage;
+            llvm::Module* mod = llvm::ParseBitcodeFile(buffer.get(), module->getContext(), &errorMessage);
+            if (!mod) {
+                errs() << "ERROR: could not load generated kernel '" << job.kernel_name << "': " << errorMessage << "\n";
+                continue;
+            }
+
+            storeKernelInCache(program, job.kernel_name, mod, job.info);
+            addKernelModule(program, job.kernel_name, mod);
+            program->generatedKernels[job.kernel_name] = job.info;
+            program->binaryUpToDate = false;
+            program->buildLog += printVectorizationInfo(job.kernel_name, job.vectorization) + "\n";
+            // native code generation is reported on the first execution
+            if (WFVOpenCL::getCompileReportPath()) emitCompileReport(program, job.kernel_name, job.report);
+            kernels[job.index] = createKernelFromInfo(program, functions[job.index], job.kernel_name, job.info);
+        }
+    }
+
+    // native code is generated on first execution of each kernel
+    cl_int err = CL_SUCCESS;
+    for (size_t i=0, e=kernels.size(); i<e && err == CL_SUCCESS; ++i) {
+        if (!kernels[i]) err = CL_INVALID_PROGRAM_EXECUTABLE;
+    }
+    if (err != CL_SUCCESS) {
+        for (size_t i=0, e=kernels.size(); i<e; ++i) delete kernels[i];
+        kernels.clear();
+    }
+    return err;
+}
+
+// -> compile bitcode of function from .bc file to native code
+// -> store void* in _cl_kernel object
+WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_kernel CL_API_CALL
+clCreateKernel(cl_program      program,
+               const char *    kernel_name,
+               cl_int *        errcode_ret)
+{
+    WFVOPENCL_DEBUG ( outs() << "ENTERED clCreateKernel!\n"; );
+    if (!program) { if (errcode_ret) *errcode_ret = CL_INVALID_PROGRAM; return NULL; }
+    finishProgramBuild(program);
+    if (!program->module) {
+        if (errcode_ret != NULL) {
+            *errcode_ret = CL_INVALID_PROGRAM_EXECUTABLE;
+        }
+        return NULL;
+    }
+    if (!kernel_name) { if (errcode_ret) *errcode_ret = CL_INVALID_VALUE; return NULL; }
+    WFVOPENCL_DEBUG( outs() << "\nclCreateKernel(" << program->module->getModuleIdentifier() << ", " << kernel_name << ")\n"; );
+
+    const std::vector<std::string> kernel_names(1, kernel_name);
+    std::vector<_cl_kernel*> kernels;
+    const cl_int err = createKernels(program, kernel_names, kernels);
+    if (errcode_ret) *errcode_ret = err;
+    return err == CL_SUCCESS ? kernels[0] : NULL;
 }
 
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
@@ -525,7 +1128,20 @@ clCreateKernelsInProgram(cl_program     program,
                          cl_uint *      num_kernels_ret)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clCreateKernelsInProgram!\n"; );
-    assert (false && "NOT IMPLEMENTED!");
+    if (!program) return CL_INVALID_PROGRAM;
+    finishProgramBuild(program);
+    if (!program->module) return CL_INVALID_PROGRAM_EXECUTABLE;
+
+    const std::vector<std::string>& kernel_names = program->kernelNames;
+    if (num_kernels_ret) *num_kernels_ret = (cl_uint)kernel_names.size();
+    if (!kernels) return CL_SUCCESS;
+    if (num_kernels < kernel_names.size()) return CL_INVALID_VALUE;
+
+    std::vector<_cl_kernel*> created;
+    const cl_int err = createKernels(program, kernel_names, created);
+    if (err != CL_SUCCESS) return err;
+
+    std::copy(created.begin(), created.end(), kernels);
     return CL_SUCCESS;
 }
 
@@ -533,7 +1149,8 @@ WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
 clRetainKernel(cl_kernel    kernel)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clRetainKernel!\n"; );
-    assert (false && "NOT IMPLEMENTED!");
+    if (!kernel) return CL_INVALID_KERNEL;
+    kernel->retain();
     return CL_SUCCESS;
 }
 
@@ -541,8 +1158,8 @@ WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
 clReleaseKernel(cl_kernel   kernel)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clReleaseKernel!\n"; );
-    _cl_kernel* ptr = (_cl_kernel*)kernel;
-    delete ptr;
+    if (!kernel) return CL_INVALID_KERNEL;
+    if (kernel->release()) delete kernel;
     return CL_SUCCESS;
 }
 
@@ -561,6 +1178,17 @@ clSetKernelArg(cl_kernel    kernel,
     return CL_SUCCESS;
 }
 
+static cl_int writeKernelInfo(const void* value, const size_t size,
+                              const size_t param_value_size, void* param_value, size_t* param_value_size_ret)
+{
+    if (param_value) {
+        if (param_value_size < size) return CL_INVALID_VALUE;
+        memcpy(param_value, value, size);
+    }
+    if (param_value_size_ret) *param_value_size_ret = size;
+    return CL_SUCCESS;
+}
+
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
 clGetKernelInfo(cl_kernel       kernel,
                 cl_kernel_info  param_name,
@@ -569,8 +1197,51 @@ clGetKernelInfo(cl_kernel       kernel,
                 size_t *        param_value_size_ret)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clGetKernelInfo!\n"; );
-    assert (false && "NOT IMPLEMENTED!");
-    return CL_SUCCESS;
+    if (!kernel) return CL_INVALID_KERNEL;
+    const WFVOpenCL::VectorizationInfo& vectorization = kernel->get_vectorization_info();
+    switch (param_name) {
+        case CL_KERNEL_FUNCTION_NAME: {
+            const std::string& name = kernel->get_kernel_name();
+            return writeKernelInfo(name.c_str(), name.size()+1, param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_KERNEL_NUM_ARGS: {
+            const cl_uint num_args = kernel->get_num_args();
+            return writeKernelInfo(&num_args, sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_KERNEL_REFERENCE_COUNT: {
+            const cl_uint count = kernel->get_reference_count();
+            return writeKernelInfo(&count, sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_KERNEL_CONTEXT: {
+            const cl_context context = kernel->get_context();
+            return writeKernelInfo(&context, sizeof(cl_context), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_KERNEL_PROGRAM: {
+            const cl_program program = kernel->get_program();
+            return writeKernelInfo(&program, sizeof(cl_program), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_KERNEL_VECTORIZED_WFV: {
+            const cl_bool vectorized = vectorization.simdDim >= 0 ? CL_TRUE : CL_FALSE;
+            return writeKernelInfo(&vectorized, sizeof(cl_bool), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_KERNEL_SIMD_DIMENSION_WFV: {
+            const cl_int dim = vectorization.simdDim;
+            return writeKernelInfo(&dim, sizeof(cl_int), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_KERNEL_NUM_UNIFORM_VALUES_WFV:
+            return writeKernelInfo(&vectorization.numUniformValues, sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        case CL_KERNEL_NUM_VARYING_VALUES_WFV:
+            return writeKernelInfo(&vectorization.numVaryingValues, sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        case CL_KERNEL_NUM_GATHERS_WFV:
+            return writeKernelInfo(&vectorization.numGathers, sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        case CL_KERNEL_NUM_SCATTERS_WFV:
+            return writeKernelInfo(&vectorization.numScatters, sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        case CL_KERNEL_VECTORIZATION_LOG_WFV: {
+            const std::string log = printVectorizationInfo(kernel->get_kernel_name(), vectorization);
+            return writeKernelInfo(log.c_str(), log.size()+1, param_value_size, param_value, param_value_size_ret);
+        }
+        default: return CL_INVALID_VALUE;
+    }
 }
 
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
@@ -590,13 +1261,85 @@ clGetKernelWorkGroupInfo(cl_kernel                  kernel,
             break; // type conversion slightly hacked (should use param_value_size) ;)
         }
         case CL_KERNEL_COMPILE_WORK_GROUP_SIZE: {
-            assert (false && "NOT IMPLEMENTED");
+            // (0, 0, 0) if the kernel has no reqd_work_group_size attribute
+            if (param_value && param_value_size < 3*sizeof(size_t)) return CL_INVALID_VALUE;
+            if (param_value) {
+                const cl_uint* sizes = kernel->get_compile_work_group_size();
+                for (unsigned i=0; i<3; ++i) ((size_t*)param_value)[i] = sizes[i];
+            }
+            if (param_value_size_ret) *param_value_size_ret = 3*sizeof(size_t);
             break;
         }
         case CL_KERNEL_LOCAL_MEM_SIZE: {
             *(cl_ulong*)param_value = 0; // FIXME ?
             break;
         }
+        case CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE: {
+            // groups should consist of whole SIMD packets
+            if (param_value && param_value_size < sizeof(size_t)) return CL_INVALID_VALUE;
+#ifdef WFVOPENCL_NO_WFV
+            if (param_value) *(size_t*)param_value = 1;
+#else
+            if (param_value) *(size_t*)param_value = WFVOpenCL::getSimdWidth();
+#endif
+            if (param_value_size_ret) *param_value_size_ret = sizeof(size_t);
+            break;
+        }
+        default: return CL_INVALID_VALUE;
+    }
+    return CL_SUCCESS;
+}
+
+/**
+ * cl_wfv_kernel_exec_info extension
+ */
+
+WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
+clSetKernelExecInfoWFV(cl_kernel                kernel,
+                       cl_kernel_exec_info_wfv  param_name,
+                       size_t                   param_value_size,
+                       const void *             param_value)
+{
+    WFVOPENCL_DEBUG ( outs() << "ENTERED clSetKernelExecInfoWFV!\n"; );
+    if (!kernel) return CL_INVALID_KERNEL;
+    if (!param_value) return CL_INVALID_VALUE;
+    switch (param_name) {
+        case CL_KERNEL_EXEC_GROUP_ORDER_WFV: {
+            if (param_value_size != sizeof(cl_uint)) return CL_INVALID_VALUE;
+            const cl_uint order = *(const cl_uint*)param_value;
+            if (order != CL_GROUP_ORDER_AUTO_WFV &&
+                    order != CL_GROUP_ORDER_ROW_MAJOR_WFV &&
+                    order != CL_GROUP_ORDER_MORTON_WFV &&
+                    order != CL_GROUP_ORDER_HILBERT_WFV)
+            {
+                return CL_INVALID_VALUE;
+            }
+            kernel->set_group_order(order);
+            break;
+        }
+        case CL_KERNEL_EXEC_AFFINITY_WFV: {
+            if (param_value_size != sizeof(cl_bool)) return CL_INVALID_VALUE;
+            kernel->set_affinity(*(const cl_bool*)param_value != CL_FALSE);
+            break;
+        }
+        case CL_KERNEL_EXEC_SPECIALIZED_ARGS_WFV: {
+            // only arguments passed by value can be specialized,
+            // an empty list disables specialization
+            if (param_value_size % sizeof(cl_uint) != 0) return CL_INVALID_VALUE;
+            const cl_uint* indices = (const cl_uint*)param_value;
+            const std::vector<cl_uint> arg_indices(indices, indices + param_value_size / sizeof(cl_uint));
+            for (std::vector<cl_uint>::const_iterator it=arg_indices.begin(), E=arg_indices.end(); it!=E; ++it) {
+                if (*it >= kernel->get_num_args()) return CL_INVALID_ARG_INDEX;
+                if (!kernel->arg_is_private(*it)) return CL_INVALID_ARG_INDEX;
+            }
+            kernel->set_specialized_args(arg_indices);
+            break;
+        }
+        case CL_KERNEL_EXEC_SPECIALIZE_LOCAL_SIZE_WFV: {
+            if (param_value_size != sizeof(cl_bool)) return CL_INVALID_VALUE;
+            kernel->set_specialize_local_size(*(const cl_bool*)param_value != CL_FALSE);
+            break;
+        }
         default: return CL_INVALID_VALUE;
     }
     return CL_SUCCESS;
@@ -629,6 +1372,18 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
     if (num_dimensions < 1 || num_dimensions > WFVOPENCL_MAX_NUM_DIMENSIONS) return CL_INVALID_WORK_DIMENSION;
     if (!kernel->get_compiled_function()) return CL_INVALID_PROGRAM_EXECUTABLE; // ?
     if (!global_work_size) return CL_INVALID_GLOBAL_WORK_SIZE;
+
+    // A kernel with a required work group size is only executed with that
+    // size (it is used if the application does not specify one).
+    size_t compile_work_group_size[3];
+    if (kernel->has_compile_work_group_size()) {
+        const cl_uint* sizes = kernel->get_compile_work_group_size();
+        for (unsigned i=0; i<3; ++i) compile_work_group_size[i] = sizes[i];
+        if (!local_work_size) local_work_size = compile_work_group_size;
+        for (unsigned i=0; i<num_dimensions && i<3; ++i) {
+            if (local_work_size[i] != compile_work_group_size[i]) return CL_INVALID_WORK_GROUP_SIZE;
+        }
+    }
     if (!local_work_size) return CL_INVALID_WORK_GROUP_SIZE;
     if (global_work_offset) return CL_INVALID_GLOBAL_OFFSET; // see specification p.109
     if (!event_wait_list && num_events_in_wait_list > 0) return CL_INVALID_EVENT_WAIT_LIST;
@@ -656,18 +1411,13 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
         const size_t simd_dim_work_size = local_work_size[kernel->get_best_simd_dim()];
         outs() << "  best simd dim: " << kernel->get_best_simd_dim() << "\n";
         outs() << "  local_work_size of dim: " << simd_dim_work_size << "\n";
-        const bool dividableBySimdWidth = simd_dim_work_size % WFVOPENCL_SIMD_WIDTH == 0;
-        if (!dividableBySimdWidth) {
-            errs() << "WARNING: group size of simd dimension not dividable by simdWidth\n";
-            //return CL_INVALID_WORK_GROUP_SIZE;
-        }
     );
 #endif
 
     switch (num_dimensions) {
-        case 1: return executeRangeKernel1D(kernel, global_work_size[0], local_work_size[0]);
-        case 2: return executeRangeKernel2D(kernel, global_work_size,    local_work_size);
-        case 3: return executeRangeKernel3D(kernel, global_work_size,    local_work_size);
+        case 1: return executeRangeKernel1D(kernel, command_queue->device, global_work_size[0], local_work_size[0]);
+        case 2: return executeRangeKernel2D(kernel, command_queue->device, global_work_size,    local_work_size);
+        case 3: return executeRangeKernel3D(kernel, command_queue->device, global_work_size,    local_work_size);
         default: return executeRangeKernelND(kernel, num_dimensions, global_work_size, local_work_size);
     }
 
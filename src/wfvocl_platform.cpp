@@ -10,8 +10,29 @@
  * chapter 4 of the OpenCL 1.1 specification.
  */
 
+#include <algorithm> // std::find
+
 #include "wfvocl.h"
 
+/**
+ * The root device owns all cores of the host, or the first
+ * WFVOPENCL_NUM_CORES of them if this was supplied by the build script.
+ * It is created when it is requested first, possibly by several threads.
+ */
+_cl_device_id* getRootDevice() {
+    static _cl_device_id* root = NULL;
+    WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_ROOT_DEVICE);
+    if (!root) {
+        const unsigned num_host_cores = WFVOpenCL::getNumHostCores();
+        const unsigned num_cores = (WFVOPENCL_NUM_CORES > 0 && WFVOPENCL_NUM_CORES < num_host_cores) ?
+            WFVOPENCL_NUM_CORES : num_host_cores;
+        std::vector<unsigned> cores;
+        for (unsigned i=0; i<num_cores; ++i) cores.push_back(WFVOpenCL::getWorkerCore(i));
+        root = new _cl_device_id(NULL, cores, std::vector<cl_device_partition_property_ext>());
+    }
+    return root;
+}
+
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
 clGetPlatformIDs(cl_uint          num_entries,
                  cl_platform_id * platforms,
@@ -21,6 +42,10 @@ clGetPlatformIDs(cl_uint          num_entries,
     if (!platforms && !num_platforms) return CL_INVALID_VALUE;
     if (platforms && num_entries == 0) return CL_INVALID_VALUE;
 
+    // The instruction set and SIMD width of the generated code are chosen
+    // for the host, query it before compilation threads may be started.
+    WFVOpenCL::getSimdWidth();
+
     if (platforms) platforms[0] = &static_platform;
     if (num_platforms) *num_platforms = 1;
 
@@ -108,12 +133,61 @@ clGetDeviceIDs(cl_platform_id   platform,
     if (devices && num_entries < 1) return CL_INVALID_VALUE;
     if (!devices && !num_devices) return CL_INVALID_VALUE;
     if (devices) {
-        *(_cl_device_id**)devices = &static_device;
+        *(_cl_device_id**)devices = getRootDevice();
     }
     if (num_devices) *num_devices = 1; //new cl_uint(1);
     return CL_SUCCESS;
 }
 
+/**
+ * Helpers for clGetDeviceInfo: copy the value of the queried parameter to the
+ * memory supplied by the application and/or return its size.
+ */
+static cl_int writeDeviceInfo(const void* value, const size_t size,
+                              const size_t param_value_size, void* param_value, size_t* param_value_size_ret)
+{
+    if (param_value) {
+        if (param_value_size < size) {
+            errs() << "ERROR: buffer too small: " << (unsigned)param_value_size << " < " << (unsigned)size << "\n";
+            return CL_INVALID_VALUE;
+        }
+        memcpy(param_value, value, size);
+    }
+    if (param_value_size_ret) *param_value_size_ret = size;
+    return CL_SUCCESS;
+}
+template<typename T>
+static inline cl_int writeDeviceInfo(const T value, const size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+    return writeDeviceInfo(&value, sizeof(T), param_value_size, param_value, param_value_size_ret);
+}
+static inline cl_int writeDeviceInfoString(const char* value, const size_t param_value_size, void* param_value, size_t* param_value_size_ret) {
+    return writeDeviceInfo(value, strlen(value)+1, param_value_size, param_value, param_value_size_ret);
+}
+
+/**
+ * Helper for clGetDeviceInfo: number of elements of the given type that fit
+ * into a SIMD register of the host. Without AVX2, AVX only has 256 bit
+ * registers for floating point operations.
+ */
+static cl_uint getNativeVectorWidth(const size_t elementSize, const bool isFloatingPoint) {
+    const size_t registerSize = isFloatingPoint && WFVOpenCL::hostSupportsAVX() ? 32 : 16;
+    return (cl_uint)(registerSize / elementSize);
+}
+
+/**
+ * Helper for clGetDeviceInfo: preferred vector width of the given type.
+ * With whole-function vectorization, the packetizer already fills the SIMD
+ * registers with WFVOpenCL::getSimdWidth() work items, so kernels should use
+ * scalar types. Otherwise, vector types are the only way to use SIMD.
+ */
+static cl_uint getPreferredVectorWidth(const size_t elementSize, const bool isFloatingPoint) {
+#ifdef WFVOPENCL_NO_WFV
+    return getNativeVectorWidth(elementSize, isFloatingPoint);
+#else
+    return 1;
+#endif
+}
+
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
 clGetDeviceInfo(cl_device_id    device,
                 cl_device_info  param_name,
@@ -124,291 +198,395 @@ clGetDeviceInfo(cl_device_id    device,
     WFVOPENCL_DEBUG ( outs() << "ENTERED clGetDeviceInfo!\n"; );
     if (!device) return CL_INVALID_DEVICE;
 
-    // TODO: move into _cl_device_id, this here is the wrong place !!
+    // All values that depend on the host are queried only once (see
+    // WFVOpenCL::getHostInfo()). Sub-devices share everything except for
+    // the number of compute units.
     switch (param_name) {
-        case CL_DEVICE_TYPE: {
-            if (param_value_size < sizeof(cl_device_type)) return CL_INVALID_VALUE;
-            if (param_value) *(cl_device_type*)param_value = CL_DEVICE_TYPE_CPU;
-            if (param_value_size_ret) *param_value_size_ret = sizeof(cl_device_type);
-            break;
-        }
+        case CL_DEVICE_TYPE:
+            return writeDeviceInfo<cl_device_type>(CL_DEVICE_TYPE_CPU, param_value_size, param_value, param_value_size_ret);
         case CL_DEVICE_VENDOR_ID: {
-            if (param_value_size < sizeof(cl_uint)) return CL_INVALID_VALUE;
-            if (param_value) *(cl_uint*)param_value = 0; // should be some "unique device vendor identifier"
-            if (param_value_size_ret) *param_value_size_ret = sizeof(cl_uint);
-            break;
-        }
-        case CL_DEVICE_MAX_COMPUTE_UNITS: {
-            if (param_value_size < sizeof(cl_uint)) return CL_INVALID_VALUE;
-
-#ifdef WFVOPENCL_NO_WFV
-            if (param_value) *(cl_uint*)param_value = WFVOPENCL_NUM_CORES;
-#else
-    #ifndef WFVOPENCL_USE_OPENMP
-            if (param_value) *(cl_uint*)param_value = WFVOPENCL_SIMD_WIDTH;
-    #else
-            if (param_value) *(cl_uint*)param_value = WFVOPENCL_NUM_CORES*WFVOPENCL_SIMD_WIDTH; // ? :P
-    #endif
-#endif
-
-            if (param_value_size_ret) *param_value_size_ret = sizeof(cl_uint);
-            break;
-        }
-        case CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS: {
-            if (param_value_size < sizeof(cl_uint)) return CL_INVALID_VALUE;
-            if (param_value) *(cl_uint*)param_value = WFVOPENCL_MAX_NUM_DIMENSIONS;
-            if (param_value_size_ret) *param_value_size_ret = sizeof(cl_uint);
-            break;
-        }
+            // PCI vendor id of the manufacturer of the processor
+            const char* vendor = WFVOpenCL::getHostProcessorVendor();
+            const cl_uint id = !strcmp(vendor, "GenuineIntel") ? 0x8086 :
+                !strcmp(vendor, "AuthenticAMD") ? 0x1022 : 0;
+            return writeDeviceInfo<cl_uint>(id, param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_DEVICE_MAX_COMPUTE_UNITS:
+            // one compute unit per worker, this is also the unit in which
+            // sub-devices are created (clCreateSubDevicesEXT)
+            return writeDeviceInfo<cl_uint>(device->get_num_workers(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS:
+            return writeDeviceInfo<cl_uint>(WFVOPENCL_MAX_NUM_DIMENSIONS, param_value_size, param_value, param_value_size_ret);
         case CL_DEVICE_MAX_WORK_ITEM_SIZES: {
-            if (param_value_size < sizeof(size_t)) return CL_INVALID_VALUE;
-            if (param_value) {
-                for (unsigned i=0; i<WFVOPENCL_MAX_NUM_DIMENSIONS; ++i) {
-                    ((size_t*)param_value)[i] = WFVOpenCL::getDeviceMaxMemAllocSize(); // TODO: FIXME
-                }
-            }
-            if (param_value_size_ret) *param_value_size_ret = sizeof(size_t)*WFVOPENCL_MAX_NUM_DIMENSIONS;
-            break;
-        }
-        case CL_DEVICE_MAX_WORK_GROUP_SIZE: {
-            if (param_value_size < sizeof(size_t)) return CL_INVALID_VALUE;
-            if (param_value) *(size_t*)param_value = WFVOpenCL::getDeviceMaxMemAllocSize(); // FIXME
-            if (param_value_size_ret) *param_value_size_ret = sizeof(size_t*);
-            break;
-        }
-        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MAX_CLOCK_FREQUENCY: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_ADDRESS_BITS: {
-            if (param_value_size < sizeof(cl_uint)) return CL_INVALID_VALUE;
-            if (param_value) *(cl_uint*)param_value = WFVOPENCL_ADDRESS_BITS;
-            if (param_value_size_ret) *param_value_size_ret = sizeof(cl_uint);
-            break;
-        }
-        case CL_DEVICE_MAX_MEM_ALLOC_SIZE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_IMAGE_SUPPORT: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MAX_READ_IMAGE_ARGS: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MAX_WRITE_IMAGE_ARGS: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_IMAGE2D_MAX_WIDTH: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_IMAGE2D_MAX_HEIGHT: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_IMAGE3D_MAX_WIDTH: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_IMAGE3D_MAX_HEIGHT: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_IMAGE3D_MAX_DEPTH: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MAX_SAMPLERS: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MAX_PARAMETER_SIZE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MEM_BASE_ADDR_ALIGN: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MIN_DATA_TYPE_ALIGN_SIZE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_SINGLE_FP_CONFIG: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_GLOBAL_MEM_CACHE_TYPE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
+            size_t sizes[WFVOPENCL_MAX_NUM_DIMENSIONS];
+            for (unsigned i=0; i<WFVOPENCL_MAX_NUM_DIMENSIONS; ++i) sizes[i] = WFVOPENCL_MAX_WORK_GROUP_SIZE;
+            return writeDeviceInfo(sizes, sizeof(sizes), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_DEVICE_MAX_WORK_GROUP_SIZE:
+            return writeDeviceInfo<size_t>(WFVOPENCL_MAX_WORK_GROUP_SIZE, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR:
+            return writeDeviceInfo<cl_uint>(getPreferredVectorWidth(sizeof(cl_char), false), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT:
+            return writeDeviceInfo<cl_uint>(getPreferredVectorWidth(sizeof(cl_short), false), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT:
+            return writeDeviceInfo<cl_uint>(getPreferredVectorWidth(sizeof(cl_int), false), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG:
+            return writeDeviceInfo<cl_uint>(getPreferredVectorWidth(sizeof(cl_long), false), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT:
+            return writeDeviceInfo<cl_uint>(getPreferredVectorWidth(sizeof(cl_float), true), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE:
+            return writeDeviceInfo<cl_uint>(getPreferredVectorWidth(sizeof(cl_double), true), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF:
+        case CL_DEVICE_NATIVE_VECTOR_WIDTH_HALF:
+            return writeDeviceInfo<cl_uint>(0, param_value_size, param_value, param_value_size_ret); // no cl_khr_fp16
+        case CL_DEVICE_NATIVE_VECTOR_WIDTH_CHAR:
+            return writeDeviceInfo<cl_uint>(getNativeVectorWidth(sizeof(cl_char), false), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_NATIVE_VECTOR_WIDTH_SHORT:
+            return writeDeviceInfo<cl_uint>(getNativeVectorWidth(sizeof(cl_short), false), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_NATIVE_VECTOR_WIDTH_INT:
+            return writeDeviceInfo<cl_uint>(getNativeVectorWidth(sizeof(cl_int), false), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_NATIVE_VECTOR_WIDTH_LONG:
+            return writeDeviceInfo<cl_uint>(getNativeVectorWidth(sizeof(cl_long), false), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT:
+            return writeDeviceInfo<cl_uint>(getNativeVectorWidth(sizeof(cl_float), true), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_NATIVE_VECTOR_WIDTH_DOUBLE:
+            return writeDeviceInfo<cl_uint>(getNativeVectorWidth(sizeof(cl_double), true), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_MAX_CLOCK_FREQUENCY:
+            return writeDeviceInfo<cl_uint>(WFVOpenCL::getHostClockFrequency(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_ADDRESS_BITS:
+            return writeDeviceInfo<cl_uint>(WFVOPENCL_ADDRESS_BITS, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_MAX_MEM_ALLOC_SIZE:
+            return writeDeviceInfo<cl_ulong>(WFVOpenCL::getDeviceMaxMemAllocSize(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_IMAGE_SUPPORT:
+            return writeDeviceInfo<cl_bool>(CL_FALSE, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_MAX_READ_IMAGE_ARGS:
+        case CL_DEVICE_MAX_WRITE_IMAGE_ARGS:
+        case CL_DEVICE_MAX_SAMPLERS:
+            return writeDeviceInfo<cl_uint>(0, param_value_size, param_value, param_value_size_ret); // no image support
+        case CL_DEVICE_IMAGE2D_MAX_WIDTH:
+        case CL_DEVICE_IMAGE2D_MAX_HEIGHT:
+        case CL_DEVICE_IMAGE3D_MAX_WIDTH:
+        case CL_DEVICE_IMAGE3D_MAX_HEIGHT:
+        case CL_DEVICE_IMAGE3D_MAX_DEPTH:
+            return writeDeviceInfo<size_t>(0, param_value_size, param_value, param_value_size_ret); // no image support
+        case CL_DEVICE_MAX_PARAMETER_SIZE:
+            return writeDeviceInfo<size_t>(1024, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_MEM_BASE_ADDR_ALIGN:
+            // in bits, see WFVOpenCL::allocateBufferMemory(); applications that
+            // align host pointers (CL_MEM_USE_HOST_PTR) to it execute the
+            // aligned variants of the kernels
+            return writeDeviceInfo<cl_uint>(WFVOPENCL_BUFFER_ALIGNMENT*8, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_MIN_DATA_TYPE_ALIGN_SIZE:
+            return writeDeviceInfo<cl_uint>(16, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_SINGLE_FP_CONFIG:
+            return writeDeviceInfo<cl_device_fp_config>(CL_FP_DENORM | CL_FP_INF_NAN | CL_FP_ROUND_TO_NEAREST,
+                                                        param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_DOUBLE_FP_CONFIG:
+            // cl_amd_fp64
+            return writeDeviceInfo<cl_device_fp_config>(CL_FP_DENORM | CL_FP_INF_NAN | CL_FP_ROUND_TO_NEAREST |
+                                                        CL_FP_ROUND_TO_ZERO | CL_FP_ROUND_TO_INF,
+                                                        param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_GLOBAL_MEM_CACHE_TYPE:
+            return writeDeviceInfo<cl_device_mem_cache_type>(CL_READ_WRITE_CACHE, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE:
+            return writeDeviceInfo<cl_uint>(WFVOpenCL::getHostCacheLineSize(), param_value_size, param_value, param_value_size_ret);
         case CL_DEVICE_GLOBAL_MEM_CACHE_SIZE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_GLOBAL_MEM_SIZE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_MAX_CONSTANT_ARGS: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_LOCAL_MEM_TYPE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_LOCAL_MEM_SIZE: {
-            // local memory == global memory for cpu
-            // TODO: make sure size*maxNumThreads(*simdWidth?) is really available on host ;)
-            if (param_value_size < sizeof(unsigned long long)) return CL_INVALID_VALUE;
-            if (param_value) *(unsigned long long*)param_value = WFVOpenCL::getDeviceMaxMemAllocSize(); // FIXME: use own function
-            if (param_value_size_ret) *param_value_size_ret = sizeof(unsigned long long);
-            break;
-        }
-        case CL_DEVICE_ERROR_CORRECTION_SUPPORT: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_PROFILING_TIMER_RESOLUTION: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_ENDIAN_LITTLE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_AVAILABLE: {
-            if (param_value_size < sizeof(cl_bool)) return CL_INVALID_VALUE;
-            if (param_value) *(cl_bool*)param_value = true; // TODO: check if cpu supports SSE
-            if (param_value_size_ret) *param_value_size_ret = sizeof(cl_bool);
-            break;
-        }
-        case CL_DEVICE_COMPILER_AVAILABLE: {
-            if (param_value_size < sizeof(cl_bool)) return CL_INVALID_VALUE;
-            if (param_value) *(cl_bool*)param_value = true; // TODO: check if clang/llvm is available
-            if (param_value_size_ret) *param_value_size_ret = sizeof(cl_bool);
-            break;
-        }
-        case CL_DEVICE_EXECUTION_CAPABILITIES: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_QUEUE_PROPERTIES: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_PLATFORM: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
-            return CL_INVALID_VALUE;
-        }
-        case CL_DEVICE_NAME: {
-            if (param_value_size < sizeof(char*)) return CL_INVALID_VALUE;
-            if (param_value) strcpy((char*)param_value, "Some SSE CPU"); // TODO: should  return sth like "Intel(R) Core(TM)2 Quad CPU Q9550 @ 2.83 GHz"
-            if (param_value_size_ret) *param_value_size_ret = sizeof(char*);
-            break;
+            // last level cache
+            const cl_ulong l3 = WFVOpenCL::getHostCacheSize(3);
+            const cl_ulong size = l3 ? l3 : WFVOpenCL::getHostCacheSize(2);
+            return writeDeviceInfo<cl_ulong>(size, param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_DEVICE_GLOBAL_MEM_SIZE:
+            return writeDeviceInfo<cl_ulong>(WFVOpenCL::getHostMemorySize(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE:
+            // constant memory is ordinary host memory
+            return writeDeviceInfo<cl_ulong>(WFVOpenCL::getDeviceMaxMemAllocSize(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_MAX_CONSTANT_ARGS:
+            return writeDeviceInfo<cl_uint>(8, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_LOCAL_MEM_TYPE:
+            return writeDeviceInfo<cl_device_local_mem_type>(CL_GLOBAL, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_LOCAL_MEM_SIZE:
+            // Local memory is allocated from ordinary host memory for each
+            // thread, so it is as large as any other allocation. Reporting
+            // the cache size instead would shrink the tiles of applications
+            // and make clSetKernelArg fail for larger __local buffers.
+            return writeDeviceInfo<cl_ulong>(WFVOpenCL::getDeviceMaxMemAllocSize(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_ERROR_CORRECTION_SUPPORT:
+            return writeDeviceInfo<cl_bool>(CL_FALSE, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_HOST_UNIFIED_MEMORY:
+            return writeDeviceInfo<cl_bool>(CL_TRUE, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PROFILING_TIMER_RESOLUTION:
+            return writeDeviceInfo<size_t>(1, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_ENDIAN_LITTLE:
+            return writeDeviceInfo<cl_bool>(CL_TRUE, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_AVAILABLE:
+            return writeDeviceInfo<cl_bool>(CL_TRUE, param_value_size, param_value, param_value_size_ret); // TODO: check if cpu supports SSE
+        case CL_DEVICE_COMPILER_AVAILABLE:
+            return writeDeviceInfo<cl_bool>(CL_TRUE, param_value_size, param_value, param_value_size_ret); // TODO: check if clang/llvm is available
+        case CL_DEVICE_EXECUTION_CAPABILITIES:
+            return writeDeviceInfo<cl_device_exec_capabilities>(CL_EXEC_KERNEL, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_QUEUE_PROPERTIES:
+            // commands are executed in order and without profiling information
+            return writeDeviceInfo<cl_command_queue_properties>(0, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PLATFORM:
+            return writeDeviceInfo<cl_platform_id>(&static_platform, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_NAME:
+            return writeDeviceInfoString(WFVOpenCL::getHostProcessorName(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_VENDOR:
+            return writeDeviceInfoString(WFVOpenCL::getHostProcessorVendor(), param_value_size, param_value, param_value_size_ret);
+        case CL_DRIVER_VERSION:
+            return writeDeviceInfoString(WFVOPENCL_VERSION_STRING, param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PROFILE:
+            return writeDeviceInfoString("FULL_PROFILE", param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_VERSION:
+            return writeDeviceInfoString("1.0", param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_OPENCL_C_VERSION:
+            return writeDeviceInfoString("OpenCL C 1.0", param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_EXTENSIONS:
+            return writeDeviceInfoString(WFVOPENCL_EXTENSIONS, param_value_size, param_value, param_value_size_ret);
+
+        case CL_DEVICE_PARENT_DEVICE_EXT:
+            return writeDeviceInfo<cl_device_id>(device->get_parent(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PARTITION_TYPES_EXT: {
+            const cl_device_partition_property_ext types[] = {
+                CL_DEVICE_PARTITION_EQUALLY_EXT,
+                CL_DEVICE_PARTITION_BY_COUNTS_EXT,
+                CL_DEVICE_PARTITION_BY_NAMES_EXT,
+                CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN_EXT,
+                CL_PROPERTIES_LIST_END_EXT
+            };
+            return writeDeviceInfo(types, sizeof(types), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_DEVICE_AFFINITY_DOMAINS_EXT: {
+            std::vector<cl_device_partition_property_ext> domains;
+            domains.push_back(CL_AFFINITY_DOMAIN_NUMA_EXT);
+            for (unsigned level=1; level<=4; ++level) {
+                if (WFVOpenCL::getCacheDomainOfCore(device->get_worker_core(0), level) == -1) continue;
+                domains.push_back(CL_AFFINITY_DOMAIN_L1_CACHE_EXT + level - 1);
+            }
+            domains.push_back(CL_AFFINITY_DOMAIN_NEXT_FISSIONABLE_EXT);
+            domains.push_back(CL_PROPERTIES_LIST_END_EXT);
+            return writeDeviceInfo(&domains[0], domains.size() * sizeof(cl_device_partition_property_ext),
+                                   param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_DEVICE_REFERENCE_COUNT_EXT:
+            return writeDeviceInfo<cl_uint>(device->get_reference_count(), param_value_size, param_value, param_value_size_ret);
+        case CL_DEVICE_PARTITION_STYLE_EXT: {
+            // empty list (only the terminator) for the root device
+            std::vector<cl_device_partition_property_ext> style = device->get_partition_style();
+            if (style.empty()) style.push_back(CL_PROPERTIES_LIST_END_EXT);
+            return writeDeviceInfo(&style[0], style.size() * sizeof(cl_device_partition_property_ext),
+                                   param_value_size, param_value, param_value_size_ret);
         }
-        case CL_DEVICE_VENDOR: {
-            if (param_value_size < sizeof(char*)) return CL_INVALID_VALUE;
-            if (param_value) strcpy((char*)param_value, "Some CPU manufacturer"); // TODO: should be sth. like "Advanced Micro Devices, Inc."
-            if (param_value_size_ret) *param_value_size_ret = sizeof(char*);
+
+        default: {
+            errs() << "ERROR: unknown param_name found: " << param_name << "!\n";
             return CL_INVALID_VALUE;
         }
-        case CL_DRIVER_VERSION: {
-            if (param_value_size < sizeof(char*)) return CL_INVALID_VALUE;
-            if (param_value) strcpy((char*)param_value, WFVOPENCL_VERSION_STRING);
-            if (param_value_size_ret) *param_value_size_ret = sizeof(char*);
-            break;
+    }
+}
+
+/* Device fission APIs (cl_ext_device_fission) */
+
+/**
+ * Helper for partitionDevice: splits the cores of 'device' into groups of
+ * cores that share the given affinity domain. The order of the cores of the
+ * device is preserved. Returns false if the domain can not be determined.
+ */
+static bool partitionByAffinityDomain(const _cl_device_id* device,
+                                      const cl_device_partition_property_ext domain,
+                                      std::vector<std::vector<unsigned> >& partitions)
+{
+    std::vector<int> keys;
+    partitions.clear();
+    for (cl_uint i=0; i<device->get_num_workers(); ++i) {
+        const unsigned core = device->get_worker_core(i);
+        int key = -1;
+        switch (domain) {
+            case CL_AFFINITY_DOMAIN_NUMA_EXT: key = (int)WFVOpenCL::getNumaNodeOfCore(core); break;
+            case CL_AFFINITY_DOMAIN_L1_CACHE_EXT: key = WFVOpenCL::getCacheDomainOfCore(core, 1); break;
+            case CL_AFFINITY_DOMAIN_L2_CACHE_EXT: key = WFVOpenCL::getCacheDomainOfCore(core, 2); break;
+            case CL_AFFINITY_DOMAIN_L3_CACHE_EXT: key = WFVOpenCL::getCacheDomainOfCore(core, 3); break;
+            case CL_AFFINITY_DOMAIN_L4_CACHE_EXT: key = WFVOpenCL::getCacheDomainOfCore(core, 4); break;
+            default: break;
+        }
+        if (key == -1) return false;
+        const unsigned j = (unsigned)(std::find(keys.begin(), keys.end(), key) - keys.begin());
+        if (j == keys.size()) {
+            keys.push_back(key);
+            partitions.push_back(std::vector<unsigned>());
+        }
+        partitions[j].push_back(core);
+    }
+    return true;
+}
+
+/**
+ * Helper for clCreateSubDevicesEXT: determines the cores of each sub-device
+ * and the partition style that is reported for them.
+ */
+static cl_int partitionDevice(const _cl_device_id* device,
+                              const cl_device_partition_property_ext* properties,
+                              std::vector<std::vector<unsigned> >& partitions,
+                              std::vector<cl_device_partition_property_ext>& style)
+{
+    const std::vector<unsigned>& cores = device->get_cores();
+    const cl_uint num_workers = device->get_num_workers();
+
+    switch (properties[0]) {
+        case CL_DEVICE_PARTITION_EQUALLY_EXT: {
+            const cl_device_partition_property_ext n = properties[1];
+            if (n == 0) return CL_INVALID_PARTITION_COUNT_EXT;
+            if (properties[2] != CL_PROPERTIES_LIST_END_EXT) return CL_INVALID_VALUE;
+            if (n > num_workers) return CL_DEVICE_PARTITION_FAILED_EXT;
+            // as many sub-devices with n compute units each as possible
+            for (cl_uint i=0; i+n<=num_workers; i+=(cl_uint)n) {
+                partitions.push_back(std::vector<unsigned>(cores.begin()+i, cores.begin()+i+n));
+            }
+            style.assign(properties, properties+3);
+            return CL_SUCCESS;
+        }
+        case CL_DEVICE_PARTITION_BY_COUNTS_EXT: {
+            cl_uint i = 1;
+            cl_device_partition_property_ext sum = 0;
+            for ( ; properties[i] != CL_PARTITION_BY_COUNTS_LIST_END_EXT; ++i) {
+                sum += properties[i];
+                if (sum > num_workers) return CL_INVALID_PARTITION_COUNT_EXT;
+                const cl_uint first = (cl_uint)(sum - properties[i]);
+                partitions.push_back(std::vector<unsigned>(cores.begin()+first, cores.begin()+(cl_uint)sum));
+            }
+            if (partitions.empty()) return CL_INVALID_PARTITION_COUNT_EXT;
+            if (properties[i+1] != CL_PROPERTIES_LIST_END_EXT) return CL_INVALID_VALUE;
+            style.assign(properties, properties+i+2);
+            return CL_SUCCESS;
+        }
+        case CL_DEVICE_PARTITION_BY_NAMES_EXT: {
+            // The names are the numbers of the logical processors of the host,
+            // they all have to belong to the device. The sub-device keeps the
+            // worker order of its parent.
+            std::vector<bool> selected(num_workers, false);
+            cl_uint i = 1;
+            for ( ; properties[i] != CL_PARTITION_BY_NAMES_LIST_END_EXT; ++i) {
+                const unsigned w = (unsigned)(std::find(cores.begin(), cores.end(), (unsigned)properties[i]) - cores.begin());
+                if (w == num_workers || selected[w]) return CL_INVALID_PARTITION_NAME_EXT;
+                selected[w] = true;
+            }
+            if (i == 1) return CL_INVALID_PARTITION_COUNT_EXT;
+            if (properties[i+1] != CL_PROPERTIES_LIST_END_EXT) return CL_INVALID_VALUE;
+            partitions.push_back(std::vector<unsigned>());
+            for (cl_uint w=0; w<num_workers; ++w) {
+                if (selected[w]) partitions.back().push_back(cores[w]);
+            }
+            style.assign(properties, properties+i+2);
+            return CL_SUCCESS;
+        }
+        case CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN_EXT: {
+            cl_device_partition_property_ext domain = properties[1];
+            if (properties[2] != CL_PROPERTIES_LIST_END_EXT) return CL_INVALID_VALUE;
+            if (domain == CL_AFFINITY_DOMAIN_NEXT_FISSIONABLE_EXT) {
+                // the outermost domain that actually splits the device
+                const cl_device_partition_property_ext domains[] = {
+                    CL_AFFINITY_DOMAIN_NUMA_EXT,
+                    CL_AFFINITY_DOMAIN_L4_CACHE_EXT,
+                    CL_AFFINITY_DOMAIN_L3_CACHE_EXT,
+                    CL_AFFINITY_DOMAIN_L2_CACHE_EXT,
+                    CL_AFFINITY_DOMAIN_L1_CACHE_EXT
+                };
+                for (unsigned d=0; d<sizeof(domains)/sizeof(domains[0]); ++d) {
+                    if (partitionByAffinityDomain(device, domains[d], partitions) && partitions.size() > 1) {
+                        domain = domains[d];
+                        break;
+                    }
+                }
+                if (domain == CL_AFFINITY_DOMAIN_NEXT_FISSIONABLE_EXT) return CL_DEVICE_PARTITION_FAILED_EXT;
+            } else {
+                switch (domain) {
+                    case CL_AFFINITY_DOMAIN_NUMA_EXT:
+                    case CL_AFFINITY_DOMAIN_L1_CACHE_EXT:
+                    case CL_AFFINITY_DOMAIN_L2_CACHE_EXT:
+                    case CL_AFFINITY_DOMAIN_L3_CACHE_EXT:
+                    case CL_AFFINITY_DOMAIN_L4_CACHE_EXT:
+                        break;
+                    default:
+                        return CL_INVALID_VALUE;
+                }
+                if (!partitionByAffinityDomain(device, domain, partitions)) return CL_DEVICE_PARTITION_FAILED_EXT;
+            }
+            // report the domain that was used, even if NEXT_FISSIONABLE was requested
+            style.push_back(CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN_EXT);
+            style.push_back(domain);
+            style.push_back(CL_PROPERTIES_LIST_END_EXT);
+            return CL_SUCCESS;
         }
-        case CL_DEVICE_PROFILE: {
-            errs() << "ERROR: param_name '" << param_name << "' not implemented yet!\n";
-            assert (false && "NOT IMPLEMENTED!");
+        default: {
+            errs() << "ERROR: unknown partition type found: " << (unsigned)properties[0] << "!\n";
             return CL_INVALID_VALUE;
         }
-        case CL_DEVICE_VERSION: {
-            if (param_value_size < sizeof(char*)) return CL_INVALID_VALUE;
-            if (param_value) strcpy((char*)param_value, "1.0");
-            if (param_value_size_ret) *param_value_size_ret = sizeof(char*);
-            break;
-        }
-        case CL_DEVICE_EXTENSIONS: {
-            if (param_value_size < sizeof(char*)) return CL_INVALID_VALUE;
-            if (param_value) strcpy((char*)param_value, WFVOPENCL_EXTENSIONS);
-            if (param_value_size_ret) *param_value_size_ret = sizeof(char*);
-            break;
+    }
+}
+
+/*
+creates an array of sub-devices that each reference a non-intersecting set of
+compute units within in_device.
+*/
+WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
+clCreateSubDevicesEXT(cl_device_id                             in_device,
+                      const cl_device_partition_property_ext * properties,
+                      cl_uint                                  num_entries,
+                      cl_device_id *                           out_devices,
+                      cl_uint *                                num_devices)
+{
+    WFVOPENCL_DEBUG ( outs() << "ENTERED clCreateSubDevicesEXT!\n"; );
+    if (!in_device) return CL_INVALID_DEVICE;
+    if (!properties || properties[0] == CL_PROPERTIES_LIST_END_EXT) return CL_INVALID_VALUE;
+    if (!out_devices && !num_devices) return CL_INVALID_VALUE;
+
+    std::vector<std::vector<unsigned> > partitions;
+    std::vector<cl_device_partition_property_ext> style;
+    const cl_int err = partitionDevice(in_device, properties, partitions, style);
+    if (err != CL_SUCCESS) return err;
+    if (partitions.empty()) return CL_DEVICE_PARTITION_FAILED_EXT;
+    if (out_devices && num_entries < partitions.size()) return CL_INVALID_VALUE;
+
+    WFVOPENCL_DEBUG(
+        for (unsigned i=0; i<partitions.size(); ++i) {
+            outs() << "  sub-device " << i << ":";
+            for (unsigned j=0; j<partitions[i].size(); ++j) outs() << " " << partitions[i][j];
+            outs() << "\n";
         }
+    );
 
-        default: {
-            errs() << "ERROR: unknown param_name found: " << param_name << "!\n";
-            return CL_INVALID_VALUE;
+    if (out_devices) {
+        for (unsigned i=0; i<partitions.size(); ++i) {
+            // each sub-device holds a reference to its parent
+            if (!in_device->is_root()) in_device->retain();
+            out_devices[i] = new _cl_device_id(in_device, partitions[i], style);
         }
     }
+    if (num_devices) *num_devices = (cl_uint)partitions.size();
+
+    return CL_SUCCESS;
+}
 
+WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
+clRetainDeviceEXT(cl_device_id device)
+{
+    WFVOPENCL_DEBUG ( outs() << "ENTERED clRetainDeviceEXT!\n"; );
+    if (!device) return CL_INVALID_DEVICE;
+    if (!device->is_root()) device->retain(); // the root device is never released
+    return CL_SUCCESS;
+}
+
+WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
+clReleaseDeviceEXT(cl_device_id device)
+{
+    WFVOPENCL_DEBUG ( outs() << "ENTERED clReleaseDeviceEXT!\n"; );
+    if (!device) return CL_INVALID_DEVICE;
+    while (device && !device->is_root() && device->release()) {
+        _cl_device_id* parent = device->get_parent();
+        delete device;
+        device = parent;
+    }
     return CL_SUCCESS;
 }
 
@@ -425,8 +603,15 @@ clCreateContext(const cl_context_properties * properties,
     if (errcode_ret != NULL) {
         *errcode_ret = CL_SUCCESS;
     }
+    if (!devices || num_devices == 0) { if (errcode_ret) *errcode_ret = CL_INVALID_VALUE; return NULL; }
+    for (cl_uint i=0; i<num_devices; ++i) {
+        if (!devices[i]) { if (errcode_ret) *errcode_ret = CL_INVALID_DEVICE; return NULL; }
+    }
     _cl_context* c = new _cl_context();
     c->dispatch = &static_dispatch;
+    c->devices.assign(devices, devices + num_devices);
+    // sub-devices must live as long as the context
+    for (cl_uint i=0; i<num_devices; ++i) clRetainDeviceEXT(devices[i]);
     return c;
 }
 
@@ -445,6 +630,7 @@ clCreateContextFromType(const cl_context_properties * properties,
     *errcode_ret = CL_SUCCESS;
     _cl_context* c = new _cl_context();
     c->dispatch = &static_dispatch;
+    c->devices.push_back(getRootDevice());
     return c;
 }
 
@@ -461,6 +647,8 @@ clReleaseContext(cl_context context)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clReleaseContext!\n"; );
     _cl_context* ptr = (_cl_context*)context;
+    if (!ptr) return CL_INVALID_CONTEXT;
+    for (size_t i=0; i<ptr->devices.size(); ++i) clReleaseDeviceEXT(ptr->devices[i]);
     delete ptr;
     return CL_SUCCESS;
 }
@@ -483,11 +671,12 @@ clGetContextInfo(cl_context         context,
             break;
         }
         case CL_CONTEXT_DEVICES: {
+            const size_t size = context->devices.size() * sizeof(_cl_device_id*);
             if (param_value) {
-                if (param_value_size < sizeof(_cl_device_id*)) return CL_INVALID_VALUE;
-                *(_cl_device_id**)param_value = &static_device;
+                if (param_value_size < size) return CL_INVALID_VALUE;
+                memcpy(param_value, &context->devices[0], size);
             } else {
-                if (param_value_size_ret) *param_value_size_ret = sizeof(_cl_device_id*);
+                if (param_value_size_ret) *param_value_size_ret = size;
             }
             break;
         }
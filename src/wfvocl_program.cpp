@@ -10,8 +10,773 @@
  * chapter 5.6 of the OpenCL 1.1 specification.
  */
 
+#include <algorithm> // std::find
+#include <cstdlib> // atoi
+
+#ifdef _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX // windows.h must not define min/max macros
+#   endif
+#include <windows.h> // CreateProcess
+#include <direct.h> // _mkdir, _rmdir
+#else
+#include <cerrno>
+#include <fcntl.h> // fcntl, open
+#include <poll.h> // poll
+#include <pthread.h> // pthread_sigmask
+#include <signal.h> // SIGPIPE
+#include <sys/wait.h> // waitpid
+#include <unistd.h> // fork, pipe, mkdtemp
+#endif
+
 #include "wfvocl.h"
 
+// Creates the command line of clc (terminated by NULL), which compiles
+// 'input' to 'output'. The strings of 'args' must outlive 'argv'.
+static void getFrontendArgv(const std::vector<std::string>& args, const char* output, const char* input, std::vector<const char*>& argv) {
+    argv.clear();
+    argv.push_back("clc");
+    for (std::vector<std::string>::const_iterator it=args.begin(), E=args.end(); it!=E; ++it) {
+        argv.push_back(it->c_str());
+    }
+    argv.push_back("-o");
+    argv.push_back(output);
+    argv.push_back("--msse2");
+    argv.push_back(input);
+    argv.push_back(NULL);
+}
+
+#ifndef _WIN32
+enum PipeFrontendResult {
+    PIPE_FRONTEND_SUCCEEDED,
+    PIPE_FRONTEND_FAILED, // clc was started, but did not produce a module
+    PIPE_FRONTEND_UNAVAILABLE // the pipes or the process could not be created
+};
+
+// Runs clc on the source without touching the file system: the source is
+// written to its standard input, the assembly is read from its standard
+// output and its diagnostics from its standard error.
+static PipeFrontendResult runFrontendWithPipes(const std::string& source, const std::vector<std::string>& args, std::string& output, std::string& diagnostics) {
+    int in[2];
+    int out[2];
+    int err[2];
+    if (pipe(in)) return PIPE_FRONTEND_UNAVAILABLE;
+    if (pipe(out)) {
+        close(in[0]);
+        close(in[1]);
+        return PIPE_FRONTEND_UNAVAILABLE;
+    }
+    if (pipe(err)) {
+        close(in[0]); close(in[1]);
+        close(out[0]); close(out[1]);
+        return PIPE_FRONTEND_UNAVAILABLE;
+    }
+    // do not leak the pipes into processes started by other threads
+    for (unsigned i=0; i<2; ++i) {
+        fcntl(in[i], F_SETFD, FD_CLOEXEC);
+        fcntl(out[i], F_SETFD, FD_CLOEXEC);
+        fcntl(err[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    std::vector<const char*> argv;
+    getFrontendArgv(args, "/dev/stdout", "/dev/stdin", argv);
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        close(in[0]); close(in[1]);
+        close(out[0]); close(out[1]);
+        close(err[0]); close(err[1]);
+        return PIPE_FRONTEND_UNAVAILABLE;
+    }
+    if (pid == 0) {
+        // child: stdin/stdout/stderr are the pipes (dup2 clears FD_CLOEXEC)
+        dup2(in[0], 0);
+        dup2(out[1], 1);
+        dup2(err[1], 2);
+        execvp(argv[0], (char* const*)&argv[0]);
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    close(err[1]);
+
+    // If clc exits before it has read all of the source, writing raises
+    // SIGPIPE, which must not terminate the application.
+    sigset_t sigpipeMask;
+    sigset_t oldMask;
+    sigemptyset(&sigpipeMask);
+    sigaddset(&sigpipeMask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipeMask, &oldMask);
+
+    // Write and read at the same time, clc may produce output before it has
+    // consumed all input. Closed pipes are set to -1 and ignored by poll.
+    int inFd = in[1];
+    int outFd = out[0];
+    int errFd = err[0];
+    fcntl(inFd, F_SETFL, O_NONBLOCK);
+    if (source.empty()) {
+        close(inFd);
+        inFd = -1;
+    }
+    size_t written = 0;
+    bool success = true;
+    bool brokenPipe = false;
+    char buffer[4096];
+    while (outFd >= 0 || errFd >= 0) {
+        struct pollfd fds[3];
+        fds[0].fd = outFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = errFd;
+        fds[1].events = POLLIN;
+        fds[2].fd = inFd;
+        fds[2].events = POLLOUT;
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            success = false;
+            break;
+        }
+
+        if (inFd >= 0 && fds[2].revents) {
+            const ssize_t n = write(inFd, source.data()+written, source.size()-written);
+            if (n > 0) written += n;
+            if ((n < 0 && errno != EAGAIN && errno != EINTR) || written == source.size()) {
+                brokenPipe = n < 0 && errno == EPIPE;
+                close(inFd);
+                inFd = -1;
+            }
+        }
+
+        if (outFd >= 0 && fds[0].revents) {
+            const ssize_t n = read(outFd, buffer, sizeof(buffer));
+            if (n > 0) output.append(buffer, n);
+            else if (n == 0) { // clc closed its output
+                close(outFd);
+                outFd = -1;
+            } else if (errno != EINTR && errno != EAGAIN) {
+                success = false;
+                break;
+            }
+        }
+
+        if (errFd >= 0 && fds[1].revents) {
+            const ssize_t n = read(errFd, buffer, sizeof(buffer));
+            if (n > 0) diagnostics.append(buffer, n);
+            else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+                close(errFd);
+                errFd = -1;
+            }
+        }
+    }
+    if (inFd >= 0) close(inFd);
+    if (outFd >= 0) close(outFd);
+    if (errFd >= 0) close(errFd);
+
+    if (brokenPipe) {
+        // consume the pending signal before it is unblocked again
+        sigset_t pending;
+        sigpending(&pending);
+        if (sigismember(&pending, SIGPIPE)) {
+            int sig;
+            sigwait(&sigpipeMask, &sig);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return PIPE_FRONTEND_FAILED;
+    }
+    success = success && WIFEXITED(status) && WEXITSTATUS(status) == 0 && !output.empty();
+    return success ? PIPE_FRONTEND_SUCCEEDED : PIPE_FRONTEND_FAILED;
+}
+#endif
+
+#ifdef _WIN32
+// Quotes an argument for the command line of a process, such that the
+// runtime of the process splits it into the original argument again.
+static std::string quoteArgument(const char* arg) {
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (const char* c=arg; *c; ++c) {
+        if (*c == '\\') {
+            ++backslashes;
+            continue;
+        }
+        // backslashes are only special in front of a quote
+        quoted.append(*c == '"' ? 2*backslashes + 1 : backslashes, '\\');
+        backslashes = 0;
+        quoted += *c;
+    }
+    quoted.append(2*backslashes, '\\');
+    quoted += '"';
+    return quoted;
+}
+#endif
+
+// Runs clc with the given command line and writes its standard error to
+// 'logFileName'. No shell is involved, so the arguments (e.g. -D options of
+// the application) reach clc unchanged. Returns true if clc succeeded.
+static bool runFrontendProcess(const std::vector<const char*>& argv, const std::string& logFileName) {
+#ifdef _WIN32
+    std::string commandLine;
+    for (size_t i=0; argv[i]; ++i) {
+        if (i > 0) commandLine += ' ';
+        commandLine += quoteArgument(argv[i]);
+    }
+    std::vector<char> commandLineBuffer(commandLine.begin(), commandLine.end());
+    commandLineBuffer.push_back('\0');
+
+    SECURITY_ATTRIBUTES security;
+    security.nLength = sizeof(security);
+    security.lpSecurityDescriptor = NULL;
+    security.bInheritHandle = TRUE;
+    HANDLE log = CreateFileA(logFileName.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &security,
+                             CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (log == INVALID_HANDLE_VALUE) return false;
+
+    STARTUPINFOA startupInfo;
+    ZeroMemory(&startupInfo, sizeof(startupInfo));
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    startupInfo.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    startupInfo.hStdError = log;
+    PROCESS_INFORMATION processInfo;
+    const BOOL created = CreateProcessA(NULL, &commandLineBuffer[0], NULL, NULL, TRUE, 0, NULL, NULL,
+                                        &startupInfo, &processInfo);
+    CloseHandle(log);
+    if (!created) return false;
+
+    WaitForSingleObject(processInfo.hProcess, INFINITE);
+    DWORD exitCode = 1;
+    GetExitCodeProcess(processInfo.hProcess, &exitCode);
+    CloseHandle(processInfo.hProcess);
+    CloseHandle(processInfo.hThread);
+    return exitCode == 0;
+#else
+    const pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        // child: stderr is the log file
+        const int log = open(logFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (log >= 0) dup2(log, 2);
+        execvp(argv[0], (char* const*)&argv[0]);
+        _exit(127);
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+// Runs clc on files in a directory that only we can access (for systems
+// where clc can not use pipes). Unlike names from tmpnam in a shared
+// directory, this can not collide with other processes.
+static bool runFrontendWithFiles(const std::string& source, const std::vector<std::string>& args, std::string& output, std::string& diagnostics) {
+#ifdef _WIN32
+    char dirName[L_tmpnam];
+    if (!tmpnam(dirName) || _mkdir(dirName)) return false;
+#else
+    std::string dirTemplate = P_tmpdir;
+    dirTemplate += "/wfvoclXXXXXX";
+    std::vector<char> dirBuffer(dirTemplate.begin(), dirTemplate.end());
+    dirBuffer.push_back('\0');
+    const char* dirName = mkdtemp(&dirBuffer[0]);
+    if (!dirName) return false;
+#endif
+    const std::string sourceFileName = std::string(dirName) + "/program.cl";
+    const std::string outputFileName = std::string(dirName) + "/program.ll";
+    const std::string logFileName = std::string(dirName) + "/program.log";
+
+    std::ofstream sourceFile(sourceFileName.c_str());
+    sourceFile << source;
+    sourceFile.close();
+
+    bool success = false;
+    if (!sourceFile.fail()) {
+        std::vector<const char*> argv;
+        getFrontendArgv(args, outputFileName.c_str(), sourceFileName.c_str(), argv);
+        if (runFrontendProcess(argv, logFileName)) {
+            std::ifstream outputFile(outputFileName.c_str(), std::ios::in | std::ios::binary);
+            std::stringstream sstr;
+            sstr << outputFile.rdbuf();
+            output = sstr.str();
+            success = !output.empty();
+        }
+        std::ifstream logFile(logFileName.c_str(), std::ios::in | std::ios::binary);
+        std::stringstream sstr;
+        sstr << logFile.rdbuf();
+        diagnostics = sstr.str();
+    }
+
+    remove(sourceFileName.c_str());
+    remove(outputFileName.c_str());
+    remove(logFileName.c_str());
+#ifdef _WIN32
+    _rmdir(dirName);
+#else
+    rmdir(dirName);
+#endif
+    return success;
+}
+
+// Compiles OpenCL C source to LLVM assembly with clc. Files are only used
+// if no pipes could be set up, errors of clc itself are not repeated. The
+// errors and warnings of clc are returned in 'diagnostics'.
+static bool runFrontend(const std::string& source, const std::vector<std::string>& args, std::string& output, std::string& diagnostics) {
+#ifndef _WIN32
+    const PipeFrontendResult result = runFrontendWithPipes(source, args, output, diagnostics);
+    if (result != PIPE_FRONTEND_UNAVAILABLE) return result == PIPE_FRONTEND_SUCCEEDED;
+    WFVOPENCL_DEBUG( outs() << "running clc with pipes failed, using files.\n"; );
+    output.clear();
+    diagnostics.clear();
+#endif
+    return runFrontendWithFiles(source, args, output, diagnostics);
+}
+
+// Parses the options of clBuildProgram(). Preprocessor options are passed to
+// clc, the others control the optimizations and floating point semantics of
+// the generated code. Returns false if an option is unknown or incomplete.
+static bool parseBuildOptions(const char* options, CompilerOptions& result) {
+    result = CompilerOptions();
+    if (!options) return true;
+
+    std::istringstream sstr(options);
+    std::string option;
+    while (sstr >> option) {
+        if (option == "-D" || option == "-I") {
+            std::string value;
+            if (!(sstr >> value)) return false;
+            result.frontendArgs.push_back(option + value);
+        } else if (option.compare(0, 2, "-D") == 0 || option.compare(0, 2, "-I") == 0) {
+            result.frontendArgs.push_back(option);
+        } else if (option.size() == 3 && option.compare(0, 2, "-O") == 0 && option[2] >= '0' && option[2] <= '3') {
+            result.optimizationLevel = option[2] - '0';
+        } else if (option == "-cl-opt-disable") {
+            result.optimizationLevel = 0;
+        } else if (option == "-cl-mad-enable") {
+            result.madEnable = true;
+        } else if (option == "-cl-unsafe-math-optimizations") {
+            result.unsafeMath = true;
+            result.madEnable = true;
+        } else if (option == "-cl-finite-math-only") {
+            result.finiteMath = true;
+        } else if (option == "-cl-fast-relaxed-math") {
+            result.unsafeMath = true;
+            result.finiteMath = true;
+            result.madEnable = true;
+        } else if (option == "-cl-single-precision-constant" ||
+                option == "-cl-denorms-are-zero" ||
+                option == "-cl-no-signed-zeros" ||
+                option == "-w" ||
+                option == "-Werror" ||
+                option.compare(0, 8, "-cl-std=") == 0)
+        {
+            // accepted, no effect on the generated code
+        } else {
+            errs() << "ERROR: unknown build option '" << option << "'!\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Describes the configuration of the driver that influences the generated
+// code. Cache entries and binaries from a different configuration can not
+// be used.
+static std::string getTargetDescription() {
+    std::stringstream sstr;
+    sstr << "WFVOpenCL " << WFVOPENCL_VERSION_STRING;
+#ifdef WFVOPENCL_NO_WFV
+    sstr << " scalar";
+#else
+    // the instruction set depends on the host (see WFVOpenCL::getSimdWidth())
+    sstr << (WFVOpenCL::hostSupportsAVX() ? " avx" : WFVOpenCL::hostSupportsSSE41() ? " sse41" : " sse2");
+    sstr << " simd" << WFVOpenCL::getSimdWidth();
+#endif
+    sstr << " " << WFVOPENCL_LLVM_DATA_LAYOUT_64;
+    return sstr.str();
+}
+
+// Describes everything besides the source that influences the generated
+// code. Cache entries written with a different description are not used.
+// Unlike program binaries, they are also bound to the build of the driver,
+// the version string is not changed for every modification of the code.
+static std::string getCacheDescription(const char* options) {
+    return getTargetDescription() + " build: " + WFVOpenCL::getDriverBuildId() +
+        " options: " + (options ? options : "");
+}
+
+// Collects the names of all kernels defined in the module (clc generates a
+// function "__OpenCL_<name>_kernel" for each of them).
+static void getKernelNames(const llvm::Module* module, std::vector<std::string>& kernel_names) {
+    const std::string prefix = "__OpenCL_";
+    const std::string suffix = "_kernel";
+    for (llvm::Module::const_iterator F=module->begin(), FE=module->end(); F!=FE; ++F) {
+        if (F->isDeclaration()) continue;
+        const std::string name = F->getNameStr();
+        if (name.size() <= prefix.size() + suffix.size()) continue;
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        if (name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+        kernel_names.push_back(name.substr(prefix.size(), name.size() - prefix.size() - suffix.size()));
+    }
+}
+
+// Prepares a module that was compiled from source or loaded from a binary
+// for code generation on the host.
+static void setProgramModule(_cl_program* program, llvm::Module* mod) {
+    assert (program && mod);
+    WFVOPENCL_DEBUG( WFVOpenCL::writeModuleToFile(mod, "debug_kernel_orig_orig_targetdata.mod.ll"); );
+
+    // TODO: do this here or only after packetization?
+    mod->setDataLayout(WFVOPENCL_LLVM_DATA_LAYOUT_64);
+    // we have to reset the target triple (LLVM does not know amd-opencl)
+    //mod->setTargetTriple("");
+#if defined _WIN32
+    mod->setTargetTriple("x86_64-pc-win32");
+#elif defined __APPLE__
+    mod->setTargetTriple("x86_64-apple-darwin10.0.0");
+#elif defined __linux
+    mod->setTargetTriple("x86_64-unknown-linux-gnu");
+#else
+#   error "unknown platform found, can not assign correct target triple!");
+#endif
+    program->targetData = new TargetData(mod);
+
+    program->module = mod;
+    program->binaryUpToDate = false;
+    getKernelNames(mod, program->kernelNames);
+}
+
+// A build of the program source, possibly running on a background thread.
+// It only works in its own LLVMContext, the resulting module is handed over
+// as bitcode and only loaded into the program by finishProgramBuild().
+struct ProgramBuild {
+    // input
+    std::string source;
+    std::vector<std::string> frontendArgs;
+    std::string cacheKey;
+    std::string cacheDescription;
+    void (CL_CALLBACK * pfn_notify)(cl_program, void*);
+    void* user_data;
+    _cl_program* program;
+    // output
+    bool success;
+    std::string bitcode;
+    std::string log;
+    bool finished; // see WFVOpenCL::finishBackgroundJob()
+};
+
+// -> invoke clc (source/assembly passed through pipes)
+// -> parse assembly
+// -> store bitcode in the build
+static void runProgramBuild(ProgramBuild* build) {
+    assert (build);
+    llvm::LLVMContext context;
+
+    // If the compilation cache is enabled, the module of a program that was
+    // built before is loaded from there instead of invoking clc.
+    llvm::Module* mod = NULL;
+    if (!build->cacheKey.empty()) {
+        std::vector<std::string> info;
+        mod = WFVOpenCL::loadCachedModule(build->cacheKey, build->cacheDescription, info, context);
+    }
+
+    if (!mod) {
+        // compile using clc, its diagnostics are the build log
+        std::string assembly;
+        const bool compiled = runFrontend(build->source, build->frontendArgs, assembly, build->log);
+        if (!build->log.empty()) errs() << build->log;
+        if (!compiled) {
+            errs() << "ERROR: compilation of program source with clc failed!\n";
+            if (build->log.empty()) build->log = "compilation of program source with clc failed\n";
+            return;
+        }
+
+        // assemble and load module
+        llvm::SMDiagnostic asmErr;
+        mod = llvm::ParseAssemblyString(assembly.c_str(), NULL, asmErr, context);
+        if (!mod) {
+            llvm::raw_string_ostream os(build->log);
+            asmErr.Print("clc", os);
+            os.flush();
+            return;
+        }
+
+        if (!build->cacheKey.empty()) {
+            WFVOpenCL::storeCachedModule(build->cacheKey, build->cacheDescription, mod, std::vector<std::string>());
+        }
+    }
+
+    llvm::raw_string_ostream os(build->bitcode);
+    llvm::WriteBitcodeToFile(mod, os);
+    os.flush();
+    delete mod;
+
+    build->success = true;
+}
+
+static void runProgramBuildInBackground(void* data) {
+    ProgramBuild* build = (ProgramBuild*)data;
+    runProgramBuild(build);
+
+    // The build may be finished and deleted by another thread as soon as it
+    // is marked finished.
+    void (CL_CALLBACK * pfn_notify)(cl_program, void*) = build->pfn_notify;
+    void* user_data = build->user_data;
+    _cl_program* program = build->program;
+    WFVOpenCL::finishBackgroundJob(&build->finished);
+
+    pfn_notify(program, user_data);
+}
+
+// Moves the result of the build into the program. Every access to
+// program->build holds DRIVER_LOCK_PROGRAM_BUILD, so exactly one thread
+// finishes and deletes the build, also if the program is used by several
+// threads (e.g. by the callback of the build).
+cl_int finishProgramBuild(_cl_program* program) {
+    assert (program);
+    WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_PROGRAM_BUILD);
+    ProgramBuild* build = program->build;
+    if (!build) return program->module ? CL_SUCCESS : CL_INVALID_PROGRAM_EXECUTABLE;
+
+    WFVOpenCL::waitForBackgroundJob(&build->finished);
+    program->build = NULL;
+    program->buildLog = build->log;
+
+    llvm::Module* mod = NULL;
+    if (build->success) {
+        OwningPtr<MemoryBuffer> buffer(MemoryBuffer::getMemBufferCopy(build->bitcode, "program"));
+        std::string errorMessage;
+        mod = llvm::ParseBitcodeFile(buffer.get(), llvm::getGlobalContext(), &errorMessage);
+        if (!mod) {
+            errs() << "ERROR: could not load built program: " << errorMessage << "\n";
+            program->buildLog += errorMessage + "\n";
+        }
+    }
+    delete build;
+
+    if (!mod) {
+        program->buildStatus = CL_BUILD_ERROR;
+        return CL_BUILD_PROGRAM_FAILURE;
+    }
+
+    setProgramModule(program, mod);
+    program->buildStatus = CL_BUILD_SUCCESS;
+    return CL_SUCCESS;
+}
+
+/*
+Program binaries are returned in a driver-specific format: a text header that
+identifies the driver configuration and lists the kernels that were generated
+in the program already, followed by the LLVM bitcode of the program. Kernels
+listed in the header only have to be compiled to native code when they are
+created again. Plain LLVM bitcode (e.g. generated by clc ahead of time) is
+accepted as binary as well.
+*/
+#define WFVOPENCL_BINARY_MAGIC "WFVOpenCL binary 1\n"
+
+// Links the wrapper of a generated kernel (and everything it calls) into
+// 'mod', a copy of the program module. Functions and globals that the
+// program defines already are taken from there.
+static bool linkKernelWrapper(llvm::Module* mod, llvm::Module* kernelModule, const std::string& wrapper_name) {
+    llvm::Function* f_wrapper = kernelModule->getFunction(wrapper_name);
+    if (!f_wrapper || f_wrapper->isDeclaration()) return false;
+
+    llvm::Module* wrapperModule = WFVOpenCL::extractFunction(kernelModule, f_wrapper);
+    for (llvm::Module::iterator F=wrapperModule->begin(), FE=wrapperModule->end(); F!=FE; ++F) {
+        if (F->isDeclaration() || F->hasLocalLinkage()) continue;
+        if (mod->getFunction(F->getName())) F->deleteBody();
+    }
+    for (llvm::Module::global_iterator GV=wrapperModule->global_begin(), GVE=wrapperModule->global_end(); GV!=GVE; ++GV) {
+        if (GV->isDeclaration() || GV->hasLocalLinkage()) continue;
+        if (!mod->getNamedGlobal(GV->getName())) continue;
+        GV->setInitializer(NULL);
+        GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    }
+
+    std::string errorMessage;
+    const bool failed = llvm::Linker::LinkModules(mod, wrapperModule, &errorMessage);
+    delete wrapperModule;
+    if (failed) {
+        errs() << "WARNING: could not add kernel wrapper '" << wrapper_name << "' to program binary: " << errorMessage << "\n";
+    }
+    return !failed;
+}
+
+static std::string createProgramBinary(const _cl_program* program) {
+    assert (program && program->module && !program->bodiesReleased);
+
+    // Kernels are generated in modules of their own (see KernelModule),
+    // the binary contains their wrappers in a copy of the program module.
+    llvm::Module* mod = program->module;
+    std::map<std::string, std::vector<std::string> > kernels;
+    for (std::map<std::string, std::vector<std::string> >::const_iterator
+            it=program->generatedKernels.begin(), E=program->generatedKernels.end(); it!=E; ++it)
+    {
+        const std::vector<std::string>& info = it->second;
+        if (info.empty()) continue;
+        const llvm::Function* f_wrapper = program->module->getFunction(info[0]);
+        if (!f_wrapper || f_wrapper->isDeclaration()) {
+            // not loaded with a binary of the program
+            std::map<std::string, KernelModule>::const_iterator kernel = program->kernelModules.find(it->first);
+            if (kernel == program->kernelModules.end()) continue;
+            if (mod == program->module) mod = llvm::CloneModule(program->module);
+            if (!linkKernelWrapper(mod, kernel->second.module, info[0])) continue;
+            // without its variants, the kernel only executes the generic wrapper
+            for (cl_uint i=1; i<NUM_KERNEL_VARIANTS; ++i) {
+                const std::string wrapper_name = getVariantWrapperName(info, i);
+                if (!wrapper_name.empty()) linkKernelWrapper(mod, kernel->second.module, wrapper_name);
+            }
+        }
+        kernels[it->first] = info;
+    }
+
+    std::stringstream sstr;
+    sstr << WFVOPENCL_BINARY_MAGIC;
+    sstr << getTargetDescription() << "\n";
+    sstr << kernels.size() << "\n";
+    for (std::map<std::string, std::vector<std::string> >::const_iterator
+            it=kernels.begin(), E=kernels.end(); it!=E; ++it)
+    {
+        sstr << it->first;
+        for (std::vector<std::string>::const_iterator it2=it->second.begin(), E2=it->second.end(); it2!=E2; ++it2) {
+            sstr << " " << *it2;
+        }
+        sstr << "\n";
+    }
+
+    std::string bitcode;
+    llvm::raw_string_ostream os(bitcode);
+    llvm::WriteBitcodeToFile(mod, os);
+    os.flush();
+    if (mod != program->module) delete mod;
+
+    return sstr.str() + bitcode;
+}
+
+// The binary is serialized once and kept until the program changes, so
+// CL_PROGRAM_BINARY_SIZES and CL_PROGRAM_BINARIES describe the same data.
+static const std::string& getProgramBinary(_cl_program* program) {
+    assert (program && program->module);
+    if (!program->binaryUpToDate) {
+        program->binary = createProgramBinary(program);
+        program->binaryUpToDate = true;
+    }
+    return program->binary;
+}
+
+// Returns NULL if the binary is neither in the format of this driver
+// (configured the same way) nor LLVM bitcode.
+static llvm::Module* parseProgramBinary(const unsigned char* binary, const size_t length,
+                                        std::map<std::string, std::vector<std::string> >& kernels)
+{
+    assert (binary);
+    const char* data = (const char*)binary;
+    size_t bitcodeStart = 0;
+
+    const size_t magicLength = strlen(WFVOPENCL_BINARY_MAGIC);
+    if (length >= magicLength && !memcmp(data, WFVOPENCL_BINARY_MAGIC, magicLength)) {
+        std::istringstream header(std::string(data, length));
+        std::string line;
+        std::getline(header, line); // magic
+
+        if (!std::getline(header, line) || line != getTargetDescription()) {
+            errs() << "ERROR: program binary was generated by a different driver configuration!\n";
+            return NULL;
+        }
+
+        if (!std::getline(header, line)) return NULL;
+        const int num_kernels = atoi(line.c_str());
+        for (int i=0; i<num_kernels; ++i) {
+            if (!std::getline(header, line)) return NULL;
+            std::istringstream fields(line);
+            std::string kernel_name;
+            std::string field;
+            fields >> kernel_name;
+            std::vector<std::string>& info = kernels[kernel_name];
+            while (fields >> field) info.push_back(field);
+        }
+
+        const std::streamoff pos = header.tellg();
+        if (pos < 0) return NULL;
+        bitcodeStart = (size_t)pos;
+    }
+
+    const unsigned char* bitcode = binary + bitcodeStart;
+    if (!llvm::isBitcode(bitcode, binary + length)) {
+        errs() << "ERROR: program binary does not contain LLVM bitcode!\n";
+        return NULL;
+    }
+
+    // copy, the bitcode reader requires an aligned buffer
+    OwningPtr<MemoryBuffer> buffer(MemoryBuffer::getMemBufferCopy(
+            StringRef((const char*)bitcode, length - bitcodeStart), "program binary"));
+
+    std::string errorMessage;
+    llvm::Module* mod = llvm::ParseBitcodeFile(buffer.get(), llvm::getGlobalContext(), &errorMessage);
+    if (!mod) {
+        errs() << "ERROR: could not read program binary: " << errorMessage << "\n";
+        return NULL;
+    }
+    return mod;
+}
+
+// Kernels with a required work group size only compile the version of their
+// wrappers for that size (see _cl_kernel::specialize_on_compile_work_group_size()).
+bool isWrapperCompiled(const _cl_program* program, const std::string& wrapper_name) {
+    assert (program);
+    return program->compiledWrappers.count(wrapper_name) ||
+        program->compiledWrappers.count(getReqdWrapperName(wrapper_name));
+}
+
+// After native code was generated for all kernels of the program, the IR
+// of its functions (original kernels, and generated wrappers and
+// continuations in the modules of the kernels) is not needed anymore. Only
+// the binary of the program is kept for clGetProgramInfo().
+void releaseProgramBodies(_cl_program* program) {
+    assert (program && program->module);
+    if (program->bodiesReleased || program->bodiesRequired) return;
+
+    for (std::vector<std::string>::const_iterator it=program->kernelNames.begin(),
+            E=program->kernelNames.end(); it!=E; ++it)
+    {
+        std::map<std::string, std::vector<std::string> >::const_iterator kernel =
+            program->generatedKernels.find(*it);
+        if (kernel == program->generatedKernels.end()) return;
+        if (kernel->second.empty() || !isWrapperCompiled(program, kernel->second[0])) return;
+    }
+
+    getProgramBinary(program);
+    for (llvm::Module::iterator F=program->module->begin(), FE=program->module->end(); F!=FE; ++F) {
+        if (!F->isDeclaration()) F->deleteBody();
+    }
+    for (std::map<std::string, KernelModule>::iterator it=program->kernelModules.begin(),
+            E=program->kernelModules.end(); it!=E; ++it)
+    {
+        llvm::Module* mod = it->second.module;
+        for (llvm::Module::iterator F=mod->begin(), FE=mod->end(); F!=FE; ++F) {
+            if (!F->isDeclaration()) F->deleteBody();
+        }
+    }
+    program->bodiesReleased = true;
+
+    WFVOPENCL_DEBUG( outs() << "released function bodies of program after compilation of all kernels.\n"; );
+}
+
+static cl_int writeProgramInfo(const void* value, const size_t size,
+                               const size_t param_value_size, void* param_value, size_t* param_value_size_ret)
+{
+    if (param_value) {
+        if (param_value_size < size) return CL_INVALID_VALUE;
+        memcpy(param_value, value, size);
+    }
+    if (param_value_size_ret) *param_value_size_ret = size;
+    return CL_SUCCESS;
+}
+
 /*
 creates a program object for a context, and loads the source code specified by the text strings in
 the strings array into the program object. The devices associated with the program object are the
@@ -31,28 +796,21 @@ clCreateProgramWithSource(cl_context        context,
     }
     _cl_program* p = new _cl_program();
     p->dispatch = &static_dispatch;
+    p->referenceCount = 1;
     p->context = context;
+    p->devices = context->devices;
+    p->buildStatus = CL_BUILD_NONE;
 
-    // create temp filename
-    char* tmpFilename = (char*)malloc(L_tmpnam * sizeof(char));
-    tmpnam(tmpFilename);
-    p->fileName = tmpFilename;
-
-    // write to temp file
-    std::ofstream of(tmpFilename);
-    if (!of.good()) {
-        if (errcode_ret != NULL) {
-            *errcode_ret = CL_OUT_OF_RESOURCES;
-        }
-        return NULL;
+    // the source is kept in memory until the program is built
+    for (cl_uint i=0; i<count; ++i) {
+        if (lengths && lengths[i] > 0) p->source.append(strings[i], lengths[i]);
+        else p->source.append(strings[i]);
     }
-    of << *strings;
-    of.close();
 
     return p;
 }
 
-// -> read binary and store as .cl representation
+// -> parse LLVM bitcode (plain or in the format of clGetProgramInfo(CL_PROGRAM_BINARIES))
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_program CL_API_CALL
 clCreateProgramWithBinary(cl_context                     context,
                           cl_uint                        num_devices,
@@ -63,32 +821,133 @@ clCreateProgramWithBinary(cl_context                     context,
                           cl_int *                       errcode_ret)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clCreateProgramWithBinary!\n"; );
-    assert (false && "NOT IMPLEMENTED!");
-    return NULL;
+    if (!context) { if (errcode_ret) *errcode_ret = CL_INVALID_CONTEXT; return NULL; }
+    if (!device_list || num_devices == 0) { if (errcode_ret) *errcode_ret = CL_INVALID_VALUE; return NULL; }
+    if (!lengths || !binaries) { if (errcode_ret) *errcode_ret = CL_INVALID_VALUE; return NULL; }
+    for (cl_uint i=0; i<num_devices; ++i) {
+        if (std::find(context->devices.begin(), context->devices.end(), device_list[i]) == context->devices.end()) {
+            if (errcode_ret) *errcode_ret = CL_INVALID_DEVICE;
+            return NULL;
+        }
+        if (lengths[i] == 0 || !binaries[i]) {
+            if (errcode_ret) *errcode_ret = CL_INVALID_VALUE;
+            return NULL;
+        }
+    }
+
+    // All devices are (parts of) the host, so one module serves all of them.
+    // The binaries of the other devices are only checked.
+    llvm::Module* mod = NULL;
+    std::map<std::string, std::vector<std::string> > kernels;
+    bool valid = true;
+    for (cl_uint i=0; i<num_devices; ++i) {
+        std::map<std::string, std::vector<std::string> > binaryKernels;
+        llvm::Module* binaryMod = parseProgramBinary(binaries[i], lengths[i], binaryKernels);
+        if (binary_status) binary_status[i] = binaryMod ? CL_SUCCESS : CL_INVALID_BINARY;
+        if (!binaryMod) {
+            valid = false;
+        } else if (!mod) {
+            mod = binaryMod;
+            kernels.swap(binaryKernels);
+        } else {
+            delete binaryMod;
+        }
+    }
+    if (!valid) {
+        delete mod;
+        if (errcode_ret) *errcode_ret = CL_INVALID_BINARY;
+        return NULL;
+    }
+
+    _cl_program* p = new _cl_program();
+    p->dispatch = &static_dispatch;
+    p->referenceCount = 1;
+    p->context = context;
+    p->devices.assign(device_list, device_list+num_devices);
+    p->buildStatus = CL_BUILD_NONE;
+    p->fromBinary = true;
+    p->generatedKernels.swap(kernels);
+    setProgramModule(p, mod);
+
+    if (errcode_ret) *errcode_ret = CL_SUCCESS;
+    return p;
+}
+
+// The report of each kernel is a line of the build log, so applications
+// can query it with clGetProgramBuildInfo(CL_PROGRAM_BUILD_LOG).
+void emitCompileReport(_cl_program* program, const std::string& kernel_name, const WFVOpenCL::CompileReport& report) {
+    assert (program);
+    const std::string json = WFVOpenCL::printCompileReport(kernel_name, report);
+    program->buildLog += json + "\n";
+    WFVOpenCL::writeCompileReport(json);
+}
+
+// Deletes the module of the program and everything generated from it, so
+// the program can be built again.
+static void deleteProgramExecutable(_cl_program* program) {
+    assert (program && program->numKernels == 0);
+    // Kernels are executed before clEnqueueNDRangeKernel() returns, so no
+    // native code is in use anymore once all kernel objects are released.
+    for (std::map<std::string, KernelModule>::iterator it=program->kernelModules.begin(),
+            E=program->kernelModules.end(); it!=E; ++it)
+    {
+        // the engine owns the module, its memory manager the native code
+        if (it->second.engine) delete it->second.engine;
+        else delete it->second.module;
+    }
+    program->kernelModules.clear();
+    program->generatedKernels.clear();
+    program->compiledWrappers.clear();
+    program->kernelNames.clear();
+    delete program->targetData;
+    program->targetData = NULL;
+    delete program->module;
+    program->module = NULL;
+    program->bodiesReleased = false;
+    program->bodiesRequired = false;
+    program->binary.clear();
+    program->binaryUpToDate = false;
+}
+
+void releaseProgram(_cl_program* program) {
+    assert (program && program->referenceCount > 0);
+    if (--program->referenceCount > 0) return;
+
+#ifdef WFVOPENCL_ENABLE_JIT_PROFILING
+    int success = iJIT_NotifyEvent(iJVM_EVENT_TYPE_SHUTDOWN, NULL);
+    if (success != 1) {
+        errs() << "ERROR: termination of profiling failed!\n";
+    }
+#endif
+    {
+        // the background thread may still use the build
+        WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_PROGRAM_BUILD);
+        if (program->build) {
+            WFVOpenCL::waitForBackgroundJob(&program->build->finished);
+            delete program->build;
+            program->build = NULL;
+        }
+    }
+    deleteProgramExecutable(program);
+    delete program;
 }
 
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
 clRetainProgram(cl_program program)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clRetainProgram!\n"; );
-    assert (false && "NOT IMPLEMENTED!");
+    if (!program) return CL_INVALID_PROGRAM;
+    ++program->referenceCount;
     return CL_SUCCESS;
 }
 
+// The program is deleted after the last kernel object created from it.
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
 clReleaseProgram(cl_program program)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clReleaseProgram!\n"; );
-#ifdef WFVOPENCL_ENABLE_JIT_PROFILING
-    int success = iJIT_NotifyEvent(iJVM_EVENT_TYPE_SHUTDOWN, NULL);
-    if (success != 1) {
-        errs() << "ERROR: termination of profiling failed!\n";
-    }
-#endif
-    _cl_program* ptr = (_cl_program*)program;
-    delete ptr->targetData;
-    delete ptr->module;
-    delete ptr;
+    if (!program) return CL_INVALID_PROGRAM;
+    releaseProgram(program);
     return CL_SUCCESS;
 }
 
@@ -100,10 +959,9 @@ for program created using either clCreateProgramWithSource or
 clCreateProgramWithBinary to build the program executable for one or more devices
 associated with program.
 */
-// -> build LLVM module from .cl representation (from createProgramWithSource/Binary)
-// -> invoke clc
-// -> invoke llvm-as
-// -> store module in _cl_program object
+// -> build LLVM module from source (from createProgramWithSource)
+// -> in the background if pfn_notify is given (see runProgramBuild())
+// -> store module in _cl_program object (see finishProgramBuild())
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
 clBuildProgram(cl_program           program,
                cl_uint              num_devices,
@@ -118,45 +976,57 @@ clBuildProgram(cl_program           program,
     if (device_list && num_devices == 0) return CL_INVALID_VALUE;
     if (user_data && !pfn_notify) return CL_INVALID_VALUE;
 
-    // create filename for clc output
-    char clcOutPath[L_tmpnam];
-    tmpnam(clcOutPath);
+    {
+        WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_PROGRAM_BUILD);
+        if (program->build && !WFVOpenCL::isBackgroundJobFinished(&program->build->finished)) return CL_INVALID_OPERATION;
+    }
+    if (program->numKernels > 0) return CL_INVALID_OPERATION;
+    finishProgramBuild(program);
+    program->buildOptions = options ? options : "";
+    if (!parseBuildOptions(options, program->compilerOptions)) return CL_INVALID_BUILD_OPTIONS;
 
-    // compile using clc
-    std::stringstream clcCmd;
-    clcCmd << "clc -o " << clcOutPath << " --msse2 " << program->fileName;
-    system(clcCmd.str().c_str());
+    // programs created from binaries need no compilation
+    if (program->fromBinary) {
+        program->buildStatus = CL_BUILD_SUCCESS;
+        if (pfn_notify) pfn_notify(program, user_data);
+        return CL_SUCCESS;
+    }
 
-    // assemble and load module
-    llvm::SMDiagnostic asmErr;
-    llvm::LLVMContext& context = llvm::getGlobalContext();
-    llvm::Module* mod = llvm::ParseAssemblyFile(clcOutPath, asmErr, context);
+    // a program built before is built again from its source
+    deleteProgramExecutable(program);
 
-    // remove temp outputs
-    remove(clcOutPath);
-    remove(program->fileName);
+    if (WFVOpenCL::getCacheDirectory()) {
+        program->cacheDescription = getCacheDescription(options);
+        program->cacheKey = WFVOpenCL::getCacheKey(program->cacheDescription + "\n" + program->source);
+    }
 
-    // check if module has been loaded
-    if (!mod) return CL_BUILD_PROGRAM_FAILURE;
-    WFVOPENCL_DEBUG( WFVOpenCL::writeModuleToFile(mod, "debug_kernel_orig_orig_targetdata.mod.ll"); );
+    ProgramBuild* build = new ProgramBuild();
+    build->source = program->source;
+    build->frontendArgs = program->compilerOptions.frontendArgs;
+    build->cacheKey = program->cacheKey;
+    build->cacheDescription = program->cacheDescription;
+    build->pfn_notify = pfn_notify;
+    build->user_data = user_data;
+    build->program = program;
+    build->finished = false;
 
-    // TODO: do this here or only after packetization?
-    mod->setDataLayout(WFVOPENCL_LLVM_DATA_LAYOUT_64);
-    // we have to reset the target triple (LLVM does not know amd-opencl)
-    //mod->setTargetTriple("");
-#if defined _WIN32
-    mod->setTargetTriple("x86_64-pc-win32");
-#elif defined __APPLE__
-    mod->setTargetTriple("x86_64-apple-darwin10.0.0");
-#elif defined __linux
-    mod->setTargetTriple("x86_64-unknown-linux-gnu");
-#else
-#   error "unknown platform found, can not assign correct target triple!");
-#endif
-    program->targetData = new TargetData(mod);
+    // With a callback, the application does not have to wait for the build.
+    // The first call that requires the built program waits if necessary.
+    {
+        WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_PROGRAM_BUILD);
+        program->build = build;
+        program->buildStatus = CL_BUILD_IN_PROGRESS;
+        program->buildLog.clear();
+        if (pfn_notify && WFVOpenCL::startBackgroundJob(runProgramBuildInBackground, build)) {
+            return CL_SUCCESS;
+        }
+    }
 
-    program->module = mod;
-    return CL_SUCCESS;
+    runProgramBuild(build);
+    WFVOpenCL::finishBackgroundJob(&build->finished);
+    const cl_int err = finishProgramBuild(program);
+    if (pfn_notify) pfn_notify(program, user_data);
+    return err;
 }
 
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
@@ -175,8 +1045,50 @@ clGetProgramInfo(cl_program         program,
                  size_t *           param_value_size_ret)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clGetProgramInfo!\n"; );
-    assert (false && "NOT IMPLEMENTED!");
-    return CL_SUCCESS;
+    if (!program) return CL_INVALID_PROGRAM;
+
+    switch (param_name) {
+        case CL_PROGRAM_REFERENCE_COUNT: {
+            return writeProgramInfo(&program->referenceCount, sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_PROGRAM_CONTEXT:
+            return writeProgramInfo(&program->context, sizeof(cl_context), param_value_size, param_value, param_value_size_ret);
+        case CL_PROGRAM_NUM_DEVICES: {
+            const cl_uint num_devices = (cl_uint)program->devices.size();
+            return writeProgramInfo(&num_devices, sizeof(cl_uint), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_PROGRAM_DEVICES:
+            return writeProgramInfo(&program->devices[0], program->devices.size()*sizeof(cl_device_id), param_value_size, param_value, param_value_size_ret);
+        case CL_PROGRAM_SOURCE:
+            return writeProgramInfo(program->source.c_str(), program->source.size()+1, param_value_size, param_value, param_value_size_ret);
+        case CL_PROGRAM_BINARY_SIZES: {
+            finishProgramBuild(program);
+            // no binary if the program has not been built yet
+            const size_t size = program->module ? getProgramBinary(program).size() : 0;
+            const std::vector<size_t> sizes(program->devices.size(), size);
+            return writeProgramInfo(&sizes[0], sizes.size()*sizeof(size_t), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_PROGRAM_BINARIES: {
+            // param_value is an array of pointers to memory allocated by the
+            // application, entries that are NULL are skipped
+            const size_t size = program->devices.size()*sizeof(unsigned char*);
+            if (param_value && param_value_size < size) return CL_INVALID_VALUE;
+            if (param_value_size_ret) *param_value_size_ret = size;
+            finishProgramBuild(program);
+            if (!param_value || !program->module) return CL_SUCCESS;
+
+            const std::string& binary = getProgramBinary(program);
+            unsigned char** binaries = (unsigned char**)param_value;
+            for (size_t i=0, e=program->devices.size(); i<e; ++i) {
+                if (binaries[i]) memcpy(binaries[i], binary.data(), binary.size());
+            }
+            return CL_SUCCESS;
+        }
+        default: {
+            errs() << "ERROR: unknown param_name found: " << param_name << "!\n";
+            return CL_INVALID_VALUE;
+        }
+    }
 }
 
 WFVOPENCL_DLLEXPORT CL_API_ENTRY cl_int CL_API_CALL
@@ -188,6 +1100,33 @@ clGetProgramBuildInfo(cl_program            program,
                       size_t *              param_value_size_ret)
 {
     WFVOPENCL_DEBUG ( outs() << "ENTERED clGetProgramBuildInfo!\n"; );
-    assert (false && "NOT IMPLEMENTED!");
-    return CL_SUCCESS;
+    if (!program) return CL_INVALID_PROGRAM;
+    if (std::find(program->devices.begin(), program->devices.end(), device) == program->devices.end()) {
+        return CL_INVALID_DEVICE;
+    }
+
+    // A build that finished in the background is only moved into the program
+    // when the program is used, its result is reported directly. The build
+    // may be finished and deleted by another thread at any time.
+    WFVOpenCL::DriverLockGuard guard(WFVOpenCL::DRIVER_LOCK_PROGRAM_BUILD);
+    const ProgramBuild* build = program->build;
+    const bool finished = build && WFVOpenCL::isBackgroundJobFinished(&build->finished);
+
+    switch (param_name) {
+        case CL_PROGRAM_BUILD_STATUS: {
+            cl_build_status status = program->buildStatus;
+            if (build) status = !finished ? CL_BUILD_IN_PROGRESS : build->success ? CL_BUILD_SUCCESS : CL_BUILD_ERROR;
+            return writeProgramInfo(&status, sizeof(cl_build_status), param_value_size, param_value, param_value_size_ret);
+        }
+        case CL_PROGRAM_BUILD_OPTIONS:
+            return writeProgramInfo(program->buildOptions.c_str(), program->buildOptions.size()+1, param_value_size, param_value, param_value_size_ret);
+        case CL_PROGRAM_BUILD_LOG: {
+            const std::string& log = finished ? build->log : program->buildLog;
+            return writeProgramInfo(log.c_str(), log.size()+1, param_value_size, param_value, param_value_size_ret);
+        }
+        default: {
+            errs() << "ERROR: unknown param_name found: " << param_name << "!\n";
+            return CL_INVALID_VALUE;
+        }
+    }
 }
@@ -0,0 +1,161 @@
+//
+// File:       TestAliasing.cpp
+//
+// Abstract:   Executes a kernel with two different buffers and with the same
+//             buffer bound to both of its arguments. The driver must not
+//             execute the variant of the kernel that assumes that buffers do
+//             not overlap in the second case.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Executes the kernel with 'a' and 'b' (which may be the same buffer).
+bool execute(cl_command_queue commands, cl_kernel kernel, cl_mem a, cl_mem b, const unsigned count) {
+    int err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &a);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &b);
+    err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return false;
+    }
+
+    size_t global = count;
+    size_t local = 16;
+    err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return false;
+    }
+    clFinish(commands);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float dataA[DATA_SIZE];
+    float dataB[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        dataA[i] = rand() / (float)RAND_MAX;
+        dataB[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestAliasing_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestAliasing", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 1;
+    }
+
+    cl_mem a = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, dataA, NULL);
+    cl_mem b = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, dataB, NULL);
+    cl_mem c = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, dataA, NULL);
+    if (!a || !b || !c) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    // disjoint buffers, then the same buffer twice
+    if (!execute(commands, kernel, a, b, count) || !execute(commands, kernel, c, c, count)) return 1;
+
+    std::vector<float> resultsA(count);
+    std::vector<float> resultsB(count);
+    std::vector<float> resultsC(count);
+    err  = clEnqueueReadBuffer(commands, a, CL_TRUE, 0, sizeof(float) * count, &resultsA[0], 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(commands, b, CL_TRUE, 0, sizeof(float) * count, &resultsB[0], 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(commands, c, CL_TRUE, 0, sizeof(float) * count, &resultsC[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output arrays! %d\n", err);
+        return 1;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        const float b = dataB[i] * 2.f;
+        if (resultsA[i] == (dataA[i] + 1.f) + b) ++correct;
+        if (resultsB[i] == b) ++correct;
+        const float c = (dataA[i] + 1.f) * 2.f;
+        if (resultsC[i] == c + c) ++correct;
+    }
+    printf("Computed '%d/%d' correct values!\n", correct, 3*count);
+
+    clReleaseMemObject(a);
+    clReleaseMemObject(b);
+    clReleaseMemObject(c);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    return correct == 3*count ? 0 : 1; // 0 = successful
+}
@@ -0,0 +1,14 @@
+// If 'a' and 'b' are the same buffer, the loads of the last statement have
+// to see the stores before them.
+__kernel void TestAliasing(
+   __global float* a,
+   __global float* b,
+   const unsigned int count)
+{
+	const int i = get_global_id(0);
+	if (i < count) {
+		a[i] = a[i] + 1.f;
+		b[i] = b[i] * 2.f;
+		a[i] = a[i] + b[i];
+	}
+}
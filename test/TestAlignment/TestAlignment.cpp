@@ -0,0 +1,171 @@
+//
+// File:       TestAlignment.cpp
+//
+// Abstract:   Executes a kernel with buffers allocated by the driver (aligned
+//             to CL_DEVICE_MEM_BASE_ADDR_ALIGN) and with host pointers that
+//             are not aligned (CL_MEM_USE_HOST_PTR). The driver has to
+//             execute a variant of the kernel that is valid for both.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Executes the kernel on 'input' and 'output' and returns the number of
+// correct results.
+unsigned execute(cl_command_queue commands, cl_kernel kernel, cl_mem input, cl_mem output,
+                 const float* data, const unsigned count)
+{
+    int err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 0;
+    }
+
+    size_t global = count;
+    size_t local = 16;
+    err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return 0;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count);
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return 0;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        if (results[i] == data[i] * 2.f + 1.f) ++correct;
+    }
+    return correct;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    const unsigned count = DATA_SIZE;
+    // one element more than required, the host pointers start at the second
+    // one and are not aligned
+    std::vector<float> hostInput(count + 1);
+    std::vector<float> hostOutput(count + 1);
+    float* data = &hostInput[1];
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_uint baseAddrAlign = 0;
+    err = clGetDeviceInfo(device_id, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(cl_uint), &baseAddrAlign, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to query device info!\n");
+        return 1;
+    }
+    printf("CL_DEVICE_MEM_BASE_ADDR_ALIGN: %u bits\n", baseAddrAlign);
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestAlignment_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestAlignment", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 1;
+    }
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    cl_mem hostPtrInput = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem hostPtrOutput = clCreateBuffer(context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, sizeof(float) * count, &hostOutput[1], NULL);
+    if (!input || !output || !hostPtrInput || !hostPtrOutput) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    // aligned, not aligned, and aligned again
+    unsigned correct = execute(commands, kernel, input, output, data, count);
+    correct += execute(commands, kernel, hostPtrInput, hostPtrOutput, data, count);
+    correct += execute(commands, kernel, input, output, data, count);
+    printf("Computed '%d/%d' correct values!\n", correct, 3*count);
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseMemObject(hostPtrInput);
+    clReleaseMemObject(hostPtrOutput);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    const bool success = correct == 3*count && baseAddrAlign >= 64*8;
+    return success ? 0 : 1; // 0 = successful
+}
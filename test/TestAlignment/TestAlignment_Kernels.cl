@@ -0,0 +1,12 @@
+// Consecutive loads and stores, the aligned variant of this kernel uses
+// aligned vector memory accesses.
+__kernel void TestAlignment(
+   __global float* input,
+   __global float* output,
+   const unsigned int count)
+{
+	const int i = get_global_id(0);
+	if (i < count) {
+		output[i] = input[i] * 2.f + 1.f;
+	}
+}
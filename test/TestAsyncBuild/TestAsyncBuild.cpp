@@ -0,0 +1,233 @@
+//
+// File:       TestAsyncBuild.cpp
+//
+// Abstract:   Builds a program with a notification callback (which lets the
+//             build run in the background), waits for the build status
+//             reported by clGetProgramBuildInfo, and executes its kernel.
+//             A program that does not compile has to report a build error
+//             and the diagnostics of the compiler in its build log.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+#define BUILD_TIMEOUT (60) // seconds
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct BuildNotification {
+    cl_program program;
+    volatile int numCalls;
+};
+
+void CL_CALLBACK notifyBuild(cl_program program, void* user_data) {
+    BuildNotification* notification = (BuildNotification*)user_data;
+    if (program == notification->program) ++notification->numCalls;
+}
+
+// Waits until the callback of the build was called, at most BUILD_TIMEOUT
+// seconds.
+bool waitForCallback(const BuildNotification& notification) {
+    const time_t start = time(NULL);
+    while (notification.numCalls == 0) {
+        if (time(NULL) - start > BUILD_TIMEOUT) {
+            printf("Error: Build callback was not called within %d seconds!\n", BUILD_TIMEOUT);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Polls the build status until the build is not in progress anymore, at
+// most BUILD_TIMEOUT seconds.
+cl_build_status waitForBuild(cl_program program, cl_device_id device_id) {
+    const time_t start = time(NULL);
+    cl_build_status status = CL_BUILD_IN_PROGRESS;
+    while (status == CL_BUILD_IN_PROGRESS) {
+        int err = clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_STATUS, sizeof(cl_build_status), &status, NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to query build status! %d\n", err);
+            return CL_BUILD_ERROR;
+        }
+        if (status == CL_BUILD_IN_PROGRESS && time(NULL) - start > BUILD_TIMEOUT) {
+            printf("Error: Build did not finish within %d seconds!\n", BUILD_TIMEOUT);
+            return CL_BUILD_ERROR;
+        }
+    }
+    return status;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestAsyncBuild_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+
+    BuildNotification notification;
+    notification.program = program;
+    notification.numCalls = 0;
+    err = clBuildProgram(program, 0, NULL, NULL, notifyBuild, &notification);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to start build of program executable!\n");
+        return 1;
+    }
+
+    // the input can be prepared while the program is built
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    if (!input || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    if (waitForBuild(program, device_id) != CL_BUILD_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestAsyncBuild", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 1;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 1;
+    }
+
+    size_t global = count;
+    size_t local = 16;
+    err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return 1;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count);
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return 1;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        if (results[i] == data[i] * data[i]) ++correct;
+    }
+    printf("Computed '%d/%d' correct values!\n", correct, count);
+
+    // the callback is called (exactly once) after the status has changed
+    if (!waitForCallback(notification)) return 1;
+    const int numCalls = notification.numCalls;
+    printf("Build callback was called %d time(s).\n", numCalls);
+
+    // a program that does not compile reports the error and a log
+    const char* invalidSource = "__kernel void TestAsyncBuildInvalid( { }";
+    cl_program invalidProgram = clCreateProgramWithSource(context, 1, &invalidSource, NULL, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    BuildNotification invalidNotification;
+    invalidNotification.program = invalidProgram;
+    invalidNotification.numCalls = 0;
+    clBuildProgram(invalidProgram, 0, NULL, NULL, notifyBuild, &invalidNotification);
+    const cl_build_status invalidStatus = waitForBuild(invalidProgram, device_id);
+    if (!waitForCallback(invalidNotification)) return 1;
+
+    size_t logSize = 0;
+    err = clGetProgramBuildInfo(invalidProgram, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to query build log! %d\n", err);
+        return 1;
+    }
+    std::vector<char> log(logSize);
+    clGetProgramBuildInfo(invalidProgram, device_id, CL_PROGRAM_BUILD_LOG, logSize, &log[0], NULL);
+    printf("Build log of invalid program:\n%s\n", &log[0]);
+    // the log holds the diagnostics of the compiler, not only a summary
+    const bool logHasDiagnostics = strstr(&log[0], "compilation of program source with clc failed") == NULL;
+
+    clReleaseProgram(invalidProgram);
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    const bool success = correct == count && numCalls == 1 &&
+        invalidStatus == CL_BUILD_ERROR && logSize > 1 && logHasDiagnostics;
+    return success ? 0 : 1; // 0 = successful
+}
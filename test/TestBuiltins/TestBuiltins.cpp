@@ -0,0 +1,176 @@
+//
+// File:       TestBuiltins.cpp
+//
+// Abstract:   Evaluates clamp, mix, select, dot, length, mad24 and
+//             convert_uchar_sat in a vectorized kernel and compares the
+//             results to the ones of the host.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool isClose(const float result, const float reference) {
+    return fabs(result - reference) <= 1e-6f * fabs(reference) + 1e-6f;
+}
+
+unsigned char convertUCharSat(const float x) {
+    if (!(x > 0.0f)) return 0; // also NaN
+    if (x >= 255.0f) return 255;
+    return (unsigned char)x;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    int intData[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = 4.0f * rand() / (float)RAND_MAX - 2.0f;
+        intData[i] = rand() % 1000 - 500;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestBuiltins_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestBuiltins", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 1;
+    }
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem intInput = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * count, intData, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count * 4, NULL, NULL);
+    cl_mem intOutput = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(int) * count * 2, NULL, NULL);
+    cl_mem ucharOutput = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(unsigned char) * count, NULL, NULL);
+    if (!input || !intInput || !output || !intOutput || !ucharOutput) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &intInput);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &intOutput);
+    err |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &ucharOutput);
+    err |= clSetKernelArg(kernel, 5, sizeof(unsigned int), &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 1;
+    }
+
+    size_t global = count;
+    size_t local = 16;
+    err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return 1;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count * 4);
+    std::vector<int> intResults(count * 2);
+    std::vector<unsigned char> ucharResults(count);
+    err  = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count * 4, &results[0], 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(commands, intOutput, CL_TRUE, 0, sizeof(int) * count * 2, &intResults[0], 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(commands, ucharOutput, CL_TRUE, 0, sizeof(unsigned char) * count, &ucharResults[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output arrays! %d\n", err);
+        return 1;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        const float x = data[i];
+        const int n = intData[i];
+        if (isClose(results[4*i+0], x < -0.5f ? -0.5f : x > 0.5f ? 0.5f : x)) ++correct;
+        if (isClose(results[4*i+1], x + (2.0f - x) * 0.25f)) ++correct;
+        if (results[4*i+2] == ((n & 1) ? -x : x)) ++correct;
+        if (isClose(results[4*i+3], x * x + fabs(x))) ++correct;
+        if (intResults[2*i+0] == n * 3 - 7) ++correct;
+        if (intResults[2*i+1] == (n < -100 ? -100 : n > 100 ? 100 : n)) ++correct;
+        if (ucharResults[i] == convertUCharSat(x * 200.0f)) ++correct;
+    }
+    printf("Computed '%d/%d' correct values!\n", correct, 7*count);
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(intInput);
+    clReleaseMemObject(output);
+    clReleaseMemObject(intOutput);
+    clReleaseMemObject(ucharOutput);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    return correct == 7*count ? 0 : 1; // 0 = successful
+}
@@ -0,0 +1,23 @@
+// Each work item evaluates builtins that have packet versions in the
+// builtin library of the driver.
+__kernel void TestBuiltins(
+   __global float* input,
+   __global int* intInput,
+   __global float* output,
+   __global int* intOutput,
+   __global uchar* ucharOutput,
+   const unsigned int count)
+{
+	const int i = get_global_id(0);
+	if (i < count) {
+		const float x = input[i];
+		const int n = intInput[i];
+		output[4*i+0] = clamp(x, -0.5f, 0.5f);
+		output[4*i+1] = mix(x, 2.0f, 0.25f);
+		output[4*i+2] = select(x, -x, n & 1);
+		output[4*i+3] = dot(x, x) + length(x);
+		intOutput[2*i+0] = mad24(n, 3, -7);
+		intOutput[2*i+1] = clamp(n, -100, 100);
+		ucharOutput[i] = convert_uchar_sat(x * 200.0f);
+	}
+}
@@ -0,0 +1,223 @@
+//
+// File:       TestDeviceFission.cpp
+//
+// Abstract:   Partitions the CPU device into sub-devices (cl_ext_device_fission)
+//             and executes the same kernel on each of them, using one context
+//             and command queue per sub-device.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#include <OpenCL/cl_ext.h>
+#else
+#include <CL/opencl.h>
+#include <CL/cl_ext.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Runs the kernel on 'device' and returns the number of correct results.
+unsigned runOnDevice(cl_device_id device, const char* source, const float* data, const unsigned count) {
+    int err;
+    cl_context context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context for sub-device!\n");
+        return 0;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue for sub-device!\n");
+        return 0;
+    }
+
+    size_t sourceSize[] = { strlen(source) };
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 0;
+    }
+    err = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 0;
+    }
+    cl_kernel kernel = clCreateKernel(program, "TestDeviceFission", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 0;
+    }
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, (void*)data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    if (!input || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 0;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 0;
+    }
+
+    size_t global = count;
+    size_t local = 1; // let the driver choose a group size that fits the sub-device
+    err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return 0;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count);
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return 0;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        if (results[i] == data[i] * data[i]) ++correct;
+    }
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+
+    return correct;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    char extensions[2048];
+    err = clGetPlatformInfo(platform, CL_PLATFORM_EXTENSIONS, sizeof(extensions), extensions, NULL);
+    if (err != CL_SUCCESS || !strstr(extensions, "cl_ext_device_fission")) {
+        printf("Platform does not support cl_ext_device_fission, skipping.\n");
+        return 0;
+    }
+
+    clCreateSubDevicesEXT_fn createSubDevices =
+        (clCreateSubDevicesEXT_fn)clGetExtensionFunctionAddress("clCreateSubDevicesEXT");
+    clReleaseDeviceEXT_fn releaseDevice =
+        (clReleaseDeviceEXT_fn)clGetExtensionFunctionAddress("clReleaseDeviceEXT");
+    if (!createSubDevices || !releaseDevice) {
+        printf("Error: Failed to query device fission functions!\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_uint numComputeUnits;
+    err = clGetDeviceInfo(device_id, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &numComputeUnits, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to query number of compute units!\n");
+        return 1;
+    }
+    printf("Device has %d compute units.\n", numComputeUnits);
+
+    // split the device into two halves (or one sub-device if there is only one core)
+    const cl_uint unitsPerSubDevice = numComputeUnits > 1 ? numComputeUnits / 2 : 1;
+    const cl_device_partition_property_ext properties[] = {
+        CL_DEVICE_PARTITION_EQUALLY_EXT,
+        unitsPerSubDevice,
+        CL_PROPERTIES_LIST_END_EXT
+    };
+    cl_uint numSubDevices;
+    err = createSubDevices(device_id, properties, 0, NULL, &numSubDevices);
+    if (err != CL_SUCCESS || numSubDevices != numComputeUnits / unitsPerSubDevice) {
+        printf("Error: Failed to query number of sub-devices! %d\n", err);
+        return 1;
+    }
+    std::vector<cl_device_id> subDevices(numSubDevices);
+    err = createSubDevices(device_id, properties, numSubDevices, &subDevices[0], NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create sub-devices! %d\n", err);
+        return 1;
+    }
+
+    // invalid partitions have to be rejected
+    const cl_device_partition_property_ext tooMany[] = {
+        CL_DEVICE_PARTITION_BY_COUNTS_EXT,
+        numComputeUnits + 1,
+        CL_PARTITION_BY_COUNTS_LIST_END_EXT,
+        CL_PROPERTIES_LIST_END_EXT
+    };
+    if (createSubDevices(device_id, tooMany, 0, NULL, &numSubDevices) != CL_INVALID_PARTITION_COUNT_EXT) {
+        printf("Error: Partition with too many compute units was not rejected!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestDeviceFission_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+
+    bool allCorrect = true;
+    for (unsigned d=0; d<subDevices.size(); ++d) {
+        cl_device_id parent = NULL;
+        cl_uint units = 0;
+        clGetDeviceInfo(subDevices[d], CL_DEVICE_PARENT_DEVICE_EXT, sizeof(cl_device_id), &parent, NULL);
+        clGetDeviceInfo(subDevices[d], CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &units, NULL);
+        if (parent != device_id || units != unitsPerSubDevice) {
+            printf("Error: Sub-device %d has wrong parent or number of compute units!\n", d);
+            allCorrect = false;
+        }
+
+        const unsigned correct = runOnDevice(subDevices[d], source, data, count);
+        printf("Sub-device %d: computed '%d/%d' correct values!\n", d, correct, count);
+        allCorrect &= correct == count;
+
+        releaseDevice(subDevices[d]);
+    }
+
+    delete sampleCommon;
+
+    return allCorrect ? 0 : 1; // 0 = successful
+}
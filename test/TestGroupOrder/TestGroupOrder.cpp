@@ -0,0 +1,194 @@
+//
+// File:       TestGroupOrder.cpp
+//
+// Abstract:   Executes a 2D kernel on buffers with NUMA placement flags with
+//             all orders of work groups (cl_wfv_kernel_exec_info extension),
+//             with and without pinning of the threads, and with different
+//             local sizes that result in the same number of groups but in
+//             different tile sizes. All launches have to compute the same
+//             results as the host.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#include <OpenCL/cl_ext.h>
+#else
+#include <CL/opencl.h>
+#include <CL/cl_ext.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define WIDTH (512)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Executes the kernel on a 'width' x 'width' part of the buffers and returns
+// the number of correct results.
+unsigned execute(cl_command_queue commands, cl_kernel kernel, cl_mem input, cl_mem output,
+                 const float* data, const unsigned width, const size_t local)
+{
+    const unsigned count = WIDTH * WIDTH;
+    std::vector<float> results(count, 0.f);
+    int err = clEnqueueWriteBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &width);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 0;
+    }
+
+    size_t globalSize[2] = { width, width };
+    size_t localSize[2] = { local, local };
+    err = clEnqueueNDRangeKernel(commands, kernel, 2, NULL, globalSize, localSize, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return 0;
+    }
+    clFinish(commands);
+
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return 0;
+    }
+
+    unsigned correct = 0;
+    for (unsigned y=0; y<width; ++y) {
+        for (unsigned x=0; x<width; ++x) {
+            const unsigned i = y * width + x;
+            if (results[i] == data[i] * 2.f + y) ++correct;
+        }
+    }
+    return correct;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    const unsigned count = WIDTH * WIDTH;
+    std::vector<float> data(count);
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = (float)(rand() % 1024);
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    clSetKernelExecInfoWFV_fn setKernelExecInfo =
+        (clSetKernelExecInfoWFV_fn)clGetExtensionFunctionAddress("clSetKernelExecInfoWFV");
+    if (!setKernelExecInfo) {
+        printf("Error: Failed to query clSetKernelExecInfoWFV!\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestGroupOrder_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestGroupOrder", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 1;
+    }
+
+    // the input is initialized by the driver, the output by the kernel
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR | CL_MEM_NUMA_INTERLEAVE_WFV,
+                                  sizeof(float) * count, &data[0], NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_HUGE_PAGES_WFV,
+                                   sizeof(float) * count, NULL, NULL);
+    if (!input || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    const cl_uint orders[] = {
+        CL_GROUP_ORDER_AUTO_WFV,
+        CL_GROUP_ORDER_ROW_MAJOR_WFV,
+        CL_GROUP_ORDER_MORTON_WFV,
+        CL_GROUP_ORDER_HILBERT_WFV
+    };
+    const unsigned numOrders = sizeof(orders) / sizeof(cl_uint);
+
+    unsigned correct = 0;
+    unsigned total = 0;
+    for (unsigned o=0; o<numOrders; ++o) {
+        for (cl_bool affinity=CL_FALSE; affinity<=CL_TRUE; ++affinity) {
+            err  = setKernelExecInfo(kernel, CL_KERNEL_EXEC_GROUP_ORDER_WFV, sizeof(cl_uint), &orders[o]);
+            err |= setKernelExecInfo(kernel, CL_KERNEL_EXEC_AFFINITY_WFV, sizeof(cl_bool), &affinity);
+            if (err != CL_SUCCESS) {
+                printf("Error: Failed to set kernel execution info! %d\n", err);
+                return 1;
+            }
+
+            // 16x16 groups each, but with different tile sizes
+            correct += execute(commands, kernel, input, output, &data[0], WIDTH/2, 16);
+            correct += execute(commands, kernel, input, output, &data[0], WIDTH, 32);
+            total += (WIDTH/2) * (WIDTH/2) + WIDTH * WIDTH;
+        }
+    }
+    printf("Computed '%d/%d' correct values!\n", correct, total);
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    return correct == total ? 0 : 1; // 0 = successful
+}
@@ -0,0 +1,12 @@
+// Every work item writes one element of the output, so the results do not
+// depend on the order in which the work groups are executed.
+__kernel void TestGroupOrder(
+   __global float* input,
+   __global float* output,
+   const unsigned int width)
+{
+	const int x = get_global_id(0);
+	const int y = get_global_id(1);
+	const int i = y * width + x;
+	output[i] = input[i] * 2.f + y;
+}
@@ -0,0 +1,261 @@
+//
+// File:       TestMath.cpp
+//
+// Abstract:   Evaluates sqrt, exp, log, sin, cos and pow in a vectorized
+//             kernel and compares the results to the ones of the host.
+//             Some of the inputs are outside the range of the SIMD versions
+//             of the functions (huge, negative and special values). pow is
+//             also evaluated for negative and zero bases, with and without
+//             -cl-fast-relaxed-math.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+#define NUM_FUNCTIONS (6)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The precision of the vector code is a few ulp, the tolerance is relative
+// with an absolute part for results close to zero (e.g. sin(pi)).
+bool isClose(const float result, const double reference) {
+    if (isnan(reference)) return isnan(result);
+    if (isinf(reference)) return result == (float)reference;
+    return fabs(result - reference) <= 1e-5 * fabs(reference) + 1e-6;
+}
+
+// Executes TestMathPow of 'program' and returns the number of correct
+// results. Finite results of relaxed math are compared with a larger
+// tolerance.
+unsigned testPow(cl_context context, cl_command_queue commands, cl_program program, const bool relaxed,
+                 const float* bases, const float* exponents, const unsigned count)
+{
+    int err;
+    cl_kernel kernel = clCreateKernel(program, "TestMathPow", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 0;
+    }
+
+    cl_mem x = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, (void*)bases, NULL);
+    cl_mem y = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, (void*)exponents, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    if (!x || !y || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 0;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &x);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &y);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 3, sizeof(unsigned int), &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 0;
+    }
+
+    size_t global = count;
+    size_t local = 16;
+    err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return 0;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count);
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return 0;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        const float reference = (float)pow((double)bases[i], (double)exponents[i]);
+        const bool close = relaxed && !isnan(reference) && !isinf(reference) ?
+            fabs(results[i] - reference) <= 1e-4 * fabs(reference) + 1e-6 :
+            isClose(results[i], reference);
+        if (close) ++correct;
+        else printf("pow(%g, %g) = %g (expected %g%s)\n", bases[i], exponents[i], results[i], reference,
+                    relaxed ? ", relaxed" : "");
+    }
+
+    clReleaseMemObject(x);
+    clReleaseMemObject(y);
+    clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+    return correct;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = 20.0f * rand() / (float)RAND_MAX;
+    }
+    // values that the scalar functions have to handle
+    data[5] = 0.0f;
+    data[17] = -1.0f;
+    data[42] = 100.0f;
+    data[100] = 1e5f;
+    data[333] = 1e-40f;
+    data[1000] = INFINITY;
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestMath_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestMath", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 1;
+    }
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count * NUM_FUNCTIONS, NULL, NULL);
+    if (!input || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 1;
+    }
+
+    size_t global = count;
+    size_t local = 16;
+    err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return 1;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count * NUM_FUNCTIONS);
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count * NUM_FUNCTIONS, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return 1;
+    }
+
+    static const char* names[NUM_FUNCTIONS] = { "sqrt", "exp", "log", "sin", "cos", "pow" };
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        const double x = data[i];
+        const double references[NUM_FUNCTIONS] = { sqrt(x), exp(x), log(x), sin(x), cos(x), pow(x, 2.5) };
+        for (unsigned j=0; j<NUM_FUNCTIONS; ++j) {
+            const float result = results[NUM_FUNCTIONS*i+j];
+            if (isClose(result, (float)references[j])) ++correct;
+            else printf("%s(%g) = %g (expected %g)\n", names[j], x, result, references[j]);
+        }
+    }
+
+    // pow of negative bases with odd, even and non-integer exponents, and of
+    // zero (once in each SIMD group of 4 or 8 lanes, so the precise version
+    // calls the scalar function for all lanes)
+    static const float exponents[] = { 2.f, 3.f, -1.f, -2.f, 0.f, 0.5f, 2.5f, 1.f };
+    const unsigned numExponents = sizeof(exponents) / sizeof(exponents[0]);
+    std::vector<float> powBases(count);
+    std::vector<float> powExponents(count);
+    for (unsigned i=0; i<count; ++i) {
+        powBases[i] = 8.0f * rand() / (float)RAND_MAX - 4.0f;
+        powExponents[i] = exponents[(i / 8) % numExponents];
+    }
+    for (unsigned i=0; i<count; i+=8) powBases[i] = 0.0f;
+
+    cl_program relaxedProgram = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(relaxedProgram, 0, NULL, "-cl-fast-relaxed-math", NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable with -cl-fast-relaxed-math!\n");
+        return 1;
+    }
+    unsigned correctPow = testPow(context, commands, program, false, &powBases[0], &powExponents[0], count);
+    correctPow += testPow(context, commands, relaxedProgram, true, &powBases[0], &powExponents[0], count);
+    printf("Computed '%d/%d' correct values of pow!\n", correctPow, 2*count);
+    printf("Computed '%d/%d' correct values!\n", correct, NUM_FUNCTIONS*count);
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+    clReleaseProgram(relaxedProgram);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    return correct == NUM_FUNCTIONS*count && correctPow == 2*count ? 0 : 1; // 0 = successful
+}
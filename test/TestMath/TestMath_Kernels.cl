@@ -0,0 +1,31 @@
+// Each work item evaluates all math functions that have SIMD versions.
+__kernel void TestMath(
+   __global float* input,
+   __global float* output,
+   const unsigned int count)
+{
+	const int i = get_global_id(0);
+	if (i < count) {
+		const float x = input[i];
+		output[6*i+0] = sqrt(x);
+		output[6*i+1] = exp(x);
+		output[6*i+2] = log(x);
+		output[6*i+3] = sin(x);
+		output[6*i+4] = cos(x);
+		output[6*i+5] = pow(x, 2.5f);
+	}
+}
+
+// pow with bases and exponents of every sign, also built with
+// -cl-fast-relaxed-math, which always uses the vector code.
+__kernel void TestMathPow(
+   __global float* x,
+   __global float* y,
+   __global float* output,
+   const unsigned int count)
+{
+	const int i = get_global_id(0);
+	if (i < count) {
+		output[i] = pow(x[i], y[i]);
+	}
+}
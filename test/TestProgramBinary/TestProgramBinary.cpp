@@ -0,0 +1,194 @@
+//
+// File:       TestProgramBinary.cpp
+//
+// Abstract:   Builds a program from source, queries its binary, and executes
+//             a kernel of a second program that is created from that binary
+//             (clCreateProgramWithBinary, clGetProgramInfo).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Runs the kernel of 'program' and returns the number of correct results.
+unsigned runProgram(cl_context context, cl_command_queue commands, cl_program program, const float* data, const unsigned count) {
+    int err;
+    cl_kernel kernel = clCreateKernel(program, "TestProgramBinary", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 0;
+    }
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, (void*)data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    if (!input || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 0;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 0;
+    }
+
+    size_t global = count;
+    size_t local = 16;
+    err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel!\n");
+        return 0;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count);
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return 0;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        if (results[i] == data[i] * data[i]) ++correct;
+    }
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+
+    return correct;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestProgramBinary_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    // run once from source, the binary then contains the generated kernel
+    const unsigned correctSource = runProgram(context, commands, program, data, count);
+    printf("Program from source: computed '%d/%d' correct values!\n", correctSource, count);
+
+    size_t binarySize = 0;
+    err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, NULL);
+    if (err != CL_SUCCESS || binarySize == 0) {
+        printf("Error: Failed to query binary size! %d\n", err);
+        return 1;
+    }
+    std::vector<unsigned char> binary(binarySize);
+    unsigned char* binaryPtr = &binary[0];
+    err = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binaryPtr, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to query binary! %d\n", err);
+        return 1;
+    }
+    clReleaseProgram(program);
+    printf("Program binary has %d bytes.\n", (int)binarySize);
+
+    // binaries that are no programs have to be rejected
+    const unsigned char garbage[] = "no binary";
+    const unsigned char* garbagePtr = garbage;
+    const size_t garbageSize = sizeof(garbage);
+    cl_int status;
+    cl_program invalidProgram = clCreateProgramWithBinary(context, 1, &device_id, &garbageSize, &garbagePtr, &status, &err);
+    if (invalidProgram || err != CL_INVALID_BINARY || status != CL_INVALID_BINARY) {
+        printf("Error: Invalid binary was not rejected!\n");
+        return 1;
+    }
+
+    const unsigned char* constBinaryPtr = binaryPtr;
+    cl_program binaryProgram = clCreateProgramWithBinary(context, 1, &device_id, &binarySize, &constBinaryPtr, &status, &err);
+    if (!binaryProgram || err != CL_SUCCESS || status != CL_SUCCESS) {
+        printf("Error: Failed to create program from binary! %d\n", err);
+        return 1;
+    }
+    err = clBuildProgram(binaryProgram, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program from binary!\n");
+        return 1;
+    }
+
+    const unsigned correctBinary = runProgram(context, commands, binaryProgram, data, count);
+    printf("Program from binary: computed '%d/%d' correct values!\n", correctBinary, count);
+
+    clReleaseProgram(binaryProgram);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    return (correctSource == count && correctBinary == count) ? 0 : 1; // 0 = successful
+}
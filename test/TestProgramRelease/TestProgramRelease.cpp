@@ -0,0 +1,164 @@
+//
+// File:       TestProgramRelease.cpp
+//
+// Abstract:   Builds, executes and releases the same program many times, as
+//             applications do that reload their kernels. The program is
+//             released before its kernel, which has to keep it alive (and
+//             the native code of the kernel) until the kernel is released.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+#define NUM_RELOADS (16)
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestProgramRelease_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    if (!input || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    unsigned numCorrectReloads = 0;
+    std::vector<float> results(count);
+    for (unsigned r=0; r<NUM_RELOADS; ++r) {
+        cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to create program!\n");
+            return 1;
+        }
+        err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to build program executable!\n");
+            return 1;
+        }
+
+        cl_kernel kernel = clCreateKernel(program, "TestProgramRelease", &err);
+        if (!kernel || err != CL_SUCCESS) {
+            printf("Error: Failed to create compute kernel!\n");
+            return 1;
+        }
+
+        // an additional reference of the application
+        clRetainProgram(program);
+        cl_uint refCount = 0;
+        err = clGetProgramInfo(program, CL_PROGRAM_REFERENCE_COUNT, sizeof(cl_uint), &refCount, NULL);
+        if (err != CL_SUCCESS || refCount < 2) {
+            printf("Error: Unexpected program reference count %u!\n", refCount);
+            return 1;
+        }
+        clReleaseProgram(program);
+
+        // the kernel keeps the program alive
+        clReleaseProgram(program);
+
+        err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+        err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+        err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &count);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to set kernel arguments! %d\n", err);
+            return 1;
+        }
+
+        size_t global = count;
+        size_t local = 16;
+        err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+        if (err) {
+            printf("Error: Failed to execute kernel!\n");
+            return 1;
+        }
+        clFinish(commands);
+
+        err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to read output array! %d\n", err);
+            return 1;
+        }
+
+        // the second reference of the kernel is released last
+        clRetainKernel(kernel);
+        clReleaseKernel(kernel);
+        clReleaseKernel(kernel);
+
+        unsigned correct = 0;
+        for (unsigned i=0; i<count; ++i) {
+            if (results[i] == data[i] * data[i]) ++correct;
+        }
+        printf("Reload %u: computed '%d/%d' correct values!\n", r, correct, count);
+        if (correct == count) ++numCorrectReloads;
+    }
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    return numCorrectReloads == NUM_RELOADS ? 0 : 1; // 0 = successful
+}
@@ -0,0 +1,246 @@
+//
+// File:       TestSimdDim.cpp
+//
+// Abstract:   Executes a kernel that is vectorized in dimension 1 with group
+//             sizes that are multiples of the SIMD width in that dimension
+//             and with sizes that are not (e.g. a global size of {64, 3} or
+//             a group size of 1), which the driver has to execute as scalar
+//             code. A second kernel, which is vectorized in dimension 0,
+//             stores to an index that is uniform in the SIMD dimension.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (64)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Initializes 'buffer' (of 'count' floats) with -1.
+bool clearBuffer(cl_command_queue commands, cl_mem buffer, const unsigned count) {
+    std::vector<float> data(count, -1.f);
+    int err = clEnqueueWriteBuffer(commands, buffer, CL_TRUE, 0, sizeof(float) * count, &data[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to write to buffer! %d\n", err);
+        return false;
+    }
+    return true;
+}
+
+// Executes 'kernel' with the given sizes and reads 'output' (of 'count'
+// floats) into 'results'.
+bool execute(cl_command_queue commands, cl_kernel kernel, const size_t* global, const size_t* local,
+             cl_mem output, const unsigned count, std::vector<float>& results)
+{
+    int err = clEnqueueNDRangeKernel(commands, kernel, 2, NULL, global, local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel with global size {%u, %u}, local size {%u, %u}! %d\n",
+               (unsigned)global[0], (unsigned)global[1], (unsigned)local[0], (unsigned)local[1], err);
+        return false;
+    }
+    clFinish(commands);
+
+    results.resize(count);
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return false;
+    }
+    return true;
+}
+
+// Prints the dimension in which 'kernel' was vectorized.
+void printSimdDimension(cl_kernel kernel, const char* name) {
+    cl_int simdDim = -1;
+    clGetKernelInfo(kernel, CL_KERNEL_SIMD_DIMENSION_WFV, sizeof(cl_int), &simdDim, NULL);
+    printf("%s: SIMD dimension %d\n", name, simdDim);
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    for (unsigned i=0; i<DATA_SIZE; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestSimdDim_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestSimdDim", &err);
+    cl_kernel kernelUniformStore = clCreateKernel(program, "TestSimdDimUniformStore", &err);
+    if (!kernel || !kernelUniformStore || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernels!\n");
+        return 1;
+    }
+    printSimdDimension(kernel, "TestSimdDim");
+    printSimdDimension(kernelUniformStore, "TestSimdDimUniformStore");
+
+    const unsigned count = DATA_SIZE * DATA_SIZE;
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * DATA_SIZE, data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(float) * count, NULL, NULL);
+    cl_mem output2 = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(float) * DATA_SIZE, NULL, NULL);
+    if (!input || !output || !output2) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernelUniformStore, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernelUniformStore, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernelUniformStore, 2, sizeof(cl_mem), &output2);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 1;
+    }
+
+    // global and local sizes: sizes of the SIMD dimension that are
+    // multiples of the SIMD width, that are not, and groups of size 1
+    const size_t configs[][4] = {
+        { 64, 16, 2, 16 },
+        { 64, 8, 1, 8 },
+        { 64, 3, 64, 3 },
+        { 64, 3, 1, 1 },
+        { 64, 8, 4, 1 },
+        { 32, 6, 8, 2 }
+    };
+    const unsigned num_configs = sizeof(configs) / sizeof(configs[0]);
+
+    unsigned correct = 0;
+    unsigned total = 0;
+    std::vector<float> results;
+    for (unsigned c=0; c<num_configs; ++c) {
+        const size_t* global = &configs[c][0];
+        const size_t* local = &configs[c][2];
+        const unsigned size = (unsigned)(global[0] * global[1]);
+        if (!clearBuffer(commands, output, count)) return 1;
+        if (!execute(commands, kernel, global, local, output, count, results)) return 1;
+
+        unsigned config_correct = 0;
+        for (unsigned i=0; i<global[0]; ++i) {
+            for (unsigned j=0; j<global[1]; ++j) {
+                if (results[j + i*global[1]] == data[i] * 2.f + data[j]) ++config_correct;
+            }
+        }
+        // nothing is written beyond the global size
+        for (unsigned i=size; i<count; ++i) {
+            if (results[i] == -1.f) ++config_correct;
+        }
+        printf("TestSimdDim, global size {%u, %u}, local size {%u, %u}: '%d/%d' correct values\n",
+               (unsigned)global[0], (unsigned)global[1], (unsigned)local[0], (unsigned)local[1], config_correct, count);
+        correct += config_correct;
+        total += count;
+    }
+
+    // the uniform store in dimension 0 with groups that fit the SIMD width
+    // and with groups that do not
+    const size_t configsUniformStore[][4] = {
+        { 16, 16, 16, 16 },
+        { 16, 16, 8, 2 },
+        { 16, 16, 1, 1 }
+    };
+    const unsigned num_configs_uniform_store = sizeof(configsUniformStore) / sizeof(configsUniformStore[0]);
+    for (unsigned c=0; c<num_configs_uniform_store; ++c) {
+        const size_t* global = &configsUniformStore[c][0];
+        const size_t* local = &configsUniformStore[c][2];
+        const unsigned size = (unsigned)(global[0] * global[1]);
+        if (!clearBuffer(commands, output2, DATA_SIZE)) return 1;
+        if (!execute(commands, kernelUniformStore, global, local, output, count, results)) return 1;
+
+        unsigned config_correct = 0;
+        for (unsigned i=0; i<global[0]; ++i) {
+            for (unsigned j=0; j<global[1]; ++j) {
+                if (results[i + j*global[0]] == data[i] + data[j]) ++config_correct;
+            }
+        }
+        std::vector<float> results2(DATA_SIZE);
+        err = clEnqueueReadBuffer(commands, output2, CL_TRUE, 0, sizeof(float) * DATA_SIZE, &results2[0], 0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to read output array! %d\n", err);
+            return 1;
+        }
+        for (unsigned j=0; j<global[1]; ++j) {
+            if (results2[j] == data[0]) ++config_correct;
+        }
+        printf("TestSimdDimUniformStore, global size {%u, %u}, local size {%u, %u}: '%d/%d' correct values\n",
+               (unsigned)global[0], (unsigned)global[1], (unsigned)local[0], (unsigned)local[1],
+               config_correct, size + (unsigned)global[1]);
+        correct += config_correct;
+        total += size + (unsigned)global[1];
+    }
+    printf("Computed '%d/%d' correct values!\n", correct, total);
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseMemObject(output2);
+    clReleaseKernel(kernel);
+    clReleaseKernel(kernelUniformStore);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    return correct == total ? 0 : 1; // 0 = successful
+}
@@ -0,0 +1,29 @@
+// The accesses to 'output' are consecutive in dimension 1, so the kernel is
+// vectorized in dimension 1. Launches whose group size in dimension 1 is
+// not a multiple of the SIMD width (e.g. 3) have to execute scalar code.
+__kernel void TestSimdDim(
+   __global float* input,
+   __global float* output)
+{
+	const int i = get_global_id(0);
+	const int j = get_global_id(1);
+
+	output[j + i*get_global_size(1)] = input[i] * 2.f + input[j];
+}
+
+// The accesses to 'output' are consecutive in dimension 0, so the kernel is
+// vectorized in dimension 0. The store to 'output2' goes to the same
+// location for all work items of a SIMD group (its index is uniform in the
+// SIMD dimension), which is no data race because they all store the same
+// value.
+__kernel void TestSimdDimUniformStore(
+   __global float* input,
+   __global float* output,
+   __global float* output2)
+{
+	const int i = get_global_id(0);
+	const int j = get_global_id(1);
+
+	output[i + j*get_global_size(0)] = input[i] + input[j];
+	output2[j] = input[0];
+}
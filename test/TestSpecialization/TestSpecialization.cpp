@@ -0,0 +1,185 @@
+//
+// File:       TestSpecialization.cpp
+//
+// Abstract:   Executes a kernel that is specialized on the values of two of
+//             its arguments (cl_wfv_kernel_exec_info extension) several
+//             times: with changing values (generic version), with the same
+//             values (specialized version), and with values seen before.
+//             All launches have to compute the same results as the host.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#include <OpenCL/cl_ext.h>
+#else
+#include <CL/opencl.h>
+#include <CL/cl_ext.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    const int count = DATA_SIZE;
+    for (int i=0; i<count; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    clSetKernelExecInfoWFV_fn setKernelExecInfo =
+        (clSetKernelExecInfoWFV_fn)clGetExtensionFunctionAddress("clSetKernelExecInfoWFV");
+    if (!setKernelExecInfo) {
+        printf("Error: Failed to query clSetKernelExecInfoWFV!\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestSpecialization_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestSpecialization", &err);
+    if (!kernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel!\n");
+        return 1;
+    }
+
+    // specialize on width and radius
+    const cl_uint specializedArgs[] = { 2, 3 };
+    err = setKernelExecInfo(kernel, CL_KERNEL_EXEC_SPECIALIZED_ARGS_WFV, sizeof(specializedArgs), specializedArgs);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to enable specialization! %d\n", err);
+        return 1;
+    }
+    // buffers can not be specialized
+    const cl_uint bufferArg = 0;
+    if (setKernelExecInfo(kernel, CL_KERNEL_EXEC_SPECIALIZED_ARGS_WFV, sizeof(bufferArg), &bufferArg) != CL_INVALID_ARG_INDEX) {
+        printf("Error: Specialization on buffer argument was not rejected!\n");
+        return 1;
+    }
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    if (!input || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    // radius 1 and 3 change in every launch, 2 is stable in launches 2-4
+    const int radii[] = { 1, 2, 2, 2, 3, 1, 2 };
+    const unsigned numLaunches = sizeof(radii) / sizeof(int);
+    unsigned numCorrectLaunches = 0;
+    std::vector<float> results(count);
+
+    for (unsigned l=0; l<numLaunches; ++l) {
+        const int radius = radii[l];
+        err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+        err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+        err |= clSetKernelArg(kernel, 2, sizeof(int), &count);
+        err |= clSetKernelArg(kernel, 3, sizeof(int), &radius);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to set kernel arguments! %d\n", err);
+            return 1;
+        }
+
+        size_t global = count;
+        size_t local = 16;
+        err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+        if (err) {
+            printf("Error: Failed to execute kernel!\n");
+            return 1;
+        }
+        clFinish(commands);
+
+        err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to read output array! %d\n", err);
+            return 1;
+        }
+
+        int correct = 0;
+        for (int i=0; i<count; ++i) {
+            float sum = 0.0f;
+            for (int r=-radius; r<=radius; ++r) {
+                int j = i + r;
+                j = j < 0 ? 0 : j;
+                j = j >= count ? count-1 : j;
+                sum += data[j];
+            }
+            if (fabs(results[i] - sum) <= 1e-5f * (float)(2*radius+1)) ++correct;
+        }
+        printf("Launch %u (radius %d): computed '%d/%d' correct values!\n", l, radius, correct, count);
+        if (correct == count) ++numCorrectLaunches;
+    }
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    return numCorrectLaunches == numLaunches ? 0 : 1; // 0 = successful
+}
@@ -0,0 +1,17 @@
+// Box filter whose width and radius are specialized by the runtime.
+__kernel void TestSpecialization(
+   __global float* input,
+   __global float* output,
+   const int width,
+   const int radius)
+{
+	const int i = get_global_id(0);
+	float sum = 0.0f;
+	for (int r=-radius; r<=radius; ++r) {
+		int j = i + r;
+		j = j < 0 ? 0 : j;
+		j = j >= width ? width-1 : j;
+		sum += input[j];
+	}
+	output[i] = sum;
+}
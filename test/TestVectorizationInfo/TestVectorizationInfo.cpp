@@ -0,0 +1,227 @@
+//
+// File:       TestVectorizationInfo.cpp
+//
+// Abstract:   Creates a kernel with consecutive memory accesses and one that
+//             gathers its input, executes both and queries the outcome of
+//             their vectorization (cl_wfv_kernel_vectorization_info). The
+//             build log has to describe both kernels.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct VectorizationInfo {
+    cl_bool vectorized;
+    cl_int simdDim;
+    cl_uint numUniformValues;
+    cl_uint numVaryingValues;
+    cl_uint numGathers;
+    cl_uint numScatters;
+    std::string log;
+};
+
+bool getVectorizationInfo(cl_kernel kernel, VectorizationInfo& info) {
+    int err  = clGetKernelInfo(kernel, CL_KERNEL_VECTORIZED_WFV, sizeof(cl_bool), &info.vectorized, NULL);
+    err |= clGetKernelInfo(kernel, CL_KERNEL_SIMD_DIMENSION_WFV, sizeof(cl_int), &info.simdDim, NULL);
+    err |= clGetKernelInfo(kernel, CL_KERNEL_NUM_UNIFORM_VALUES_WFV, sizeof(cl_uint), &info.numUniformValues, NULL);
+    err |= clGetKernelInfo(kernel, CL_KERNEL_NUM_VARYING_VALUES_WFV, sizeof(cl_uint), &info.numVaryingValues, NULL);
+    err |= clGetKernelInfo(kernel, CL_KERNEL_NUM_GATHERS_WFV, sizeof(cl_uint), &info.numGathers, NULL);
+    err |= clGetKernelInfo(kernel, CL_KERNEL_NUM_SCATTERS_WFV, sizeof(cl_uint), &info.numScatters, NULL);
+    size_t logSize = 0;
+    err |= clGetKernelInfo(kernel, CL_KERNEL_VECTORIZATION_LOG_WFV, 0, NULL, &logSize);
+    if (err != CL_SUCCESS || logSize == 0) {
+        printf("Error: Failed to query vectorization info! %d\n", err);
+        return false;
+    }
+    std::vector<char> log(logSize);
+    err = clGetKernelInfo(kernel, CL_KERNEL_VECTORIZATION_LOG_WFV, logSize, &log[0], NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to query vectorization log! %d\n", err);
+        return false;
+    }
+    info.log = &log[0];
+    printf("%s\n", info.log.c_str());
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    int indices[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+        indices[i] = rand() % count;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestVectorizationInfo_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestVectorizationInfo", &err);
+    cl_kernel gatherKernel = clCreateKernel(program, "TestVectorizationInfoGather", &err);
+    if (!kernel || !gatherKernel || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernels!\n");
+        return 1;
+    }
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem indexBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * count, indices, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    cl_mem gatherOutput = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    if (!input || !indexBuffer || !output || !gatherOutput) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernel, 2, sizeof(unsigned int), &count);
+    err |= clSetKernelArg(gatherKernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(gatherKernel, 1, sizeof(cl_mem), &indexBuffer);
+    err |= clSetKernelArg(gatherKernel, 2, sizeof(cl_mem), &gatherOutput);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 1;
+    }
+
+    size_t global = count;
+    size_t local = 16;
+    err  = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    err |= clEnqueueNDRangeKernel(commands, gatherKernel, 1, NULL, &global, &local, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernels!\n");
+        return 1;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count);
+    std::vector<float> gatherResults(count);
+    err  = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(commands, gatherOutput, CL_TRUE, 0, sizeof(float) * count, &gatherResults[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output arrays! %d\n", err);
+        return 1;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        if (results[i] == data[i] * data[i]) ++correct;
+        if (gatherResults[i] == data[indices[i]]) ++correct;
+    }
+    printf("Computed '%d/%d' correct values!\n", correct, 2*count);
+
+    // standard kernel information
+    char name[64];
+    cl_uint numArgs = 0;
+    err  = clGetKernelInfo(gatherKernel, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+    err |= clGetKernelInfo(gatherKernel, CL_KERNEL_NUM_ARGS, sizeof(cl_uint), &numArgs, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to query kernel info! %d\n", err);
+        return 1;
+    }
+    const bool kernelInfoValid = !strcmp(name, "TestVectorizationInfoGather") && numArgs == 3;
+
+    VectorizationInfo info;
+    VectorizationInfo gatherInfo;
+    if (!getVectorizationInfo(kernel, info) || !getVectorizationInfo(gatherKernel, gatherInfo)) return 1;
+
+    // A kernel that could not be vectorized only has to explain why, the
+    // index array makes the loads of the second kernel gathers.
+    bool vectorizationInfoValid = (info.vectorized == CL_TRUE) == (info.simdDim >= 0);
+    if (info.vectorized) {
+        vectorizationInfoValid &= info.simdDim == 0 && info.numGathers == 0 && info.numScatters == 0;
+    }
+    if (gatherInfo.vectorized) {
+        vectorizationInfoValid &= gatherInfo.simdDim == 0 && gatherInfo.numGathers > 0 && gatherInfo.numVaryingValues > 0;
+    }
+
+    size_t logSize = 0;
+    clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
+    std::vector<char> buildLog(logSize + 1);
+    clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, logSize, &buildLog[0], NULL);
+    printf("Build log:\n%s\n", &buildLog[0]);
+    const std::string log = &buildLog[0];
+    const bool buildLogValid = log.find("'TestVectorizationInfo'") != std::string::npos &&
+        log.find("'TestVectorizationInfoGather'") != std::string::npos;
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(indexBuffer);
+    clReleaseMemObject(output);
+    clReleaseMemObject(gatherOutput);
+    clReleaseKernel(kernel);
+    clReleaseKernel(gatherKernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    const bool success = correct == 2*count && kernelInfoValid && vectorizationInfoValid && buildLogValid;
+    return success ? 0 : 1; // 0 = successful
+}
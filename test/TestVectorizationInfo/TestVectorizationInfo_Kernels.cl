@@ -0,0 +1,20 @@
+// The first kernel only accesses consecutive addresses, the second one
+// loads through an index array (a gather in the vectorized kernel).
+__kernel void TestVectorizationInfo(
+   __global float* input,
+   __global float* output,
+   const unsigned int count)
+{
+	const int i = get_global_id(0);
+	if (i < count)
+		output[i] = input[i] * input[i];
+}
+
+__kernel void TestVectorizationInfoGather(
+   __global float* input,
+   __global int* indices,
+   __global float* output)
+{
+	const int i = get_global_id(0);
+	output[i] = input[indices[i]];
+}
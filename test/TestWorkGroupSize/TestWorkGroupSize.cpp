@@ -0,0 +1,257 @@
+//
+// File:       TestWorkGroupSize.cpp
+//
+// Abstract:   Executes a kernel several times with the same and with changing
+//             local sizes (the runtime specializes it on stable sizes if
+//             requested with CL_KERNEL_EXEC_SPECIALIZE_LOCAL_SIZE_WFV), and a
+//             kernel with a required work group size: its size has to be
+//             reported by clGetKernelWorkGroupInfo, used if no local size is
+//             given, and other sizes have to be rejected. The kernel with the
+//             required size is also created again after the runtime released
+//             the IR of a program in which all kernels were compiled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <SDKCommon.hpp>
+#include <SDKApplication.hpp>
+#include <SDKCommandArgs.hpp>
+#include <SDKFile.hpp>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DATA_SIZE (4096)
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Executes the kernel and compares the results to the host (local_size NULL
+// = no local size given, the kernel has to use its required size).
+bool runKernel(cl_command_queue commands, cl_kernel kernel, cl_mem output, const float* data,
+               const unsigned count, const size_t* local_size, const size_t expected_local_size)
+{
+    size_t global = count;
+    int err = clEnqueueNDRangeKernel(commands, kernel, 1, NULL, &global, local_size, 0, NULL, NULL);
+    if (err) {
+        printf("Error: Failed to execute kernel! %d\n", err);
+        return false;
+    }
+    clFinish(commands);
+
+    std::vector<float> results(count);
+    err = clEnqueueReadBuffer(commands, output, CL_TRUE, 0, sizeof(float) * count, &results[0], 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return false;
+    }
+
+    unsigned correct = 0;
+    for (unsigned i=0; i<count; ++i) {
+        if (results[i] == data[i] * expected_local_size + (i % expected_local_size)) ++correct;
+    }
+    printf("Local size %u: computed '%d/%d' correct values!\n", (unsigned)expected_local_size, correct, count);
+    return correct == count;
+}
+
+int main(int argc, char** argv)
+{
+    int err;
+
+    float data[DATA_SIZE];
+    const unsigned count = DATA_SIZE;
+    for (unsigned i=0; i<count; ++i) {
+        data[i] = rand() / (float)RAND_MAX;
+    }
+
+    cl_platform_id platform = NULL;
+    err = clGetPlatformIDs(1, &platform, NULL);
+    if (err != CL_SUCCESS || !platform) {
+        printf("Error: Getting Platforms. (clGetPlatformsIDs)\n");
+        return 1;
+    }
+
+    clSetKernelExecInfoWFV_fn setKernelExecInfo =
+        (clSetKernelExecInfoWFV_fn)clGetExtensionFunctionAddress("clSetKernelExecInfoWFV");
+    if (!setKernelExecInfo) {
+        printf("Error: Failed to query clSetKernelExecInfoWFV!\n");
+        return 1;
+    }
+
+    cl_device_id device_id;
+    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device_id, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get device!\n");
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+    if (!context || err != CL_SUCCESS) {
+        printf("Error: Failed to create a compute context!\n");
+        return 1;
+    }
+    cl_command_queue commands = clCreateCommandQueue(context, device_id, 0, &err);
+    if (!commands || err != CL_SUCCESS) {
+        printf("Error: Failed to create a command queue!\n");
+        return 1;
+    }
+
+    streamsdk::SDKFile kernelFile;
+    streamsdk::SDKCommon* sampleCommon = new streamsdk::SDKCommon();
+    std::string kernelPath = sampleCommon->getPath();
+    kernelPath.append("TestWorkGroupSize_Kernels.cl");
+    if (!kernelFile.open(kernelPath.c_str())) {
+        printf("Failed to load kernel file : %s\n", kernelPath.c_str());
+        return SDK_FAILURE;
+    }
+    const char* source = kernelFile.source().c_str();
+    size_t sourceSize[] = { strlen(source) };
+
+    cl_program program = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "TestWorkGroupSize", &err);
+    cl_kernel kernelRequired = clCreateKernel(program, "TestWorkGroupSizeRequired", &err);
+    if (!kernel || !kernelRequired || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernels!\n");
+        return 1;
+    }
+
+    size_t compileSize[3];
+    size_t compileSizeRequired[3];
+    err  = clGetKernelWorkGroupInfo(kernel, device_id, CL_KERNEL_COMPILE_WORK_GROUP_SIZE, sizeof(compileSize), compileSize, NULL);
+    err |= clGetKernelWorkGroupInfo(kernelRequired, device_id, CL_KERNEL_COMPILE_WORK_GROUP_SIZE, sizeof(compileSizeRequired), compileSizeRequired, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to query compile work group size! %d\n", err);
+        return 1;
+    }
+    const bool compileSizeCorrect = compileSize[0] == 0 && compileSize[1] == 0 && compileSize[2] == 0;
+    const bool compileSizeRequiredCorrect = compileSizeRequired[0] == 16 && compileSizeRequired[1] == 1 && compileSizeRequired[2] == 1;
+    printf("Compile work group sizes: (%u, %u, %u) / (%u, %u, %u)\n",
+           (unsigned)compileSize[0], (unsigned)compileSize[1], (unsigned)compileSize[2],
+           (unsigned)compileSizeRequired[0], (unsigned)compileSizeRequired[1], (unsigned)compileSizeRequired[2]);
+
+    cl_mem input = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, data, NULL);
+    cl_mem output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * count, NULL, NULL);
+    if (!input || !output) {
+        printf("Error: Failed to allocate device memory!\n");
+        return 1;
+    }
+
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernelRequired, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernelRequired, 1, sizeof(cl_mem), &output);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 1;
+    }
+
+    // specialize on the local size (before the first launch)
+    const cl_bool specializeLocalSize = CL_TRUE;
+    err = setKernelExecInfo(kernel, CL_KERNEL_EXEC_SPECIALIZE_LOCAL_SIZE_WFV, sizeof(cl_bool), &specializeLocalSize);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to enable specialization on the local size! %d\n", err);
+        return 1;
+    }
+    if (setKernelExecInfo(kernel, CL_KERNEL_EXEC_SPECIALIZE_LOCAL_SIZE_WFV, sizeof(cl_uint) + 1, &specializeLocalSize) != CL_INVALID_VALUE) {
+        printf("Error: Invalid size of CL_KERNEL_EXEC_SPECIALIZE_LOCAL_SIZE_WFV was accepted!\n");
+        return 1;
+    }
+
+    // 16 is stable in launches 1-3, 32 changes, 16 was seen before
+    const size_t localSizes[] = { 16, 16, 16, 32, 16 };
+    const unsigned numLaunches = sizeof(localSizes) / sizeof(size_t);
+    unsigned numCorrectLaunches = 0;
+    for (unsigned l=0; l<numLaunches; ++l) {
+        if (runKernel(commands, kernel, output, data, count, &localSizes[l], localSizes[l])) ++numCorrectLaunches;
+    }
+
+    // the required size is used if no local size is given
+    const size_t requiredSize = 16;
+    const size_t invalidSize = 32;
+    if (runKernel(commands, kernelRequired, output, data, count, NULL, requiredSize)) ++numCorrectLaunches;
+    if (runKernel(commands, kernelRequired, output, data, count, &requiredSize, requiredSize)) ++numCorrectLaunches;
+
+    size_t global = count;
+    err = clEnqueueNDRangeKernel(commands, kernelRequired, 1, NULL, &global, &invalidSize, 0, NULL, NULL);
+    const bool invalidSizeRejected = err == CL_INVALID_WORK_GROUP_SIZE;
+    printf("Launch with local size %u %s rejected.\n", (unsigned)invalidSize, invalidSizeRejected ? "was" : "was not");
+
+    // Without specialization, the IR of the program is released once both
+    // kernels were executed. Afterwards, only the native code of the
+    // version for the required size is left.
+    cl_program programReleased = clCreateProgramWithSource(context, 1, &source, sourceSize, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create program!\n");
+        return 1;
+    }
+    err = clBuildProgram(programReleased, 0, NULL, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to build program executable!\n");
+        return 1;
+    }
+    cl_kernel kernelReleased = clCreateKernel(programReleased, "TestWorkGroupSize", &err);
+    cl_kernel kernelRequiredReleased = clCreateKernel(programReleased, "TestWorkGroupSizeRequired", &err);
+    if (!kernelReleased || !kernelRequiredReleased || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernels!\n");
+        return 1;
+    }
+    err  = clSetKernelArg(kernelReleased, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernelReleased, 1, sizeof(cl_mem), &output);
+    err |= clSetKernelArg(kernelRequiredReleased, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernelRequiredReleased, 1, sizeof(cl_mem), &output);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 1;
+    }
+    if (runKernel(commands, kernelRequiredReleased, output, data, count, NULL, requiredSize)) ++numCorrectLaunches;
+    if (runKernel(commands, kernelReleased, output, data, count, &requiredSize, requiredSize)) ++numCorrectLaunches;
+
+    clReleaseKernel(kernelRequiredReleased);
+    kernelRequiredReleased = clCreateKernel(programReleased, "TestWorkGroupSizeRequired", &err);
+    if (!kernelRequiredReleased || err != CL_SUCCESS) {
+        printf("Error: Failed to create compute kernel after release of the IR! %d\n", err);
+        return 1;
+    }
+    err  = clSetKernelArg(kernelRequiredReleased, 0, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(kernelRequiredReleased, 1, sizeof(cl_mem), &output);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set kernel arguments! %d\n", err);
+        return 1;
+    }
+    if (runKernel(commands, kernelRequiredReleased, output, data, count, NULL, requiredSize)) ++numCorrectLaunches;
+
+    clReleaseMemObject(input);
+    clReleaseMemObject(output);
+    clReleaseKernel(kernel);
+    clReleaseKernel(kernelRequired);
+    clReleaseKernel(kernelReleased);
+    clReleaseKernel(kernelRequiredReleased);
+    clReleaseProgram(program);
+    clReleaseProgram(programReleased);
+    clReleaseCommandQueue(commands);
+    clReleaseContext(context);
+    delete sampleCommon;
+
+    const bool success = compileSizeCorrect && compileSizeRequiredCorrect &&
+        numCorrectLaunches == numLaunches + 5 && invalidSizeRejected;
+    return success ? 0 : 1; // 0 = successful
+}
@@ -0,0 +1,18 @@
+// Both kernels depend on the local size, which the runtime folds into
+// specialized versions of them.
+__kernel void TestWorkGroupSize(
+   __global float* input,
+   __global float* output)
+{
+	const int i = get_global_id(0);
+	output[i] = input[i] * get_local_size(0) + get_local_id(0);
+}
+
+__kernel __attribute__((reqd_work_group_size(16, 1, 1)))
+void TestWorkGroupSizeRequired(
+   __global float* input,
+   __global float* output)
+{
+	const int i = get_global_id(0);
+	output[i] = input[i] * get_local_size(0) + get_local_id(0);
+}
@@ -39,14 +39,27 @@ printStats() {
 
 run build/bin/Test2D "$@"
 run build/bin/Test2D2 "$@"
+run build/bin/TestAliasing "$@"
+run build/bin/TestAlignment "$@"
+run build/bin/TestAsyncBuild "$@"
 run build/bin/TestBarrier "$@"
 run build/bin/TestBarrier2 "$@"
+run build/bin/TestBuiltins "$@"
 run build/bin/TestConstantIndex "$@"
+run build/bin/TestDeviceFission "$@"
 run build/bin/TestDynCheckSpeed "$@"
+run build/bin/TestGroupOrder "$@"
 run build/bin/TestLinearAccess "$@"
 run build/bin/TestLoopBarrier "$@"
 run build/bin/TestLoopBarrier2 "$@"
+run build/bin/TestMath "$@"
+run build/bin/TestProgramBinary "$@"
+run build/bin/TestProgramRelease "$@"
+run build/bin/TestSimdDim "$@"
 run build/bin/TestSimple "$@"
+run build/bin/TestSpecialization "$@"
 run build/bin/TestUnaligned "$@"
+run build/bin/TestVectorizationInfo "$@"
+run build/bin/TestWorkGroupSize "$@"
 
 printStats